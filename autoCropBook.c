@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "allheaders.h"
+#include <assert.h>
+#include "autoCropCommon.h"
+#include "autoCropBook.h"
+
+/*  Pass 2 of a book, as processScribe.py's auto_crop_pass2() does it: the
+    crop boxes of the leaves are fit to the mean page size of the book.
+
+    BookAddLeaf() is called as each leaf finishes, and keeps the mean and
+    variance of the clean crop width and height up to date. Once the last
+    leaf is in, BookFit() estimates them again without the leaves more than
+    one standard deviation from the mean, and fits each leaf's crop box to
+    those, in one pass over the leaves.
+
+    The variance is the population variance, and the means of the integer
+    sizes are exact, so the crop boxes are the ones processScribe.py made.
+*/
+
+#define kBookInitialLeaves 256
+
+
+/// WelfordAdd()
+///____________________________________________________________________________
+void WelfordAdd(WELFORD *s, double x)
+{
+    s->n++;
+    s->sum += x;
+    double d = x - s->mean;
+    s->mean += d / s->n;
+    s->m2   += d * (x - s->mean);
+}
+
+
+/// WelfordMean()
+/// The running mean drifts by an ulp or so from the exact mean, which is
+/// enough to move int(mean) down by one, so return the sum over n instead.
+///____________________________________________________________________________
+double WelfordMean(const WELFORD *s)
+{
+    return (s->n > 0) ? s->sum / s->n : 0.0;
+}
+
+
+/// WelfordVar()
+/// Population variance, as processScribe.py computed it.
+///____________________________________________________________________________
+double WelfordVar(const WELFORD *s)
+{
+    return (s->n > 0) ? s->m2 / s->n : 0.0;
+}
+
+
+/// LeafCropsPrint()
+/// Print the results of a leaf with the keys and formats autoCropScribe
+/// prints them with as it finds them, for a leaf that was not run again.
+///____________________________________________________________________________
+void LeafCropsPrint(const LEAFCROPS *c)
+{
+    if (kGrayModeThreeChannel == c->grayChannel) {
+        printf("grayMode: three-channel\n");
+    } else {
+        printf("grayMode: SINGLE-channel, channel=%d\n", c->grayChannel);
+    }
+    LeafCropsPrintCrops(c);
+}
+
+
+/// LeafCropsPrintCrops()
+/// LeafCropsPrint() from the bindingAngle on, for a leaf that has already
+/// printed its grayMode.
+///____________________________________________________________________________
+void LeafCropsPrintCrops(const LEAFCROPS *c)
+{
+    printf("bindingAngle: %.2f\n", c->bindingAngle);
+    printf("skewMode: %s\n", (kSkewModeText == c->skewMode) ? "text" : "edge");
+    PrintKeyValue_int32("OuterCropL", c->outerL);
+    PrintKeyValue_int32("OuterCropR", c->outerR);
+    PrintKeyValue_int32("OuterCropT", c->outerT);
+    PrintKeyValue_int32("OuterCropB", c->outerB);
+    printf("angle: %.2f\n", c->angle);
+    printf("conf: %.2f\n", c->conf);
+    PrintKeyValue_int32("CleanCropL", c->cleanL);
+    PrintKeyValue_int32("CleanCropR", c->cleanR);
+    PrintKeyValue_int32("CleanCropT", c->cleanT);
+    PrintKeyValue_int32("CleanCropB", c->cleanB);
+    PrintKeyValue_int32("InnerCropT", c->innerT);
+    PrintKeyValue_int32("InnerCropB", c->innerB);
+    PrintKeyValue_int32("InnerCropL", c->innerL);
+    PrintKeyValue_int32("InnerCropR", c->innerR);
+}
+
+
+/// BookInit()
+///____________________________________________________________________________
+void BookInit(BOOKSTATS *book)
+{
+    memset(book, 0, sizeof(*book));
+}
+
+
+/// BookAddLeaf()
+/// Keep the crop boxes of a leaf that has finished, and add its clean crop
+/// size into the running statistics, unless it is a fallback crop.
+///____________________________________________________________________________
+void BookAddLeaf(BOOKSTATS *book, l_int32 index, const LEAFCROPS *crops)
+{
+    if (book->numLeaves == book->maxLeaves) {
+        book->maxLeaves = book->maxLeaves ? 2 * book->maxLeaves : kBookInitialLeaves;
+        book->index  = (l_int32 *)realloc(book->index, book->maxLeaves * sizeof(l_int32));
+        book->leaves = (LEAFCROPS *)realloc(book->leaves, book->maxLeaves * sizeof(LEAFCROPS));
+        assert((NULL != book->index) && (NULL != book->leaves));
+    }
+
+    book->index[book->numLeaves]  = index;
+    book->leaves[book->numLeaves] = *crops;
+    book->numLeaves++;
+
+    if (crops->error) return;
+    WelfordAdd(&book->width,  crops->cleanR - crops->cleanL + 1);
+    WelfordAdd(&book->height, crops->cleanB - crops->cleanT + 1);
+}
+
+
+/// AutoCropScore()
+/// Between 0 and 5, less the further length is from the mean.
+///____________________________________________________________________________
+static double AutoCropScore(l_int32 length, double mean, double stdDev)
+{
+    double diff = fabs(mean - length);
+    if (0.0 == stdDev) return (0.0 == diff) ? 5.0 : 0.0;
+    double score = 5.0 - diff / stdDev;
+    return (score < 0.0) ? 0.0 : score;
+}
+
+
+/// FitCropWidth()
+/// Use the clean crop if its width is an outlier. Otherwise use the mean
+/// width, keeping the binding side of the clean crop, which is usually tight.
+///____________________________________________________________________________
+static void FitCropWidth(const LEAFCROPS *c, double mean, double stdDev, l_int32 *cropx, l_int32 *cropw)
+{
+    l_int32 cleanWidth = c->cleanR - c->cleanL + 1;
+
+    if (fabs(cleanWidth - mean) > stdDev) {
+        *cropx = c->cleanL;
+        *cropw = cleanWidth;
+        return;
+    }
+
+    *cropw = (l_int32)mean;
+    if (1 == c->rotDir) {
+        *cropx = c->cleanL;                 //binding on the left
+    } else {
+        *cropx = c->cleanR - *cropw + 1;    //binding on the right
+    }
+
+    if (*cropx < 0) {
+        *cropx = 0;
+    } else if (*cropx + *cropw - 1 >= c->w) {
+        *cropx = c->w - *cropw;
+    }
+}
+
+
+/// FitCropHeight()
+/// Use the clean crop if its height is an outlier, or smaller than the mean.
+/// Otherwise center the mean height in the clean crop.
+///____________________________________________________________________________
+static void FitCropHeight(const LEAFCROPS *c, double mean, double stdDev, l_int32 *cropy, l_int32 *croph)
+{
+    l_int32 cleanHeight = c->cleanB - c->cleanT + 1;
+
+    if ((fabs(cleanHeight - mean) > stdDev) || (mean > cleanHeight)) {
+        *cropy = c->cleanT;
+        *croph = cleanHeight;
+        return;
+    }
+
+    *cropy = (l_int32)(c->cleanT + cleanHeight * 0.5 - mean * 0.5);
+    *croph = (l_int32)mean;
+
+    if (*cropy < 0) {
+        *cropy = 0;
+    } else if (*cropy + *croph - 1 >= c->h) {
+        *cropy = c->h - *croph;
+    }
+}
+
+
+/// BookFit()
+/// Estimate the book's page size again without the leaves more than one
+/// standard deviation from the mean, and fit every leaf's crop box to it.
+/// Leaves with a fallback crop keep it, with a score of 0. Call once, after
+/// the last leaf.
+///____________________________________________________________________________
+void BookFit(BOOKSTATS *book)
+{
+    assert(NULL == book->fits);
+    if (0 == book->numLeaves) return;
+
+    double widthMean    = WelfordMean(&book->width);
+    double heightMean   = WelfordMean(&book->height);
+    double widthStdDev  = sqrt(WelfordVar(&book->width));
+    double heightStdDev = sqrt(WelfordVar(&book->height));
+
+    memset(&book->widthXo,  0, sizeof(book->widthXo));
+    memset(&book->heightXo, 0, sizeof(book->heightXo));
+
+    l_int32 i;
+    for (i=0; i<book->numLeaves; i++) {
+        const LEAFCROPS *c = &book->leaves[i];
+        if (c->error) continue;
+        l_int32 cleanWidth  = c->cleanR - c->cleanL + 1;
+        l_int32 cleanHeight = c->cleanB - c->cleanT + 1;
+        if (fabs(cleanWidth  - widthMean)  <= widthStdDev)  WelfordAdd(&book->widthXo,  cleanWidth);
+        if (fabs(cleanHeight - heightMean) <= heightStdDev) WelfordAdd(&book->heightXo, cleanHeight);
+    }
+    //some size is always within one std dev, if any leaf has one
+    assert((book->widthXo.n > 0) == (book->width.n > 0));
+    assert((book->heightXo.n > 0) == (book->height.n > 0));
+
+    double widthMeanXo    = WelfordMean(&book->widthXo);
+    double heightMeanXo   = WelfordMean(&book->heightXo);
+    double widthStdDevXo  = sqrt(WelfordVar(&book->widthXo));
+    double heightStdDevXo = sqrt(WelfordVar(&book->heightXo));
+
+    book->fits = (BOOKFIT *)malloc(book->numLeaves * sizeof(BOOKFIT));
+    assert(NULL != book->fits);
+
+    for (i=0; i<book->numLeaves; i++) {
+        const LEAFCROPS *c = &book->leaves[i];
+        BOOKFIT *f = &book->fits[i];
+        if (c->error) {
+            f->x     = c->cleanL;
+            f->y     = c->cleanT;
+            f->w     = c->cleanR - c->cleanL + 1;
+            f->h     = c->cleanB - c->cleanT + 1;
+            f->score = 0.0;
+            continue;
+        }
+        FitCropWidth(c, widthMeanXo, widthStdDevXo, &f->x, &f->w);
+        FitCropHeight(c, heightMeanXo, heightStdDevXo, &f->y, &f->h);
+        f->score = AutoCropScore(c->cleanR - c->cleanL + 1, widthMeanXo, widthStdDevXo)
+                 + AutoCropScore(c->cleanB - c->cleanT + 1, heightMeanXo, heightStdDevXo);
+    }
+}
+
+
+/// BookPrintCrops()
+/// Print the book's page size, and for every leaf its fitted crop box and
+/// its score. Call after BookFit().
+///____________________________________________________________________________
+void BookPrintCrops(const BOOKSTATS *book)
+{
+    if (0 == book->numLeaves) return;
+    assert(NULL != book->fits);
+
+    printf("bookWidth: mean %.2f, stdDev %.2f, meanXo %.2f, stdDevXo %.2f, %d leaves\n",
+           WelfordMean(&book->width), sqrt(WelfordVar(&book->width)),
+           WelfordMean(&book->widthXo), sqrt(WelfordVar(&book->widthXo)), book->widthXo.n);
+    printf("bookHeight: mean %.2f, stdDev %.2f, meanXo %.2f, stdDevXo %.2f, %d leaves\n",
+           WelfordMean(&book->height), sqrt(WelfordVar(&book->height)),
+           WelfordMean(&book->heightXo), sqrt(WelfordVar(&book->heightXo)), book->heightXo.n);
+
+    l_int32 i;
+    for (i=0; i<book->numLeaves; i++) {
+        const BOOKFIT *f = &book->fits[i];
+        printf("cropBox %d: %d %d %d %d\n", book->index[i], f->x, f->y, f->w, f->h);
+        printf("cropScore %d: %.2f\n", book->index[i], f->score);
+    }
+}
+
+
+/// BookDestroy()
+///____________________________________________________________________________
+void BookDestroy(BOOKSTATS *book)
+{
+    free(book->index);
+    free(book->leaves);
+    free(book->fits);
+    memset(book, 0, sizeof(*book));
+}
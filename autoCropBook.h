@@ -0,0 +1,57 @@
+#ifndef AUTOCROP_AUTOCROPBOOK_H
+#define AUTOCROP_AUTOCROPBOOK_H
+
+/// Running mean and variance, by Welford's method.
+typedef struct Welford {
+    l_int32  n;
+    double   sum;    //exact for integer samples
+    double   mean;
+    double   m2;     //sum of squared differences from the mean
+} WELFORD;
+
+/// The crop boxes autoCropScribe found for one leaf, in the coordinates of
+/// the full size image turned to portrait and deskewed.
+typedef struct LeafCrops {
+    l_int32    rotDir;
+    l_int32    w, h;                                      //full size, portrait
+    l_int32    outerL, outerR, outerT, outerB;
+    l_int32    cleanL, cleanR, cleanT, cleanB;
+    l_int32    innerL, innerR, innerT, innerB;            //-1 if not found
+    l_float32  angle, conf;
+    l_float32  bindingAngle;
+    l_int32    skewMode;                                  //kSkewMode*
+    l_int32    grayChannel;                               //or kGrayModeThreeChannel
+    l_int32    error;                                     //kLeafOK, or why this is a fallback crop
+} LEAFCROPS;
+
+/// A leaf's crop box fit to the book's page size.
+typedef struct BookFit {
+    l_int32  x, y, w, h;
+    double   score;    //0 to 10
+} BOOKFIT;
+
+/// Pass 2 of a book: the clean crop sizes of every leaf so far, so the crop
+/// boxes can be fit to the book's page size once the last leaf is in.
+typedef struct BookStats {
+    WELFORD     width, height;       //clean crop of every leaf
+    WELFORD     widthXo, heightXo;   //without the outliers, after BookFit()
+    l_int32     numLeaves, maxLeaves;
+    l_int32    *index;               //the caller's number for each leaf
+    LEAFCROPS  *leaves;
+    BOOKFIT    *fits;                //after BookFit()
+} BOOKSTATS;
+
+void    WelfordAdd(WELFORD *s, double x);
+double  WelfordMean(const WELFORD *s);
+double  WelfordVar(const WELFORD *s);
+
+void    LeafCropsPrint(const LEAFCROPS *c);
+void    LeafCropsPrintCrops(const LEAFCROPS *c);
+
+void    BookInit(BOOKSTATS *book);
+void    BookAddLeaf(BOOKSTATS *book, l_int32 index, const LEAFCROPS *crops);
+void    BookFit(BOOKSTATS *book);
+void    BookPrintCrops(const BOOKSTATS *book);
+void    BookDestroy(BOOKSTATS *book);
+
+#endif
@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "allheaders.h"
+#include <assert.h>
+#include "autoCropCommon.h"
+#include "autoCropBook.h"
+#include "autoCropCache.h"
+
+/*  Cache of leaf results, so that running a book again only crops the leaves
+    whose jpeg changed. It is also the checkpoint journal of a book: a run
+    that stops part way is resumed by running it again.
+
+    A leaf is looked up by its path and a key taken from stat(): device,
+    inode, size, mtime and ctime, and its rotateDirection. A jpeg that was
+    shot again or edited gets a new key, and is cropped again. Looking up an
+    unchanged leaf costs one stat().
+
+    The cache is a text file with a line per record, appended and flushed as
+    each leaf starts and finishes:
+
+        begin1 params key path                before cropping the leaf
+        leaf2  params key results path        after cropping it
+        fail1  params key error path          if it failed with no crop
+        retry1 params key path                if it failed in a way that may not recur
+
+    Each line holds the params the caller opened the cache with, the autocrop
+    version and any option that changes the results; lines with other params
+    are kept in the file but not used. The last line for a leaf and key is the
+    one that counts. A leaf with a fallback crop is a leaf2 line, with the
+    error in its results. A leaf that failed is not cropped again until its
+    jpeg changes, unless it failed in a way that may not happen again, such
+    as a jpeg that could not be read: its retry line ends its begin and
+    records nothing, so the next run crops it again. A leaf whose last line
+    is a begin was being cropped when its run
+    stopped; it is cropped again, unless kLeafCacheMaxTries runs began it
+    without finishing, in which case it is taken to crash the process and is
+    recorded as failed.
+
+    The file is read whole when the cache is opened. At a few hundred bytes
+    per leaf, a 600 leaf book is well under a MB.
+*/
+
+#define kLeafCacheFormat     "leaf2"
+#define kLeafCacheBegin      "begin1"
+#define kLeafCacheFail       "fail1"
+#define kLeafCacheRetry      "retry1"
+#define kLeafCacheInitial    256
+
+
+/// StatKey()
+/// Returns 0 if OK, 1 if filein cannot be stat()ed.
+///____________________________________________________________________________
+static l_int32 StatKey(const char *filein, l_int32 rotDir, LEAFCACHEKEY *key)
+{
+    struct stat st;
+    if (0 != stat(filein, &st)) return 1;
+    key->dev    = (unsigned long)st.st_dev;
+    key->ino    = (unsigned long)st.st_ino;
+    key->size   = (unsigned long)st.st_size;
+    key->mtime  = (long)st.st_mtime;
+    key->ctime  = (long)st.st_ctime;
+    key->rotDir = rotDir;
+    return 0;
+}
+
+
+/// SameKey()
+///____________________________________________________________________________
+static l_int32 SameKey(const LEAFCACHEKEY *a, const LEAFCACHEKEY *b)
+{
+    return (a->dev == b->dev) && (a->ino == b->ino) && (a->size == b->size)
+        && (a->mtime == b->mtime) && (a->ctime == b->ctime) && (a->rotDir == b->rotDir);
+}
+
+
+/// FindLatest()
+/// Returns the last entry for path and key, or NULL.
+///____________________________________________________________________________
+static LEAFCACHEENTRY *FindLatest(LEAFCACHE *cache, const char *path, const LEAFCACHEKEY *key)
+{
+    l_int32 i;
+    for (i=cache->numEntries-1; i>=0; i--) {
+        LEAFCACHEENTRY *e = &cache->entries[i];
+        if (SameKey(&e->key, key) && (0 == strcmp(e->path, path))) return e;
+    }
+    return NULL;
+}
+
+
+/// AddEntry()
+///____________________________________________________________________________
+static LEAFCACHEENTRY *AddEntry(LEAFCACHE *cache, const char *path, const LEAFCACHEKEY *key, l_int32 state)
+{
+    if (cache->numEntries == cache->maxEntries) {
+        cache->maxEntries = cache->maxEntries ? 2 * cache->maxEntries : kLeafCacheInitial;
+        cache->entries = (LEAFCACHEENTRY *)realloc(cache->entries, cache->maxEntries * sizeof(LEAFCACHEENTRY));
+        assert(NULL != cache->entries);
+    }
+    LEAFCACHEENTRY *e = &cache->entries[cache->numEntries++];
+    memset(e, 0, sizeof(*e));
+    e->path  = strdup(path);
+    e->key   = *key;
+    e->state = state;
+    assert(NULL != e->path);
+    return e;
+}
+
+
+/// ParseLine()
+/// Add the record on line to the cache, if it has these params.
+///____________________________________________________________________________
+static void ParseLine(LEAFCACHE *cache, const char *line)
+{
+    char          format[16], params[kLeafCacheMaxParams], error[kLeafCacheMaxError];
+    LEAFCACHEKEY  key;
+    LEAFCROPS     c;
+    l_int32       keyEnd = -1, pathStart = -1;
+
+    l_int32 n = sscanf(line, "%15s %63s %lu %lu %lu %ld %ld %d %n",
+                       format, params, &key.dev, &key.ino, &key.size, &key.mtime, &key.ctime, &key.rotDir,
+                       &keyEnd);
+    if ((8 != n) || (-1 == keyEnd)) return;
+    if (0 != strcmp(params, cache->params)) return;
+    const char *rest = line + keyEnd;
+
+    if (0 == strcmp(format, kLeafCacheFormat)) {
+        n = sscanf(rest, "%d %d %d %d %d %d %d %d %d %d %d %d %d %d"
+                         " %g %g %g %d %d %d %n",
+                   &c.w, &c.h,
+                   &c.outerL, &c.outerR, &c.outerT, &c.outerB,
+                   &c.cleanL, &c.cleanR, &c.cleanT, &c.cleanB,
+                   &c.innerL, &c.innerR, &c.innerT, &c.innerB,
+                   &c.angle, &c.conf, &c.bindingAngle, &c.skewMode, &c.grayChannel, &c.error,
+                   &pathStart);
+        if ((20 != n) || (-1 == pathStart)) return;
+        c.rotDir = key.rotDir;
+        AddEntry(cache, rest + pathStart, &key, kLeafCacheHit)->crops = c;
+
+    } else if (0 == strcmp(format, kLeafCacheFail)) {
+        n = sscanf(rest, "%31s %n", error, &pathStart);
+        if ((1 != n) || (-1 == pathStart)) return;
+        strcpy(AddEntry(cache, rest + pathStart, &key, kLeafCacheFailed)->error, error);
+
+    } else if (0 == strcmp(format, kLeafCacheBegin)) {
+        /// a run after one that stopped in the same leaf tries it again
+        LEAFCACHEENTRY *e = FindLatest(cache, rest, &key);
+        if ((NULL != e) && (kLeafCacheBegun == e->state)) {
+            e->tries++;
+        } else {
+            AddEntry(cache, rest, &key, kLeafCacheBegun)->tries = 1;
+        }
+
+    } else if (0 == strcmp(format, kLeafCacheRetry)) {
+        /// the leaf finished, so its begin was not a crash
+        LEAFCACHEENTRY *e = FindLatest(cache, rest, &key);
+        if ((NULL != e) && (kLeafCacheBegun == e->state)) e->state = kLeafCacheMiss;
+    }
+}
+
+
+/// LeafCacheOpen()
+/// Read the leaves in filename, if it exists, that were cropped with params,
+/// and open it to add more. params must not contain spaces. Returns 0 if OK,
+/// 1 if filename cannot be opened.
+///____________________________________________________________________________
+l_int32 LeafCacheOpen(LEAFCACHE *cache, const char *filename, const char *params)
+{
+    static char procName[] = "LeafCacheOpen";
+
+    memset(cache, 0, sizeof(*cache));
+    assert(strlen(params) < kLeafCacheMaxParams);
+    assert(NULL == strchr(params, ' '));
+    strcpy(cache->params, params);
+
+    FILE *fp = fopen(filename, "r");
+    if (NULL != fp) {
+        char line[4096 + 512];
+        while (NULL != fgets(line, sizeof(line), fp)) {
+            size_t len = strlen(line);
+            if ((0 == len) || ('\n' != line[len-1])) continue;  //cut short by a crash
+            line[len-1] = '\0';
+            ParseLine(cache, line);
+        }
+        fclose(fp);
+    }
+
+    if (NULL == (cache->fp = fopen(filename, "a"))) {
+        return ERROR_INT("cannot open cache", procName, 1);
+    }
+    return 0;
+}
+
+
+/// LeafCacheLookup()
+/// Returns kLeafCacheHit and the leaf's results in crops if filein is in the
+/// cache and has not changed, kLeafCacheFailed and the error it failed with
+/// in error if it failed, or kLeafCacheMiss if it must be cropped. A leaf
+/// that has crashed too many runs is recorded as failed here.
+///____________________________________________________________________________
+l_int32 LeafCacheLookup(LEAFCACHE *cache, const char *filein, l_int32 rotDir, LEAFCROPS *crops, const char **error)
+{
+    LEAFCACHEKEY key;
+    if (StatKey(filein, rotDir, &key)) {
+        cache->numMisses++;
+        return kLeafCacheMiss;
+    }
+
+    LEAFCACHEENTRY *e = FindLatest(cache, filein, &key);
+    if ((NULL != e) && (kLeafCacheBegun == e->state) && (e->tries >= kLeafCacheMaxTries)) {
+        LeafCacheStoreFailed(cache, filein, rotDir, kLeafCacheCrashed);
+        e->state = kLeafCacheFailed;
+        strcpy(e->error, kLeafCacheCrashed);
+    }
+
+    if ((NULL != e) && (kLeafCacheHit == e->state)) {
+        *crops = e->crops;
+        cache->numHits++;
+        return kLeafCacheHit;
+    }
+    if ((NULL != e) && (kLeafCacheFailed == e->state)) {
+        *error = e->error;
+        cache->numFailed++;
+        return kLeafCacheFailed;
+    }
+
+    cache->numMisses++;
+    return kLeafCacheMiss;
+}
+
+
+/// LeafCacheHas()
+/// 1 if LeafCacheLookup() would not have filein cropped, as a hit or a leaf
+/// that failed, else 0. Counts nothing and writes nothing, so it can be asked
+/// ahead of the lookup, to skip decoding a leaf that will not be cropped.
+///____________________________________________________________________________
+l_int32 LeafCacheHas(const LEAFCACHE *cache, const char *filein, l_int32 rotDir)
+{
+    LEAFCACHEKEY key;
+    if (StatKey(filein, rotDir, &key)) return 0;
+
+    const LEAFCACHEENTRY *e = FindLatest((LEAFCACHE *)cache, filein, &key);
+    if (NULL == e) return 0;
+    return (kLeafCacheHit == e->state) || (kLeafCacheFailed == e->state)
+        || ((kLeafCacheBegun == e->state) && (e->tries >= kLeafCacheMaxTries));
+}
+
+
+/// LeafCacheBegin()
+/// Record that filein is about to be cropped, so that if it crashes the
+/// process, the next run knows.
+///____________________________________________________________________________
+void LeafCacheBegin(LEAFCACHE *cache, const char *filein, l_int32 rotDir)
+{
+    LEAFCACHEKEY key;
+    if (StatKey(filein, rotDir, &key)) return;
+
+    fprintf(cache->fp, "%s %s %lu %lu %lu %ld %ld %d %s\n",
+            kLeafCacheBegin, cache->params, key.dev, key.ino, key.size, key.mtime, key.ctime, key.rotDir,
+            filein);
+    fflush(cache->fp);
+}
+
+
+/// LeafCacheStore()
+/// Add a leaf just cropped to the cache file.
+///____________________________________________________________________________
+void LeafCacheStore(LEAFCACHE *cache, const char *filein, l_int32 rotDir, const LEAFCROPS *c)
+{
+    LEAFCACHEKEY key;
+    if (StatKey(filein, rotDir, &key)) return;
+
+    fprintf(cache->fp, "%s %s %lu %lu %lu %ld %ld %d"
+                       " %d %d %d %d %d %d %d %d %d %d %d %d %d %d"
+                       " %.9g %.9g %.9g %d %d %d %s\n",
+            kLeafCacheFormat, cache->params, key.dev, key.ino, key.size, key.mtime, key.ctime, key.rotDir,
+            c->w, c->h,
+            c->outerL, c->outerR, c->outerT, c->outerB,
+            c->cleanL, c->cleanR, c->cleanT, c->cleanB,
+            c->innerL, c->innerR, c->innerT, c->innerB,
+            c->angle, c->conf, c->bindingAngle, c->skewMode, c->grayChannel, c->error,
+            filein);
+    fflush(cache->fp);
+}
+
+
+/// LeafCacheStoreFailed()
+/// Record that filein failed with error, a word of fewer than
+/// kLeafCacheMaxError characters.
+///____________________________________________________________________________
+void LeafCacheStoreFailed(LEAFCACHE *cache, const char *filein, l_int32 rotDir, const char *error)
+{
+    LEAFCACHEKEY key;
+    if (StatKey(filein, rotDir, &key)) return;
+    assert(strlen(error) < kLeafCacheMaxError);
+    assert(NULL == strchr(error, ' '));
+
+    fprintf(cache->fp, "%s %s %lu %lu %lu %ld %ld %d %s %s\n",
+            kLeafCacheFail, cache->params, key.dev, key.ino, key.size, key.mtime, key.ctime, key.rotDir,
+            error, filein);
+    fflush(cache->fp);
+}
+
+
+/// LeafCacheRetry()
+/// Record that filein finished but failed in a way that may not happen
+/// again, so that the next run crops it again rather than counting its begin
+/// as a crash.
+///____________________________________________________________________________
+void LeafCacheRetry(LEAFCACHE *cache, const char *filein, l_int32 rotDir)
+{
+    LEAFCACHEKEY key;
+    if (StatKey(filein, rotDir, &key)) return;
+
+    fprintf(cache->fp, "%s %s %lu %lu %lu %ld %ld %d %s\n",
+            kLeafCacheRetry, cache->params, key.dev, key.ino, key.size, key.mtime, key.ctime, key.rotDir,
+            filein);
+    fflush(cache->fp);
+}
+
+
+/// LeafCacheClose()
+///____________________________________________________________________________
+void LeafCacheClose(LEAFCACHE *cache)
+{
+    if (NULL != cache->fp) fclose(cache->fp);
+
+    l_int32 i;
+    for (i=0; i<cache->numEntries; i++) {
+        free(cache->entries[i].path);
+    }
+    free(cache->entries);
+    memset(cache, 0, sizeof(*cache));
+}
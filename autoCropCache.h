@@ -0,0 +1,53 @@
+#ifndef AUTOCROP_AUTOCROPCACHE_H
+#define AUTOCROP_AUTOCROPCACHE_H
+
+#define kLeafCacheMaxParams 64
+#define kLeafCacheMaxError  32
+#define kLeafCacheMaxTries  2         //a leaf begun this often without finishing has failed
+#define kLeafCacheCrashed   "crashed" //the error of such a leaf
+
+/// Lookup results, and the state of a leaf in the cache file.
+enum {
+    kLeafCacheMiss = 0,
+    kLeafCacheHit,
+    kLeafCacheFailed,
+    kLeafCacheBegun
+};
+
+/// What identifies a jpeg without reading it: if none of these changed,
+/// neither did the file.
+typedef struct LeafCacheKey {
+    unsigned long  dev, ino, size;
+    long           mtime, ctime;
+    l_int32        rotDir;
+} LEAFCACHEKEY;
+
+typedef struct LeafCacheEntry {
+    char          *path;
+    LEAFCACHEKEY   key;
+    l_int32        state;                     //kLeafCacheHit, Failed or Begun, or Miss once retried
+    l_int32        tries;                     //runs that began it, if Begun
+    char           error[kLeafCacheMaxError]; //if Failed
+    LEAFCROPS      crops;                     //if Hit
+} LEAFCACHEENTRY;
+
+/// Results of leaves already cropped, kept in a file across runs. The file
+/// is also the checkpoint journal of a book run.
+typedef struct LeafCache {
+    FILE            *fp;                          //open for appending
+    char             params[kLeafCacheMaxParams]; //results with other params are not used
+    l_int32          numEntries, maxEntries;
+    LEAFCACHEENTRY  *entries;
+    l_int32          numHits, numMisses, numFailed;
+} LEAFCACHE;
+
+l_int32 LeafCacheOpen(LEAFCACHE *cache, const char *filename, const char *params);
+l_int32 LeafCacheLookup(LEAFCACHE *cache, const char *filein, l_int32 rotDir, LEAFCROPS *crops, const char **error);
+l_int32 LeafCacheHas(const LEAFCACHE *cache, const char *filein, l_int32 rotDir);
+void    LeafCacheBegin(LEAFCACHE *cache, const char *filein, l_int32 rotDir);
+void    LeafCacheStore(LEAFCACHE *cache, const char *filein, l_int32 rotDir, const LEAFCROPS *crops);
+void    LeafCacheStoreFailed(LEAFCACHE *cache, const char *filein, l_int32 rotDir, const char *error);
+void    LeafCacheRetry(LEAFCACHE *cache, const char *filein, l_int32 rotDir);
+void    LeafCacheClose(LEAFCACHE *cache);
+
+#endif
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h> //for memset
 #include "allheaders.h"
 #include <math.h>   //for sqrt
 #include <assert.h>
@@ -7,6 +8,11 @@
 #include <limits.h> //for INT_MAX
 #include "autoCropCommon.h"
 
+#if defined(__SSE2__) && defined(L_LITTLE_ENDIAN)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
 #define debugstr printf
 //#define debugstr
 
@@ -198,6 +204,12 @@ l_uint32 CalculateSADcol(PIX        *pixg,
     assert(left>=0);
     assert(left<right);
     assert(right<w);
+    assert(8 == pixGetDepth(pixg));
+    assert(jBot<=h);
+
+    /// read the pels directly; pixGetPixel() is most of the binding sweep
+    const l_uint32 *data = pixGetData(pixg);
+    l_int32         wpl  = pixGetWpl(pixg);
 
     //kernel has height of (h/2 +/- h*hPercent/2)
     //l_uint32 jTop = (l_uint32)((1-hPercent)*0.5*h);
@@ -207,11 +219,10 @@ l_uint32 CalculateSADcol(PIX        *pixg,
     for (i=left; i<right; i++) {
         //printf("%d: ", i);
         acc=0;
-        for (j=jTop; j<jBot; j++) {
-            l_int32 retval = pixGetPixel(pixg, i, j, &a);
-            assert(0 == retval);
-            retval = pixGetPixel(pixg, i+1, j, &b);
-            assert(0 == retval);
+        const l_uint32 *line = data + jTop * wpl;
+        for (j=jTop; j<jBot; j++, line+=wpl) {
+            a = GET_DATA_BYTE(line, i);
+            b = GET_DATA_BYTE(line, i+1);
             //printf("%d ", val);
             acc += (abs(a-b));
             //printf("acc: %d\n", acc);
@@ -368,6 +379,7 @@ l_int32 CalculateTreshInitial(PIX *pixg, l_int32 *histmax) {
         }
 
         //printf("init thresh at i=%d\n", thresh);
+        numaDestroy(&hist);
         *histmax = peaki;
         return thresh;
 }
@@ -459,8 +471,9 @@ l_int32 FindBlackBar(PIX *pixg,
 }
 
 /// FindBlackBarAndThresh()
+/// Returns 0 if a bar was found, 1 if no threshold gives one.
 ///____________________________________________________________________________
-void FindBlackBarAndThresh(PIX *pixg,
+l_int32 FindBlackBarAndThresh(PIX *pixg,
                   l_int32 left,
                   l_int32 right,
                   l_int32 h,
@@ -487,7 +500,7 @@ void FindBlackBarAndThresh(PIX *pixg,
             *barEdgeL = blackBarL;
             *barEdgeR = blackBarR;
             *barThresh = thresh;
-            return;
+            return 0;
         }
     }
 
@@ -517,7 +530,7 @@ void FindBlackBarAndThresh(PIX *pixg,
 //         pixDestroy(&pixt);
 //     }
 
-    assert(0);
+    return 1;
 }
 
 /// ExpandRowOrCol()
@@ -542,6 +555,7 @@ void ExpandRowOrCol(l_int32 numPels, l_int32 limitMin, l_int32 limitMax, l_int32
 
 
 /// FindBindingEdge2()
+/// Returns the binding column, or -1 if there is no black bar to find it in.
 ///____________________________________________________________________________
 l_int32 FindBindingEdge2(PIX      *pixg,
                          l_int32  rotDir,
@@ -598,7 +612,9 @@ l_int32 FindBindingEdge2(PIX      *pixg,
     l_int32 histmax;
     l_int32 darkThresh; // = CalculateTreshInitial(pixg, &histmax);
     //FindBlackBar(pixg, left, right, h, darkThresh, &blackBarL, &blackBarR);
-    FindBlackBarAndThresh(pixg, left, right, h, &blackBarL, &blackBarR, &darkThresh);
+    if (FindBlackBarAndThresh(pixg, left, right, h, &blackBarL, &blackBarR, &darkThresh)) {
+        return -1;
+    }
     printf("init blackBar L=%d, R=%d, width=%d, thresh=%d\n", blackBarL, blackBarR, blackBarR-blackBarL, darkThresh);
 
     //CalculateSADcol(pixg, left, right, jTop, jBot, &bindingEdge, &bindingEdgeDiff);
@@ -673,7 +689,9 @@ l_int32 FindBindingEdge2(PIX      *pixg,
         pixDestroy(&pixt);
     }
 
-    assert(-1 != bindingEdge); //TODO: handle error
+    if (-1 == bindingEdge) {
+        return -1;
+    }
     //printf("BEST: delta=%f, strongest edge of gutter is at i=%d with diff=%d\n", bindingDelta, bindingEdge, bindingEdgeDiff);
     *skew = bindingDelta;
     #if DEBUGMOV
@@ -871,13 +889,15 @@ l_int32 FindBindingUsingBlackBar(PIX      *pixg,
     return 1;
 }
 
-/// ConvertToGray()
+/// ChooseGrayChannel()
+/// Pick the channel ConvertToGray() would use for a 32bpp leaf: 0, 1 or 2 when
+/// one channel's histogram peak is more than twice the others (a colored
+/// cover or platen), otherwise kGrayModeThreeChannel. Prints its reasoning
+/// if verbose, so it can also run quietly on a decode thread.
 ///____________________________________________________________________________
-PIX* ConvertToGray(PIX *pix, l_int32 *grayChannel) {
+l_int32 ChooseGrayChannel(PIX *pix, l_int32 verbose) {
 
-    PIX *pixg;
     l_int32 maxchannel;
-    l_int32 useSingleChannelForGray = 0;
 
     NUMA *histR, *histG, *histB;
     l_int32 ret = pixGetColorHistogram(pix, 1, &histR, &histG, &histB);
@@ -889,15 +909,18 @@ PIX* ConvertToGray(PIX *pix, l_int32 *grayChannel) {
     ret = numaGetMax(histR, &maxval, &maxloc[0]);
     assert(0 == ret);
 
-    printf("red peak at %d with val %f\n", maxloc[0], maxval);
+    if (verbose) printf("red peak at %d with val %f\n", maxloc[0], maxval);
 
     ret = numaGetMax(histG, &maxval, &maxloc[1]);
     assert(0 == ret);
-    printf("green peak at %d with val %f\n", maxloc[1], maxval);
+    if (verbose) printf("green peak at %d with val %f\n", maxloc[1], maxval);
 
     ret = numaGetMax(histB, &maxval, &maxloc[2]);
     assert(0 == ret);
-    printf("blue peak at %d with val %f\n", maxloc[2], maxval);
+    if (verbose) printf("blue peak at %d with val %f\n", maxloc[2], maxval);
+    numaDestroy(&histR);
+    numaDestroy(&histG);
+    numaDestroy(&histB);
 
     l_int32 i;
     l_int32 max=0, secondmax=0;
@@ -909,21 +932,30 @@ PIX* ConvertToGray(PIX *pix, l_int32 *grayChannel) {
             secondmax = maxloc[i];
         }
     }
-    printf("max = %d, secondmax=%d\n", max, secondmax);
+    if (verbose) printf("max = %d, secondmax=%d\n", max, secondmax);
     if (max > (secondmax*2)) {
-        printf("grayMode: SINGLE-channel, channel=%d\n", maxchannel);
-        useSingleChannelForGray = 1;
-    } else {
-        printf("grayMode: three-channel\n");
+        if (verbose) printf("grayMode: SINGLE-channel, channel=%d\n", maxchannel);
+        return maxchannel;
     }
 
-    if (useSingleChannelForGray) {
-        pixg = pixConvertRGBToGray (pix, (0==maxchannel), (1==maxchannel), (2==maxchannel));
-        *grayChannel = maxchannel;
+    if (verbose) printf("grayMode: three-channel\n");
+    return kGrayModeThreeChannel;
+}
+
+
+/// ConvertToGray()
+///____________________________________________________________________________
+PIX* ConvertToGray(PIX *pix, l_int32 *grayChannel) {
+
+    PIX *pixg;
+    l_int32 channel = ChooseGrayChannel(pix, 1);
+
+    if (kGrayModeThreeChannel != channel) {
+        pixg = pixConvertRGBToGray (pix, (0==channel), (1==channel), (2==channel));
     } else {
         pixg = pixConvertRGBToGray (pix, 0.30, 0.60, 0.10);
-        *grayChannel = kGrayModeThreeChannel;
     }
+    *grayChannel = channel;
 
     return pixg;
 
@@ -934,6 +966,15 @@ PIX* ConvertToGray(PIX *pix, l_int32 *grayChannel) {
 /// RemoveBackgroundTop()
 ///____________________________________________________________________________
 l_int32 RemoveBackgroundTop(PIX *pixg, l_int32 rotDir, l_int32 initialBlackThresh) {
+    return RemoveBackgroundTopFrom(pixg, rotDir, initialBlackThresh, 0);
+}
+
+
+/// RemoveBackgroundTopFrom()
+/// RemoveBackgroundTop(), scanning down from row jStart instead of row 0.
+/// Returns jStart if row jStart is not background.
+///____________________________________________________________________________
+l_int32 RemoveBackgroundTopFrom(PIX *pixg, l_int32 rotDir, l_int32 initialBlackThresh, l_int32 jStart) {
 
 
     l_uint32 w = pixGetWidth(pixg);
@@ -963,7 +1004,7 @@ l_int32 RemoveBackgroundTop(PIX *pixg, l_int32 rotDir, l_int32 initialBlackThres
 
     l_uint32 i, j;
 
-    for(j=0; j<=limitB; j++) {
+    for(j=jStart; j<=limitB; j++) {
 
         l_uint32 numBlackPels = 0;
         for (i=limitL; i<=limitR; i++) {
@@ -987,6 +1028,15 @@ l_int32 RemoveBackgroundTop(PIX *pixg, l_int32 rotDir, l_int32 initialBlackThres
 /// RemoveBackgroundBottom()
 ///____________________________________________________________________________
 l_int32 RemoveBackgroundBottom(PIX *pixg, l_int32 rotDir, l_int32 initialBlackThresh) {
+    return RemoveBackgroundBottomFrom(pixg, rotDir, initialBlackThresh, pixGetHeight(pixg)-1);
+}
+
+
+/// RemoveBackgroundBottomFrom()
+/// RemoveBackgroundBottom(), scanning up from row jStart instead of the last
+/// row. Returns jStart if row jStart is not background.
+///____________________________________________________________________________
+l_int32 RemoveBackgroundBottomFrom(PIX *pixg, l_int32 rotDir, l_int32 initialBlackThresh, l_int32 jStart) {
 
 
     l_uint32 w = pixGetWidth(pixg);
@@ -1017,7 +1067,7 @@ l_int32 RemoveBackgroundBottom(PIX *pixg, l_int32 rotDir, l_int32 initialBlackTh
 
     l_int32 i, j;
 
-    for(j=h-1; j>=limitT; j--) {
+    for(j=jStart; j>=limitT; j--) {
 
         l_uint32 numBlackPels = 0;
         for (i=limitL; i<=limitR; i++) {
@@ -1351,6 +1401,16 @@ l_int32 RemoveBackgroundOuter_R(PIX *pixg, l_int32 iStart, l_int32 iEnd, l_int32
 /// RemoveBackgroundOuter()
 ///____________________________________________________________________________
 l_int32 RemoveBackgroundOuter(PIX *pixg, l_int32 rotDir, l_uint32 topEdge, l_uint32 bottomEdge, l_int32 initialBlackThresh) {
+    l_int32 iStart = (1 == rotDir) ? pixGetWidth(pixg)-1 : 0;
+    return RemoveBackgroundOuterFrom(pixg, rotDir, topEdge, bottomEdge, initialBlackThresh, iStart);
+}
+
+
+/// RemoveBackgroundOuterFrom()
+/// RemoveBackgroundOuter(), scanning in from column iStart instead of the
+/// outer edge of the image. Returns iStart if column iStart is not background.
+///____________________________________________________________________________
+l_int32 RemoveBackgroundOuterFrom(PIX *pixg, l_int32 rotDir, l_uint32 topEdge, l_uint32 bottomEdge, l_int32 initialBlackThresh, l_int32 iStart) {
 
 
     l_uint32 w = pixGetWidth(pixg);
@@ -1364,7 +1424,7 @@ l_int32 RemoveBackgroundOuter(PIX *pixg, l_int32 rotDir, l_uint32 topEdge, l_uin
     limitB = bottomEdge-kernelHeight10;
     l_int32 step;
 
-    l_int32 iStart, iEnd;
+    l_int32 iEnd;
 
 
     //l_int32 initialBlackThresh = 140;
@@ -1372,7 +1432,6 @@ l_int32 RemoveBackgroundOuter(PIX *pixg, l_int32 rotDir, l_uint32 topEdge, l_uin
 
 
     if (1 == rotDir) {
-        iStart = w-1;
         iEnd   = (l_int32)(w*0.20);
 
         debugstr("O: iStart=%d, iEnd=%d, limitT=%d, limitB=%d\n", iStart, iEnd, limitT, limitB);
@@ -1380,7 +1439,6 @@ l_int32 RemoveBackgroundOuter(PIX *pixg, l_int32 rotDir, l_uint32 topEdge, l_uin
         return RemoveBackgroundOuter_R(pixg, iStart, iEnd, limitT, limitB, initialBlackThresh, numBlackRequired);
 
     } else if (-1 == rotDir) {
-        iStart = 0;
         iEnd   = (l_uint32)(w*0.80);
 
         debugstr("O: iStart=%d, iEnd=%d, limitT=%d, limitB=%d\n", iStart, iEnd, limitT, limitB);
@@ -1475,6 +1533,10 @@ l_uint32 RemoveBlackPelsBlockColLeft(PIX *pixg, l_uint32 starti, l_uint32 endi,
 
     //debugstr("LEFT: starti = %d, endi=%d, thresh=%d\n", starti, endi, blackThresh);
 
+    /// the kernel must not run off the right of the image
+    l_uint32 w = pixGetWidth(pixg);
+    if (endi + kernelWidth > w) endi = w-kernelWidth;
+
     for (i=starti+1; i<=endi; i++) {
         numBlackPels = 0;
         for(x=i; x<i+kernelWidth; x++) {
@@ -1517,6 +1579,10 @@ l_uint32 RemoveBlackPelsBlockRowTop(PIX *pixg, l_uint32 startj, l_uint32 endj, l
     left  += kernelWidth10;
     right -= kernelWidth10;
 
+    /// the kernel must not run off the bottom of the image
+    l_uint32 h = pixGetHeight(pixg);
+    if (endj + kernelWidth > h-1) endj = h-1-kernelWidth;
+
     for (j=startj+1; j<=endj; j++) {
         numBlackPels = 0;
         for(x=left; x<=right; x++) {
@@ -1559,7 +1625,11 @@ l_uint32 RemoveBlackPelsBlockRowBot(PIX *pixg, l_uint32 startj, l_uint32 endj, l
     left  += kernelWidth10;
     right -= kernelWidth10;
 
-    for (j=startj+1; j>=endj; j--) {
+    /// the kernel must not run off the bottom of the image
+    l_uint32 h = pixGetHeight(pixg);
+    l_uint32 firstj = min_int32(startj+1, h-1-kernelWidth);
+
+    for (j=firstj; j>=endj; j--) {
         numBlackPels = 0;
         for(x=left; x<=right; x++) {
             for(y=j; y<=j+kernelWidth; y++) {
@@ -1604,9 +1674,10 @@ l_uint32 CountBlackPelsCol(PIX *pixg, l_uint32 i, l_uint32 top, l_uint32 bottom,
 
 
 /// FindTextBlockCol_L()
-/// find text block using difference of line variances
+/// find text block using difference of line variances. Returns 1 if found,
+/// 0 if not, and -1 if the box is empty.
 ///____________________________________________________________________________
-l_uint32 FindTextBlockCol_L(PIX        *pixg,
+l_int32 FindTextBlockCol_L(PIX        *pixg,
                          l_uint32   left,
                          l_uint32   right,
                          l_uint32   top,
@@ -1625,12 +1696,11 @@ l_uint32 FindTextBlockCol_L(PIX        *pixg,
 
     l_uint32 w = pixGetWidth( pixg );
     l_uint32 h = pixGetHeight( pixg );
-    assert(left>=0);
-    assert(left<right);
-    assert(right<w);
-    assert(top>=0);
-    assert(top<bottom);
-    assert(bottom<h);
+    if ((left >= right) || (right >= w) || (top >= bottom) || (bottom >= h)) {
+        *retj = -1;
+        *retVar = DBL_MAX;
+        return -1;
+    }
     double var;
     l_uint32 height10 = (l_uint32)(h * 0.10);
     debugstr("FindTextBlockCol_L reducing j range to %d - %d\n", top+height10, bottom-height10);
@@ -1675,9 +1745,10 @@ l_uint32 FindTextBlockCol_L(PIX        *pixg,
 }
 
 /// FindTextBlockCol_R()
-/// find text block using difference of line variances
+/// find text block using difference of line variances. Returns 1 if found,
+/// 0 if not, and -1 if the box is empty.
 ///____________________________________________________________________________
-l_uint32 FindTextBlockCol_R(PIX        *pixg,
+l_int32 FindTextBlockCol_R(PIX        *pixg,
                          l_uint32   left,
                          l_uint32   right,
                          l_uint32   top,
@@ -1696,12 +1767,11 @@ l_uint32 FindTextBlockCol_R(PIX        *pixg,
 
     l_uint32 w = pixGetWidth( pixg );
     l_uint32 h = pixGetHeight( pixg );
-    assert(left>=0);
-    assert(left<right);
-    assert(right<w);
-    assert(top>=0);
-    assert(top<bottom);
-    assert(bottom<h);
+    if ((left >= right) || (right >= w) || (top >= bottom) || (bottom >= h)) {
+        *retj = -1;
+        *retVar = DBL_MAX;
+        return -1;
+    }
     double var;
     l_uint32 height10 = (l_uint32)(h * 0.10);
     debugstr("FindTextBlockCol_R reducing j range to %d - %d\n", top+height10, bottom-height10);
@@ -1747,9 +1817,10 @@ l_uint32 FindTextBlockCol_R(PIX        *pixg,
 
 
 /// FindTextBlockRow_T()
-/// find text block using difference of line variances
+/// find text block using difference of line variances. Returns 1 if found,
+/// 0 if not, and -1 if the box is empty.
 ///____________________________________________________________________________
-l_uint32 FindTextBlockRow_T(PIX        *pixg,
+l_int32 FindTextBlockRow_T(PIX        *pixg,
                          l_uint32   left,
                          l_uint32   right,
                          l_uint32   top,
@@ -1767,12 +1838,11 @@ l_uint32 FindTextBlockRow_T(PIX        *pixg,
 
     l_uint32 w = pixGetWidth( pixg );
     l_uint32 h = pixGetHeight( pixg );
-    assert(left>=0);
-    assert(left<right);
-    assert(right<w);
-    assert(top>=0);
-    assert(top<bottom);
-    assert(bottom<h);
+    if ((left >= right) || (right >= w) || (top >= bottom) || (bottom >= h)) {
+        *retj = -1;
+        *retVar = DBL_MAX;
+        return -1;
+    }
     double var;
     l_uint32 width20 = (l_uint32)(w * 0.20);
 
@@ -1813,9 +1883,10 @@ l_uint32 FindTextBlockRow_T(PIX        *pixg,
 }
 
 /// FindTextBlockRow_B()
-/// find text block using difference of line variances
+/// find text block using difference of line variances. Returns 1 if found,
+/// 0 if not, and -1 if the box is empty.
 ///____________________________________________________________________________
-l_uint32 FindTextBlockRow_B(PIX        *pixg,
+l_int32 FindTextBlockRow_B(PIX        *pixg,
                          l_uint32   left,
                          l_uint32   right,
                          l_uint32   top,
@@ -1833,12 +1904,11 @@ l_uint32 FindTextBlockRow_B(PIX        *pixg,
 
     l_uint32 w = pixGetWidth( pixg );
     l_uint32 h = pixGetHeight( pixg );
-    assert(left>=0);
-    assert(left<right);
-    assert(right<w);
-    assert(top>=0);
-    assert(top<bottom);
-    assert(bottom<h);
+    if ((left >= right) || (right >= w) || (top >= bottom) || (bottom >= h)) {
+        *retj = -1;
+        *retVar = DBL_MAX;
+        return -1;
+    }
     double var;
     l_uint32 width20 = (l_uint32)(w * 0.20);
 
@@ -1880,6 +1950,8 @@ l_uint32 FindTextBlockRow_B(PIX        *pixg,
 
 
 /// FindInnerCrop()
+/// The text block inside a crop box, -1 for the sides not found. Returns 0,
+/// or 1 if the crop box leaves no room to search.
 ///____________________________________________________________________________
 int FindInnerCrop(PIX *pixBigT,
     l_uint32 threshBinding,
@@ -1893,13 +1965,14 @@ int FindInnerCrop(PIX *pixBigT,
     l_int32 *innerCropB)
 {
     double innerCrop_val;
+    l_int32 empty = 0;
 
     l_int32 h2 = (outerCropB-outerCropT)/2;
     l_int32 w2 = (outerCropR-outerCropL)/2;
     l_int32 bottom = pixGetHeight(pixBigT) - 1;
     l_int32 right  = pixGetWidth(pixBigT) - 1;
 
-    FindTextBlockRow_T(              pixBigT,
+    empty |= (-1 == FindTextBlockRow_T(pixBigT,
                                 outerCropL,
                                 outerCropR,
                                 outerCropT,
@@ -1907,10 +1980,9 @@ int FindInnerCrop(PIX *pixBigT,
                                 50000,
                                 innerCropT,
                                 &innerCrop_val
-                            );
-    PrintKeyValue_int32("InnerCropT", *innerCropT);
+                            ));
 
-    FindTextBlockRow_B(              pixBigT,
+    empty |= (-1 == FindTextBlockRow_B(pixBigT,
                                 outerCropL,
                                 outerCropR,
                                 max( outerCropB - h2, 0),
@@ -1918,10 +1990,9 @@ int FindInnerCrop(PIX *pixBigT,
                                 50000,
                                 innerCropB,
                                 &innerCrop_val
-                            );
-    PrintKeyValue_int32("InnerCropB", *innerCropB);
+                            ));
 
-    FindTextBlockCol_L(              pixBigT,
+    empty |= (-1 == FindTextBlockCol_L(pixBigT,
                                 outerCropL,
                                 min(outerCropL + w2, right),
                                 outerCropT,
@@ -1930,10 +2001,9 @@ int FindInnerCrop(PIX *pixBigT,
                                 threshBinding,
                                 innerCropL,
                                 &innerCrop_val
-                            );
-    PrintKeyValue_int32("InnerCropL", *innerCropL);
+                            ));
 
-    FindTextBlockCol_R(              pixBigT,
+    empty |= (-1 == FindTextBlockCol_R(pixBigT,
                                 max(outerCropR - w2, 0),
                                 outerCropR,
                                 outerCropT,
@@ -1942,8 +2012,1156 @@ int FindInnerCrop(PIX *pixBigT,
                                 threshBinding,
                                 innerCropR,
                                 &innerCrop_val
-                            );
-    PrintKeyValue_int32("InnerCropR", *innerCropR);
+                            ));
+
+    return empty;
+}
+
+
+/// CreateRowPrefixCounts()
+/// For each row of a 1bpp image, store the number of black pels in the words
+/// to the left of each 32-bit word boundary. The number of black pels in any
+/// column range of a row can then be found in constant time.
+///____________________________________________________________________________
+static l_int32 *CreateRowPrefixCounts(PIX *pixb) {
+    l_int32   w, h, d;
+    pixGetDimensions(pixb, &w, &h, &d);
+    assert(1 == d);
+
+    l_int32   wpl    = pixGetWpl(pixb);
+    l_uint32 *data   = pixGetData(pixb);
+    l_int32   nwords = (w + 31) >> 5;
+
+    l_int32 *prefix = (l_int32 *)malloc((size_t)h * (nwords+1) * sizeof(l_int32));
+    if (NULL == prefix) return NULL;
+
+    l_int32 i, j;
+    for (j=0; j<h; j++) {
+        l_uint32 *line = data + j*wpl;
+        l_int32  *p    = prefix + j*(nwords+1);
+        p[0] = 0;
+        for (i=0; i<nwords; i++) {
+            l_uint32 word = line[i];
+            if ((i == nwords-1) && (w & 31)) {
+                word &= ~(0xffffffff >> (w & 31)); //ignore padding bits
+            }
+            p[i+1] = p[i] + __builtin_popcount(word);
+        }
+    }
+
+    return prefix;
+}
+
+
+/// CountBlackPelsPrefix()
+/// number of black pels in columns [0, x) of a row, using the prefix counts
+///____________________________________________________________________________
+static inline l_int32 CountBlackPelsPrefix(const l_int32 *p, const l_uint32 *line, l_int32 x) {
+    l_int32 n = p[x>>5];
+    if (x & 31) {
+        n += __builtin_popcount(line[x>>5] & ~(0xffffffff >> (x & 31)));
+    }
+    return n;
+}
+
+
+/// CalculateShearedDiffSquareSum()
+/// Score a vertical shear about the upper-left corner without building the
+/// sheared image. pixVShearCorner() moves vertical strips of columns down by
+/// one row per strip; here each strip of each source row adds its black pel
+/// count to the row sum it would land in. The score is the same sum of squared
+/// differences of adjacent row sums computed by pixFindDifferentialSquareSum().
+///____________________________________________________________________________
+static l_float32 CalculateShearedDiffSquareSum(PIX           *pixb,
+                                               const l_int32 *prefix,
+                                               l_float32     radang,
+                                               l_int32       *rowSums,
+                                               l_int32       *stripX)
+{
+    l_int32   w, h, d;
+    pixGetDimensions(pixb, &w, &h, &d);
+
+    l_int32   wpl    = pixGetWpl(pixb);
+    l_uint32 *data   = pixGetData(pixb);
+    l_int32   nwords = (w + 31) >> 5;
+    l_int32   i, j;
+
+    memset(rowSums, 0, h * sizeof(l_int32));
+
+    //strips of columns are [x0, x1), and are shifted down by sign*vshift
+    l_int32   sign = L_SIGN(radang);
+    l_float32 tanangle = tan(radang);
+    l_float32 invangle = (0.0 == tanangle) ? 0.0 : L_ABS(1. / tanangle);
+
+    if ((0.0 == radang) || (0.0 == tanangle) || (invangle >= 2.0*w)) {
+        //no shear, or the first strip covers the whole image
+        for (j=0; j<h; j++) {
+            rowSums[j] = prefix[j*(nwords+1) + nwords];
+        }
+    } else {
+        //find the strip boundaries first, so each row is read left to right
+        l_int32 nstrips = 0;
+        l_int32 x0 = 0;
+        l_int32 x1 = (l_int32)(invangle / 2.);
+        while (x0 < w) {
+            if (x1 > w) x1 = w;
+            stripX[nstrips++] = x0;
+            x0 = x1;
+            x1 = (l_int32)(invangle * (nstrips + 0.5) + 0.5);
+        }
+        stripX[nstrips] = w;
+
+        l_int32 k;
+        for (j=0; j<h; j++) {
+            const l_int32  *p    = prefix + j*(nwords+1);
+            const l_uint32 *line = data + j*wpl;
+            //only strips whose shifted row lands inside the image contribute
+            l_int32 kEnd = (1 == sign) ? min_int32(nstrips, h-j) : min_int32(nstrips, j+1);
+            l_int32 left = 0;
+            for (k=0; k<kEnd; k++) {
+                l_int32 right = CountBlackPelsPrefix(p, line, stripX[k+1]);
+                rowSums[j+sign*k] += right - left;
+                left = right;
+            }
+        }
+    }
+
+    //skip rows at top and bottom, as pixFindDifferentialSquareSum() does
+    l_int32 skiph = (l_int32)(0.05 * w);
+    l_int32 skip  = L_MIN(h / 10, skiph);
+    l_int32 nskip = L_MAX(skip / 2, 1);
+
+    l_float32 sum = 0.0;
+    for (i=nskip; i<h-nskip; i++) {
+        l_float32 diff = (l_float32)rowSums[i] - (l_float32)rowSums[i-1];
+        sum += diff * diff;
+    }
+
+    return sum;
+}
+
+
+/// ViewInit()
+/// Set up a view of the part of pix inside box (all of pix if box is NULL).
+/// The box is clipped to the image, as in pixClipRectangle(). Returns 0 if
+/// OK, 1 if the clipped box is empty.
+///____________________________________________________________________________
+l_int32 ViewInit(PIXVIEW *view, PIX *pix, BOX *box)
+{
+    l_int32 w, h;
+    pixGetDimensions(pix, &w, &h, NULL);
+
+    l_int32 x0 = 0, y0 = 0, x1 = w, y1 = h;
+    if (NULL != box) {
+        x0 = max_int32(box->x, 0);
+        y0 = max_int32(box->y, 0);
+        x1 = min_int32(box->x + box->w, w);
+        y1 = min_int32(box->y + box->h, h);
+    }
+
+    view->pix = pix;
+    view->x   = x0;
+    view->y   = y0;
+    view->w   = max_int32(x1 - x0, 0);
+    view->h   = max_int32(y1 - y0, 0);
+
+    return ((0 == view->w) || (0 == view->h));
+}
+
+
+/// ViewCopy()
+/// Copy the view into a new PIX, for debug images and for callers that need
+/// a real PIX.
+///____________________________________________________________________________
+PIX *ViewCopy(const PIXVIEW *view)
+{
+    BOX *box  = boxCreate(view->x, view->y, view->w, view->h);
+    PIX *pixd = pixClipRectangle(view->pix, box, NULL);
+    boxDestroy(&box);
+    return pixd;
+}
+
+
+/// ThresholdViewToBinary()
+/// Same as pixThresholdToBinary() on an 8bpp view: pels with a gray value
+/// below thresh become black (1).
+///____________________________________________________________________________
+PIX *ThresholdViewToBinary(const PIXVIEW *view, l_int32 thresh)
+{
+    return ThresholdViewAndHistogram(view, thresh, NULL);
+}
+
+
+/// GetViewGrayHistogram()
+/// Same as pixGetGrayHistogram(pix, 1) on an 8bpp view
+///____________________________________________________________________________
+NUMA *GetViewGrayHistogram(const PIXVIEW *view)
+{
+    assert(8 == pixGetDepth(view->pix));
+
+    l_int32 counts[256];
+    memset(counts, 0, sizeof(counts));
+
+    l_uint32 *datas = pixGetData(view->pix);
+    l_int32   wpls  = pixGetWpl(view->pix);
+
+    l_int32 i, j;
+    for (i=0; i<view->h; i++) {
+        const l_uint32 *lines = datas + (view->y + i) * wpls;
+        for (j=0; j<view->w; j++) {
+            counts[GET_DATA_BYTE(lines, view->x + j)]++;
+        }
+    }
+
+    NUMA *na = numaCreate(256);
+    if (NULL == na) return NULL;
+    for (i=0; i<256; i++) {
+        numaAddNumber(na, counts[i]);
+    }
+    return na;
+}
+
+
+/// OtsuAdaptiveThreshold()
+/// Same arguments and result as pixOtsuAdaptiveThreshold(). When the tile size
+/// covers the whole image (sx > w/2 and sy > h/2 gives a single tile), the
+/// threshold comes from one histogram of pixs and pixs is binarized directly
+/// into the destination. pixOtsuAdaptiveThreshold() copies the tile out, copies
+/// it again in pixSplitDistributionFgBg(), and thresholds into a third image
+/// that is painted back. Multi-tile calls go to Leptonica.
+///____________________________________________________________________________
+l_int32 OtsuAdaptiveThreshold(PIX       *pixs,
+                              l_int32    sx,
+                              l_int32    sy,
+                              l_int32    smoothx,
+                              l_int32    smoothy,
+                              l_float32  scorefract,
+                              PIX      **ppixth,
+                              PIX      **ppixd)
+{
+    static char procName[] = "OtsuAdaptiveThreshold";
+
+    if ((NULL == pixs) || (8 != pixGetDepth(pixs)) || (sx < 16) || (sy < 16) ||
+        (NULL != pixGetColormap(pixs)) ||
+        (pixGetWidth(pixs) / sx > 1) || (pixGetHeight(pixs) / sy > 1)) {
+        return pixOtsuAdaptiveThreshold(pixs, sx, sy, smoothx, smoothy, scorefract, ppixth, ppixd);
+    }
+
+    if ((NULL == ppixth) && (NULL == ppixd)) return 1;
+    if (NULL != ppixth) *ppixth = NULL;
+    if (NULL != ppixd)  *ppixd  = NULL;
+
+    /// with one tile there is nothing to smooth
+    PIXVIEW view;
+    ViewInit(&view, pixs, NULL);
+
+    NUMA *hist = GetViewGrayHistogram(&view);
+    if (NULL == hist) return 1;
+
+    l_int32   thresh;
+    l_float32 avefg, avebg;
+    l_int32 ret = numaSplitDistribution(hist, scorefract, &thresh, &avefg, &avebg, NULL, NULL, NULL);
+    numaDestroy(&hist);
+    if (ret) return 1;
+
+    if (NULL != ppixd) {
+        *ppixd = ThresholdViewToBinary(&view, thresh);
+        if (NULL == *ppixd) return ERROR_INT("pixd not made", procName, 1);
+    }
+    if (NULL != ppixth) {
+        if (NULL == (*ppixth = pixCreate(1, 1, 8))) {
+            if (NULL != ppixd) pixDestroy(ppixd);
+            return ERROR_INT("pixth not made", procName, 1);
+        }
+        pixSetPixel(*ppixth, 0, 0, thresh);
+    }
+    return 0;
+}
+
+
+/// GetBinaryWord()
+/// 32 pels of a 1bpp row starting at pel x, leftmost pel in the MSB, as if x
+/// were word aligned. Pels at or past xEnd read as 0.
+///____________________________________________________________________________
+static inline l_uint32 GetBinaryWord(const l_uint32 *line, l_int32 x, l_int32 xEnd)
+{
+    l_int32  shift = x & 31;
+    l_uint32 word  = line[x >> 5] << shift;
+
+    if (shift && (x - shift + 32 < xEnd)) {
+        word |= line[(x >> 5) + 1] >> (32 - shift);
+    }
+    if (xEnd - x < 32) {
+        word &= 0xffffffff << (32 - (xEnd - x));
+    }
+    return word;
+}
+
+
+#ifdef USE_SSE2
+/// ThresholdChunk16()
+/// Compare 16 word-aligned 8bpp pels against thresh-1 and return the black
+/// pels as 16 bits, leftmost pel in the MSB. The movemask bits come out in
+/// memory order, where pel x is byte x^3, so the nibbles are reversed to get
+/// pel order. The 16 bytes are also added to the histograms.
+///____________________________________________________________________________
+static inline l_uint32 ThresholdChunk16(const l_uint32 *src,
+                                        __m128i         threshMinus1,
+                                        l_int32       (*counts)[256])
+{
+    __m128i  v     = _mm_loadu_si128((const __m128i *)src);
+    __m128i  black = _mm_cmpeq_epi8(_mm_min_epu8(v, threshMinus1), v);
+    l_uint32 mask  = _mm_movemask_epi8(black);
+
+    if (NULL != counts) {
+        const l_uint8 *bytes = (const l_uint8 *)src;
+        l_int32 m;
+        for (m=0; m<16; m+=4) {
+            counts[0][bytes[m]]++;
+            counts[1][bytes[m+1]]++;
+            counts[2][bytes[m+2]]++;
+            counts[3][bytes[m+3]]++;
+        }
+    }
+
+    mask = ((mask & 0x0f0f) << 4) | ((mask & 0xf0f0) >> 4);
+    return ((mask & 0x00ff) << 8) | (mask >> 8);
+}
+#endif
+
+
+/// ThresholdViewAndHistogram()
+/// Binarize an 8bpp view as pixThresholdToBinary() does, and if phist is not
+/// NULL also return the gray histogram of the view, as pixGetGrayHistogram(),
+/// in the same pass over the data. With SSE2, 16 pels at a time are compared
+/// and packed with movemask. The bits are collected in a row buffer aligned
+/// to the parent image and then shifted into place, so the view can start at
+/// any column.
+///____________________________________________________________________________
+PIX *ThresholdViewAndHistogram(const PIXVIEW *view, l_int32 thresh, NUMA **phist)
+{
+    assert(8 == pixGetDepth(view->pix));
+
+    if (NULL != phist) *phist = NULL;
+
+    PIX *pixd = pixCreate(view->w, view->h, 1);
+    if (NULL == pixd) return NULL;
+    pixCopyResolution(pixd, view->pix);
+
+    l_uint32 *datas = pixGetData(view->pix);
+    l_int32   wpls  = pixGetWpl(view->pix);
+    l_uint32 *datad = pixGetData(pixd);
+    l_int32   wpld  = pixGetWpl(pixd);
+
+    /// rowBits[] holds one row of black pels, starting at the word of the
+    /// parent image that contains view->x
+    l_int32   base   = view->x & ~31;
+    l_int32   xStart = view->x - base;
+    l_int32   xEnd   = xStart + view->w;
+    l_int32   nwords = (xEnd + 31) / 32;
+    l_uint32 *rowBits = (l_uint32 *)malloc(nwords * sizeof(l_uint32));
+    if (NULL == rowBits) {
+        pixDestroy(&pixd);
+        return NULL;
+    }
+
+    /// four histograms, so that runs of equal pels don't serialize on one
+    /// counter
+    l_int32 (*counts)[256] = NULL;
+    if (NULL != phist) {
+        counts = (l_int32 (*)[256])calloc(4, sizeof(*counts));
+        if (NULL == counts) {
+            free(rowBits);
+            pixDestroy(&pixd);
+            return NULL;
+        }
+    }
+
+    /// pels in [simdStart, simdEnd) of the parent are done 16 at a time
+#ifdef USE_SSE2
+    l_int32 simdStart = (view->x + 15) & ~15;
+    l_int32 simdEnd   = (view->x + view->w) & ~15;
+    __m128i threshMinus1 = _mm_set1_epi8((char)(min_int32(max_int32(thresh, 1), 256) - 1));
+    if ((thresh <= 0) || (simdEnd < simdStart)) {
+        simdStart = simdEnd = view->x + view->w;
+    }
+#else
+    l_int32 simdStart = view->x + view->w;
+    l_int32 simdEnd   = simdStart;
+#endif
+
+    l_int32 i, x, k;
+    for (i=0; i<view->h; i++) {
+        const l_uint32 *lines = datas + (view->y + i) * wpls;
+        l_uint32       *lined = datad + i * wpld;
+
+        memset(rowBits, 0, nwords * sizeof(l_uint32));
+
+        for (x=view->x; x<view->x+view->w; x++) {
+            if (x == simdStart) {
+#ifdef USE_SSE2
+                for (; x<simdEnd; x+=16) {
+                    l_uint32 bits = ThresholdChunk16(lines + (x >> 2), threshMinus1, counts);
+                    rowBits[(x - base) >> 5] |= ((x - base) & 16) ? bits : (bits << 16);
+                }
+#endif
+                if (x >= view->x + view->w) break;
+            }
+            l_int32 val = GET_DATA_BYTE(lines, x);
+            if (val < thresh) {
+                rowBits[(x - base) >> 5] |= 0x80000000 >> ((x - base) & 31);
+            }
+            if (NULL != counts) {
+                counts[0][val]++;
+            }
+        }
+
+        for (k=0; k<wpld; k++) {
+            lined[k] = GetBinaryWord(rowBits, xStart + 32*k, xEnd);
+        }
+    }
 
+    free(rowBits);
+
+    if (NULL != phist) {
+        NUMA *na = numaCreate(256);
+        if (NULL != na) {
+            for (k=0; k<256; k++) {
+                numaAddNumber(na, counts[0][k] + counts[1][k] + counts[2][k] + counts[3][k]);
+            }
+        }
+        free(counts);
+        *phist = na;
+    }
+
+    return pixd;
+}
+
+
+/// ReduceViewRankBinary2()
+/// Same pels as pixReduceRankBinary2() with level 1 (a pel is black if any of
+/// the 2x2 pels it covers is black) on a 1bpp view, without clipping the view
+/// out of its parent first. Returns NULL if the view is smaller than 2x2.
+///____________________________________________________________________________
+PIX *ReduceViewRankBinary2(const PIXVIEW *view)
+{
+    assert(1 == pixGetDepth(view->pix));
+
+    l_int32 wd = view->w / 2;
+    l_int32 hd = view->h / 2;
+    if ((0 == wd) || (0 == hd)) return NULL;
+
+    PIX *pixd = pixCreate(wd, hd, 1);
+    if (NULL == pixd) return NULL;
+    pixCopyResolution(pixd, view->pix);
+    pixScaleResolution(pixd, 0.5, 0.5);
+
+    l_uint32 *datas = pixGetData(view->pix);
+    l_int32   wpls  = pixGetWpl(view->pix);
+    l_uint32 *datad = pixGetData(pixd);
+    l_int32   wpld  = pixGetWpl(pixd);
+    l_int32   xEnd  = view->x + 2*wd;
+    l_int32   nchunks = (wd + 15) / 16;
+
+    l_int32 i, k;
+    for (i=0; i<hd; i++) {
+        const l_uint32 *line1 = datas + (view->y + 2*i) * wpls;
+        const l_uint32 *line2 = line1 + wpls;
+        l_uint32       *lined = datad + i * wpld;
+        for (k=0; k<nchunks; k++) {
+            l_int32  x    = view->x + 32*k;
+            l_uint32 word = GetBinaryWord(line1, x, xEnd) | GetBinaryWord(line2, x, xEnd);
+
+            /// OR each pair of pels into the even bits, then pack the even
+            /// bits into the low 16
+            word = ((word | (word << 1)) >> 1) & 0x55555555;
+            word = (word | (word >> 1)) & 0x33333333;
+            word = (word | (word >> 2)) & 0x0f0f0f0f;
+            word = (word | (word >> 4)) & 0x00ff00ff;
+            word = (word | (word >> 8)) & 0x0000ffff;
+
+            if (0 == (k & 1)) {
+                lined[k >> 1] = word << 16;
+            } else {
+                lined[k >> 1] |= word;
+            }
+        }
+    }
+
+    return pixd;
+}
+
+
+/// FindSkewUsingProjections()
+/// Drop-in replacement for pixFindSkew() that uses the same sweep and binary
+/// search (default parameters, shear about the corner), but scores each angle
+/// directly from per-row black pel counts instead of shearing a copy of the
+/// image. Returns 0 if OK, 1 on error or if the image has no black pels.
+///____________________________________________________________________________
+l_int32 FindSkewUsingProjections(PIX       *pixb,
+                                 l_float32 *angle,
+                                 l_float32 *conf)
+{
+    *angle = 0.0;
+    *conf  = 0.0;
+
+    if ((NULL == pixb) || (1 != pixGetDepth(pixb))) {
+        return 1;
+    }
+
+    PIXVIEW view;
+    ViewInit(&view, pixb, NULL);
+    return FindSkewInView(&view, angle, conf);
+}
+
+
+/// FindSkewInView()
+/// FindSkewUsingProjections() on a 1bpp view. The 2x reduction reads the
+/// view directly, so the region of interest is never copied at full size.
+///____________________________________________________________________________
+l_int32 FindSkewInView(const PIXVIEW *view,
+                       l_float32     *angle,
+                       l_float32     *conf)
+{
+    *angle = 0.0;
+    *conf  = 0.0;
+
+    if ((NULL == view->pix) || (1 != pixGetDepth(view->pix))) {
+        return 1;
+    }
+
+    //reduce 2x for the binary search and 4x for the sweep
+    PIX *pixsch = ReduceViewRankBinary2(view);
+    if (NULL == pixsch) return 1;
+
+    l_int32 ret = FindSkewInReduced2(pixsch, angle, conf);
+    pixDestroy(&pixsch);
+    return ret;
+}
+
+
+/// FindSkewInReduced2()
+/// The rest of FindSkewInView(), given the view already reduced with
+/// ReduceViewRankBinary2(). Callers that see the image a strip at a time can
+/// build the reduced image row by row and never hold the full-size one.
+///____________________________________________________________________________
+l_int32 FindSkewInReduced2(PIX       *pixsch,
+                           l_float32 *angle,
+                           l_float32 *conf)
+{
+    const l_float32 sweepRange   = 7.0;  //degrees
+    const l_float32 sweepDelta   = 1.0;  //degrees
+    const l_float32 minBSDelta   = 0.01; //degrees
+    const l_int32   minValidMaxScore = 10000;
+    const l_float32 minScoreThreshConstant = 0.000002;
+
+    *angle = 0.0;
+    *conf  = 0.0;
+
+    l_int32 isZero;
+    pixZero(pixsch, &isZero);
+    if (isZero) {
+        return 1;
+    }
+
+    PIX *pixsw = pixReduceRankBinaryCascade(pixsch, 1, 0, 0, 0);
+    if (NULL == pixsw) {
+        return 1;
+    }
+
+    l_int32 *prefixSw  = CreateRowPrefixCounts(pixsw);
+    l_int32 *prefixSch = CreateRowPrefixCounts(pixsch);
+    l_int32 *rowSums   = (l_int32 *)malloc(pixGetHeight(pixsch) * sizeof(l_int32));
+    l_int32 *stripX    = (l_int32 *)malloc((pixGetWidth(pixsch)+2) * sizeof(l_int32));
+    if ((NULL == prefixSw) || (NULL == prefixSch) || (NULL == rowSums) || (NULL == stripX)) {
+        free(prefixSw);
+        free(prefixSch);
+        free(rowSums);
+        free(stripX);
+        pixDestroy(&pixsw);
+        return 1;
+    }
+
+    l_int32   i;
+    l_int32   nangles = (l_int32)((2. * sweepRange) / sweepDelta + 1);
+    l_float32 rangeLeft = -sweepRange;
+    l_float32 maxScore = 0.0, minScore = 0.0;
+    l_int32   maxIndex = 0;
+
+    /// sweep
+    for (i=0; i<nangles; i++) {
+        l_float32 theta = rangeLeft + i * sweepDelta;
+        l_float32 score = CalculateShearedDiffSquareSum(pixsw, prefixSw, deg2rad * theta, rowSums, stripX);
+        if ((0 == i) || (score > maxScore)) {
+            maxScore = score;
+            maxIndex = i;
+        }
+        if ((0 == i) || (score < minScore)) {
+            minScore = score;
+        }
+    }
+
+    l_float32 centerAngle = rangeLeft + maxIndex * sweepDelta;
+
+    if ((0 == maxIndex) || (nangles-1 == maxIndex)) {
+        debugstr("FindSkewUsingProjections: max found at sweep edge\n");
+    } else {
+        /// binary search, using the less reduced image
+        l_float32 scores[5];
+        scores[2] = CalculateShearedDiffSquareSum(pixsch, prefixSch, deg2rad * centerAngle, rowSums, stripX);
+        scores[0] = CalculateShearedDiffSquareSum(pixsch, prefixSch, deg2rad * (centerAngle - sweepDelta), rowSums, stripX);
+        scores[4] = CalculateShearedDiffSquareSum(pixsch, prefixSch, deg2rad * (centerAngle + sweepDelta), rowSums, stripX);
+        minScore = scores[2];
+        if (scores[0] < minScore) minScore = scores[0];
+        if (scores[4] < minScore) minScore = scores[4];
+
+        l_float32 delta = 0.5 * sweepDelta;
+        while (delta >= minBSDelta) {
+            scores[1] = CalculateShearedDiffSquareSum(pixsch, prefixSch, deg2rad * (centerAngle - delta), rowSums, stripX);
+            scores[3] = CalculateShearedDiffSquareSum(pixsch, prefixSch, deg2rad * (centerAngle + delta), rowSums, stripX);
+            if (scores[1] < minScore) minScore = scores[1];
+            if (scores[3] < minScore) minScore = scores[3];
+
+            //the max must be one of the center three scores
+            maxScore = scores[1];
+            l_int32 maxi = 1;
+            for (i=2; i<4; i++) {
+                if (scores[i] > maxScore) {
+                    maxScore = scores[i];
+                    maxi = i;
+                }
+            }
+
+            l_float32 left  = scores[maxi-1];
+            l_float32 right = scores[maxi+1];
+            scores[2] = maxScore;
+            scores[0] = left;
+            scores[4] = right;
+
+            centerAngle = centerAngle + delta * (maxi - 2);
+            delta = 0.5 * delta;
+        }
+        *angle = centerAngle;
+
+        //don't trust the ratio if the min score is too small (nearly all-black image)
+        l_int32 wsch = pixGetWidth(pixsch);
+        l_int32 hsch = pixGetHeight(pixsch);
+        l_float32 minThresh = minScoreThreshConstant * wsch * wsch * hsch;
+        if (minScore > minThresh) {
+            *conf = maxScore / minScore;
+        }
+
+        //don't trust it if too close to the edge of the sweep range, or if maxScore is small
+        if ((centerAngle > rangeLeft + 2 * sweepRange - sweepDelta) ||
+            (centerAngle < rangeLeft + sweepDelta) ||
+            (maxScore < minValidMaxScore)) {
+            *conf = 0.0;
+        }
+    }
+
+    free(prefixSw);
+    free(prefixSch);
+    free(rowSums);
+    free(stripX);
+    pixDestroy(&pixsw);
     return 0;
 }
+
+
+#define ROTATE_TILE_SIZE 32  //pels, for both 8bpp and 32bpp
+
+/// RotateRect90()
+/// Scalar rotation of the source rectangle [x0,x1) x [y0,y1). Used for whole
+/// tiles when SSE2 is not available, and for the leftover edges otherwise.
+/// direction is 1 for clockwise and -1 for counter-clockwise, as in
+/// pixRotate90(). (x,y) in the source lands at (h-1-y,x) for clockwise and at
+/// (y,w-1-x) for counter-clockwise. Source row y is at datas + wpls*(y-yBase).
+///____________________________________________________________________________
+static void RotateRect90(l_uint32       *datad,
+                         l_int32         wpld,
+                         const l_uint32 *datas,
+                         l_int32         wpls,
+                         l_int32         yBase,
+                         l_int32         w,
+                         l_int32         h,
+                         l_int32         d,
+                         l_int32         direction,
+                         l_int32         x0,
+                         l_int32         x1,
+                         l_int32         y0,
+                         l_int32         y1)
+{
+    l_int32 x, y;
+
+    for (x=x0; x<x1; x++) {
+        l_uint32 *lined = datad + wpld * ((1 == direction) ? x : (w-1-x));
+        for (y=y0; y<y1; y++) {
+            const l_uint32 *lines = datas + wpls * (y-yBase);
+            l_int32 xd = (1 == direction) ? (h-1-y) : y;
+            if (8 == d) {
+                SET_DATA_BYTE(lined, xd, GET_DATA_BYTE(lines, x));
+            } else {
+                lined[xd] = lines[x];
+            }
+        }
+    }
+}
+
+
+#ifdef USE_SSE2
+/// Transpose16x16Bytes()
+/// Four rounds of interleaving row i with row i+8. Each round rotates the
+/// (row, byte) index bits by one, so after four rounds the byte at (i, k) has
+/// moved to (k, i).
+///____________________________________________________________________________
+static inline void Transpose16x16Bytes(__m128i *a)
+{
+    __m128i b[16];
+    l_int32 round, i;
+
+    for (round=0; round<4; round++) {
+        for (i=0; i<8; i++) {
+            b[2*i]   = _mm_unpacklo_epi8(a[i], a[i+8]);
+            b[2*i+1] = _mm_unpackhi_epi8(a[i], a[i+8]);
+        }
+        for (i=0; i<16; i++) {
+            a[i] = b[i];
+        }
+    }
+}
+
+
+/// RotateBlock90_8()
+/// Rotate one 16x16 block of an 8bpp image. The block origin must be word
+/// aligned in both the source and the destination rows. On little-endian
+/// machines the pel at x is stored in byte x^3 of the row, so the source rows
+/// are loaded in the order that puts them in the right destination bytes, and
+/// the transposed rows are stored to the destination row of the pel they came
+/// from.
+///____________________________________________________________________________
+static inline void RotateBlock90_8(l_uint32       *datad,
+                                   l_int32         wpld,
+                                   const l_uint32 *datas,
+                                   l_int32         wpls,
+                                   l_int32         yBase,
+                                   l_int32         w,
+                                   l_int32         h,
+                                   l_int32         direction,
+                                   l_int32         x0,
+                                   l_int32         y0)
+{
+    __m128i a[16];
+    l_int32 i;
+
+    for (i=0; i<16; i++) {
+        l_int32 y = (1 == direction) ? (y0 + 15 - (i^3)) : (y0 + (i^3));
+        a[i] = _mm_loadu_si128((const __m128i *)((const l_uint8 *)(datas + wpls*(y-yBase)) + x0));
+    }
+
+    Transpose16x16Bytes(a);
+
+    l_int32 xd = (1 == direction) ? (h - 16 - y0) : y0;
+    for (i=0; i<16; i++) {
+        l_int32 x  = x0 + (i^3);
+        l_int32 yd = (1 == direction) ? x : (w-1-x);
+        _mm_storeu_si128((__m128i *)((l_uint8 *)(datad + wpld*yd) + xd), a[i]);
+    }
+}
+
+
+/// RotateBlock90_32()
+/// Rotate one 4x4 block of a 32bpp image
+///____________________________________________________________________________
+static inline void RotateBlock90_32(l_uint32       *datad,
+                                    l_int32         wpld,
+                                    const l_uint32 *datas,
+                                    l_int32         wpls,
+                                    l_int32         yBase,
+                                    l_int32         w,
+                                    l_int32         h,
+                                    l_int32         direction,
+                                    l_int32         x0,
+                                    l_int32         y0)
+{
+    __m128i r[4], t[4];
+    l_int32 i;
+
+    for (i=0; i<4; i++) {
+        l_int32 y = (1 == direction) ? (y0 + 3 - i) : (y0 + i);
+        r[i] = _mm_loadu_si128((const __m128i *)(datas + wpls*(y-yBase) + x0));
+    }
+
+    t[0] = _mm_unpacklo_epi32(r[0], r[1]);
+    t[1] = _mm_unpacklo_epi32(r[2], r[3]);
+    t[2] = _mm_unpackhi_epi32(r[0], r[1]);
+    t[3] = _mm_unpackhi_epi32(r[2], r[3]);
+    r[0] = _mm_unpacklo_epi64(t[0], t[1]);
+    r[1] = _mm_unpackhi_epi64(t[0], t[1]);
+    r[2] = _mm_unpacklo_epi64(t[2], t[3]);
+    r[3] = _mm_unpackhi_epi64(t[2], t[3]);
+
+    l_int32 xd = (1 == direction) ? (h - 4 - y0) : y0;
+    for (i=0; i<4; i++) {
+        l_int32 yd = (1 == direction) ? (x0 + i) : (w-1-x0-i);
+        _mm_storeu_si128((__m128i *)(datad + wpld*yd + xd), r[i]);
+    }
+}
+#endif //USE_SSE2
+
+
+/// RotateRows90()
+/// Rotate source rows [y0,y1) of a w x h 8bpp or 32bpp image into pixd, which
+/// must be h x w with the same depth. datas points at row y0, so the rows can
+/// come from a small strip buffer, e.g. while decoding a jpeg. Rotating all
+/// the rows of an image in consecutive strips gives the same result as one
+/// call over [0,h); strips are cheapest when their first row is a multiple of
+/// 4 away from h (clockwise) or from 0 (counter-clockwise).
+///____________________________________________________________________________
+void RotateRows90(PIX            *pixd,
+                  const l_uint32 *datas,
+                  l_int32         wpls,
+                  l_int32         w,
+                  l_int32         h,
+                  l_int32         y0,
+                  l_int32         y1,
+                  l_int32         direction)
+{
+    l_int32   d     = pixGetDepth(pixd);
+    l_uint32 *datad = pixGetData(pixd);
+    l_int32   wpld  = pixGetWpl(pixd);
+
+    assert((8 == d) || (32 == d));
+    assert((pixGetWidth(pixd) == h) && (pixGetHeight(pixd) == w));
+    assert((1 == direction) || (-1 == direction));
+
+    /// the block grid covers [0,xEnd) x [yStart,yEnd); the rest is done by
+    /// RotateRect90(). For 8bpp, yStart lines the destination column of each
+    /// block up with a word boundary.
+#ifdef USE_SSE2
+    l_int32 block  = (8 == d) ? 16 : 4;
+    l_int32 yStart = y0;
+    if (8 == d) {
+        l_int32 origin = (1 == direction) ? h : 0;
+        yStart += ((origin - y0) % 4 + 4) % 4;
+        if (yStart > y1) yStart = y1;
+    }
+#else
+    l_int32 block  = 1;
+    l_int32 yStart = y0;
+#endif
+    l_int32 xEnd = (w / block) * block;
+    l_int32 yEnd = yStart + ((y1 - yStart) / block) * block;
+
+    l_int32 tx, ty, x, y;
+    for (ty=yStart; ty<yEnd; ty+=ROTATE_TILE_SIZE) {
+        l_int32 tyEnd = min_int32(ty + ROTATE_TILE_SIZE, yEnd);
+        for (tx=0; tx<xEnd; tx+=ROTATE_TILE_SIZE) {
+            l_int32 txEnd = min_int32(tx + ROTATE_TILE_SIZE, xEnd);
+#ifdef USE_SSE2
+            for (x=tx; x<txEnd; x+=block) {
+                for (y=ty; y<tyEnd; y+=block) {
+                    if (8 == d) {
+                        RotateBlock90_8(datad, wpld, datas, wpls, y0, w, h, direction, x, y);
+                    } else {
+                        RotateBlock90_32(datad, wpld, datas, wpls, y0, w, h, direction, x, y);
+                    }
+                }
+            }
+#else
+            RotateRect90(datad, wpld, datas, wpls, y0, w, h, d, direction, tx, txEnd, ty, tyEnd);
+#endif
+        }
+    }
+
+    RotateRect90(datad, wpld, datas, wpls, y0, w, h, d, direction, 0, w, y0, yStart);
+    RotateRect90(datad, wpld, datas, wpls, y0, w, h, d, direction, 0, w, yEnd, y1);
+    RotateRect90(datad, wpld, datas, wpls, y0, w, h, d, direction, xEnd, w, yStart, yEnd);
+}
+
+
+/// Rotate90Tiled()
+/// Same result as pixRotate90(), but walks the image in square tiles so that
+/// both the source rows and the destination rows being touched stay in cache.
+/// pixRotate90() reads a full column of the source for each destination row,
+/// which misses the cache on every pel for wide images. With SSE2 the tiles
+/// are made of 16x16 (8bpp) or 4x4 (32bpp) register transposes. Other depths
+/// are passed through to pixRotate90().
+///____________________________________________________________________________
+PIX *Rotate90Tiled(PIX *pixs, l_int32 direction)
+{
+    if (NULL == pixs) return NULL;
+    if ((1 != direction) && (-1 != direction)) return NULL;
+
+    l_int32 w, h, d;
+    pixGetDimensions(pixs, &w, &h, &d);
+    if ((8 != d) && (32 != d)) {
+        return pixRotate90(pixs, direction);
+    }
+
+    PIX *pixd = pixCreateNoInit(h, w, d);
+    if (NULL == pixd) return NULL;
+    pixCopyColormap(pixd, pixs);
+    pixCopyResolution(pixd, pixs);
+    pixCopyInputFormat(pixd, pixs);
+
+    RotateRows90(pixd, pixGetData(pixs), pixGetWpl(pixs), w, h, 0, h, direction);
+
+    return pixd;
+}
+
+
+#define kVerySmallAngle 0.001 //radians, as VERY_SMALL_ANGLE in Leptonica's rotate.c
+
+/// GetRotateSourceRect()
+/// The rectangle of source pels that RotateRegionLow() reads for the part of
+/// the rotated w x h image inside box, clipped to the image, as [x0,x1] x
+/// [y0,y1]. The source position is linear in the destination position, so its
+/// extremes are at the corners of the box. Returns 1 if no pels are read.
+///____________________________________________________________________________
+static l_int32 GetRotateSourceRect(l_int32    w,
+                                   l_int32    h,
+                                   l_float32  angle,
+                                   BOX       *box,
+                                   l_int32   *px0,
+                                   l_int32   *py0,
+                                   l_int32   *px1,
+                                   l_int32   *py1)
+{
+    l_int32   xcen = w / 2;
+    l_int32   ycen = h / 2;
+    l_float32 sina = 16. * sin(angle);
+    l_float32 cosa = 16. * cos(angle);
+
+    l_int32 k;
+    for (k=0; k<4; k++) {
+        l_int32 xdif = xcen - (box->x + ((k & 1) ? box->w - 1 : 0));
+        l_int32 ydif = ycen - (box->y + ((k & 2) ? box->h - 1 : 0));
+        l_int32 xp   = xcen + ((l_int32)(-xdif * cosa - ydif * sina) >> 4);
+        l_int32 yp   = ycen + ((l_int32)(-ydif * cosa + xdif * sina) >> 4);
+        if ((0 == k) || (xp < *px0)) *px0 = xp;
+        if ((0 == k) || (xp > *px1)) *px1 = xp;
+        if ((0 == k) || (yp < *py0)) *py0 = yp;
+        if ((0 == k) || (yp > *py1)) *py1 = yp;
+    }
+
+    /// interpolation reads one more pel to the right and below
+    *px0 = max_int32(*px0, 0);
+    *py0 = max_int32(*py0, 0);
+    *px1 = min_int32(*px1 + 1, w - 1);
+    *py1 = min_int32(*py1 + 1, h - 1);
+
+    return ((*px0 > *px1) || (*py0 > *py1));
+}
+
+
+/// RotateRegionLow()
+/// Does the work for RotateRegionAMGray() and RotatePartsRegionAMGray(). The
+/// rotated image is w x h, and pixs holds its source pels from (xs, ys) on.
+/// Every pel read must be in pixs.
+///____________________________________________________________________________
+static PIX *RotateRegionLow(PIX       *pixs,
+                            l_int32    xs,
+                            l_int32    ys,
+                            l_int32    w,
+                            l_int32    h,
+                            l_float32  angle,
+                            l_uint8    grayval,
+                            BOX       *box)
+{
+    assert(8 == pixGetDepth(pixs));
+    assert((box->x >= 0) && (box->y >= 0) && (box->x + box->w <= w) && (box->y + box->h <= h));
+
+    /// pixRotate() returns the image unchanged for tiny angles
+    if (fabs(angle) < kVerySmallAngle) {
+        BOX *boxs = boxCreate(box->x - xs, box->y - ys, box->w, box->h);
+        PIX *pixd = pixClipRectangle(pixs, boxs, NULL);
+        boxDestroy(&boxs);
+        return pixd;
+    }
+
+    PIX *pixd = pixCreateNoInit(box->w, box->h, 8);
+    if (NULL == pixd) return NULL;
+    pixCopyResolution(pixd, pixs);
+
+    l_uint32 *datas = pixGetData(pixs);
+    l_int32   wpls  = pixGetWpl(pixs);
+    l_uint32 *datad = pixGetData(pixd);
+    l_int32   wpld  = pixGetWpl(pixd);
+
+    l_int32   xcen = w / 2;
+    l_int32   ycen = h / 2;
+    l_int32   wm2  = w - 2;
+    l_int32   hm2  = h - 2;
+    l_float32 sina = 16. * sin(angle);
+    l_float32 cosa = 16. * cos(angle);
+
+    l_int32 i, j;
+    for (i=0; i<box->h; i++) {
+        l_int32   ydif  = ycen - (box->y + i);
+        l_uint32 *lined = datad + i * wpld;
+        for (j=0; j<box->w; j++) {
+            l_int32 xdif = xcen - (box->x + j);
+            l_int32 xpm  = (l_int32)(-xdif * cosa - ydif * sina);
+            l_int32 ypm  = (l_int32)(-ydif * cosa + xdif * sina);
+            l_int32 xp   = xcen + (xpm >> 4);
+            l_int32 yp   = ycen + (ypm >> 4);
+            l_int32 xf   = xpm & 0x0f;
+            l_int32 yf   = ypm & 0x0f;
+
+            if ((xp < 0) || (yp < 0) || (xp > wm2) || (yp > hm2)) {
+                SET_DATA_BYTE(lined, j, grayval);
+                continue;
+            }
+
+            const l_uint32 *lines = datas + (yp - ys) * wpls;
+            l_int32 xps = xp - xs;
+            l_int32 v00 = (16 - xf) * (16 - yf) * GET_DATA_BYTE(lines, xps);
+            l_int32 v10 = xf * (16 - yf) * GET_DATA_BYTE(lines, xps + 1);
+            l_int32 v01 = (16 - xf) * yf * GET_DATA_BYTE(lines + wpls, xps);
+            l_int32 v11 = xf * yf * GET_DATA_BYTE(lines + wpls, xps + 1);
+            SET_DATA_BYTE(lined, j, (l_uint8)((v00 + v01 + v10 + v11 + 128) / 256));
+        }
+    }
+
+    return pixd;
+}
+
+
+/// RotateRegionAMGray()
+/// The part of pixRotate(pixs, angle, L_ROTATE_AREA_MAP, ...) that falls
+/// inside box, for an 8bpp image, without rotating the rest. The arithmetic
+/// is the same as Leptonica's rotateAMGrayLow(): rotation about the center of
+/// pixs, 1/16 pel interpolation, and grayval for pels from outside pixs.
+/// Like pixRotate(), angles below 0.001 radians copy the pels unchanged.
+/// The box must be inside pixs.
+///____________________________________________________________________________
+PIX *RotateRegionAMGray(PIX       *pixs,
+                        l_float32  angle,
+                        l_uint8    grayval,
+                        BOX       *box)
+{
+    return RotateRegionLow(pixs, 0, 0, pixGetWidth(pixs), pixGetHeight(pixs), angle, grayval, box);
+}
+
+
+/// RotatePartsRegionAMGray()
+/// RotateRegionAMGray() for an image of which only some parts are kept. Uses
+/// the first part that holds every source pel the box needs. Returns NULL if
+/// no part does.
+///____________________________________________________________________________
+PIX *RotatePartsRegionAMGray(const GRAYPARTS *parts,
+                             l_float32        angle,
+                             l_uint8          grayval,
+                             BOX             *box)
+{
+    l_int32 x0, y0, x1, y1;
+    if (fabs(angle) < kVerySmallAngle) {
+        x0 = box->x;
+        y0 = box->y;
+        x1 = box->x + box->w - 1;
+        y1 = box->y + box->h - 1;
+    } else if (GetRotateSourceRect(parts->w, parts->h, angle, box, &x0, &y0, &x1, &y1)) {
+        /// every pel comes from outside the image; any part will do
+        x0 = x1 = parts->x[0];
+        y0 = y1 = parts->y[0];
+    }
+
+    l_int32 k;
+    for (k=0; k<parts->n; k++) {
+        PIX *pix = parts->pix[k];
+        if ((x0 >= parts->x[k]) && (y0 >= parts->y[k]) &&
+            (x1 < parts->x[k] + pixGetWidth(pix)) && (y1 < parts->y[k] + pixGetHeight(pix))) {
+            return RotateRegionLow(pix, parts->x[k], parts->y[k], parts->w, parts->h, angle, grayval, box);
+        }
+    }
+    return NULL;
+}
+
+
+/// GrayPartsInit()
+/// Start an empty set of parts of a w x h 8bpp image.
+///____________________________________________________________________________
+void GrayPartsInit(GRAYPARTS *parts, l_int32 w, l_int32 h)
+{
+    parts->w = w;
+    parts->h = h;
+    parts->n = 0;
+}
+
+
+/// GrayPartsAdd()
+/// Add a part covering the rectangle (x, y, pw, ph) of the image, clipped to
+/// it. If pix is NULL, an uninitialized PIX is made for the caller to fill in,
+/// otherwise the part is a clone of pix, which must be the size of the
+/// clipped rectangle. Returns 0 if OK, 1 on error.
+///____________________________________________________________________________
+l_int32 GrayPartsAdd(GRAYPARTS *parts, PIX *pix, l_int32 x, l_int32 y, l_int32 pw, l_int32 ph)
+{
+    if (parts->n >= kMaxGrayParts) return 1;
+
+    l_int32 x0 = max_int32(x, 0);
+    l_int32 y0 = max_int32(y, 0);
+    l_int32 x1 = min_int32(x + pw, parts->w);
+    l_int32 y1 = min_int32(y + ph, parts->h);
+    if ((x1 <= x0) || (y1 <= y0)) return 1;
+
+    PIX *pixp;
+    if (NULL == pix) {
+        pixp = pixCreateNoInit(x1 - x0, y1 - y0, 8);
+    } else {
+        assert((8 == pixGetDepth(pix)) && (pixGetWidth(pix) == x1 - x0) && (pixGetHeight(pix) == y1 - y0));
+        pixp = pixClone(pix);
+    }
+    if (NULL == pixp) return 1;
+
+    parts->pix[parts->n] = pixp;
+    parts->x[parts->n]   = x0;
+    parts->y[parts->n]   = y0;
+    parts->n++;
+    return 0;
+}
+
+
+/// GrayPartsCopyRows()
+/// Copy rows [y0, y0+n) of the image, given as a strip that starts at row y0,
+/// into every part that covers some of them.
+///____________________________________________________________________________
+void GrayPartsCopyRows(GRAYPARTS *parts, PIX *pixStrip, l_int32 y0, l_int32 n)
+{
+    l_int32 k;
+    for (k=0; k<parts->n; k++) {
+        PIX    *pixp = parts->pix[k];
+        l_int32 r0   = max_int32(y0, parts->y[k]);
+        l_int32 r1   = min_int32(y0 + n, parts->y[k] + pixGetHeight(pixp));
+        if (r1 <= r0) continue;
+        pixRasterop(pixp, 0, r0 - parts->y[k], pixGetWidth(pixp), r1 - r0,
+                    PIX_SRC, pixStrip, parts->x[k], r0 - y0);
+    }
+}
+
+
+/// GrayPartsBytes()
+/// Memory held by the parts.
+///____________________________________________________________________________
+size_t GrayPartsBytes(const GRAYPARTS *parts)
+{
+    size_t  bytes = 0;
+    l_int32 k;
+    for (k=0; k<parts->n; k++) {
+        bytes += (size_t)4 * pixGetWpl(parts->pix[k]) * pixGetHeight(parts->pix[k]);
+    }
+    return bytes;
+}
+
+
+/// GrayPartsDestroy()
+/// Free the parts.
+///____________________________________________________________________________
+void GrayPartsDestroy(GRAYPARTS *parts)
+{
+    l_int32 k;
+    for (k=0; k<parts->n; k++) {
+        pixDestroy(&parts->pix[k]);
+    }
+    parts->n = 0;
+}
@@ -17,6 +17,23 @@
 #define kSkewModeEdge 1
 #define kSkewModeNone 2
 
+/// A rectangle of a parent PIX. Views share the parent's data and stride and
+/// own nothing, so the parent must outlive them.
+typedef struct PixView {
+    PIX     *pix;
+    l_int32  x, y, w, h;
+} PIXVIEW;
+
+/// Some rectangles of a w x h 8bpp image that is too large to hold at once.
+/// pix[k] holds the pels of the image from (x[k], y[k]) on.
+#define kMaxGrayParts 4
+typedef struct GrayParts {
+    l_int32  w, h;
+    l_int32  n;
+    PIX     *pix[kMaxGrayParts];
+    l_int32  x[kMaxGrayParts], y[kMaxGrayParts];
+} GRAYPARTS;
+
 
 l_uint32 calcLimitLeft(l_uint32 w, l_uint32 h, l_float32 angle);
 l_uint32 calcLimitTop(l_uint32 w, l_uint32 h, l_float32 angle);
@@ -30,6 +47,7 @@ l_int32 FindBindingEdge2(PIX      *pixg,
                          l_int32 textBlockL,
                          l_int32 textBlockR);
 
+l_int32 ChooseGrayChannel(PIX *pix, l_int32 verbose);
 PIX* ConvertToGray(PIX *pix, l_int32 *grayChannel);
 
 
@@ -75,6 +93,8 @@ l_int32 CalculateTreshInitial(PIX *pixg, l_int32 *histmax);
 
 l_int32 RemoveBackgroundTop(PIX *pixg, l_int32 rotDir, l_int32 initialBlackThresh);
 l_int32 RemoveBackgroundBottom(PIX *pixg, l_int32 rotDir, l_int32 initialBlackThresh);
+l_int32 RemoveBackgroundTopFrom(PIX *pixg, l_int32 rotDir, l_int32 initialBlackThresh, l_int32 jStart);
+l_int32 RemoveBackgroundBottomFrom(PIX *pixg, l_int32 rotDir, l_int32 initialBlackThresh, l_int32 jStart);
 
 l_int32 CalculateNumBlackPelsRow(PIX *pixg, l_int32 j, l_int32 limitL, l_int32 limitR, l_uint32 blackThresh);
 l_int32 CalculateNumBlackPelsCol(PIX *pixg, l_int32 i, l_int32 limitT, l_int32 limitB, l_uint32 blackThresh);
@@ -109,12 +129,70 @@ l_int32 FindBindingUsingBlackBar(PIX      *pixg,
 
 
 l_int32 RemoveBackgroundOuter(PIX *pixg, l_int32 rotDir, l_uint32 topEdge, l_uint32 bottomEdge, l_int32 initialBlackThresh);
+l_int32 RemoveBackgroundOuterFrom(PIX *pixg, l_int32 rotDir, l_uint32 topEdge, l_uint32 bottomEdge, l_int32 initialBlackThresh, l_int32 iStart);
 
 l_uint32 RemoveBlackPelsBlockColRight(PIX *pixg, l_uint32 starti, l_uint32 endi, l_uint32 top, l_uint32 bottom, l_uint32 kernelWidth, l_uint32 blackThresh);
 l_uint32 RemoveBlackPelsBlockColLeft(PIX *pixg, l_uint32 starti, l_uint32 endi, l_uint32 top, l_uint32 bottom, l_uint32 kernelWidth, l_uint32 blackThresh);
 l_uint32 RemoveBlackPelsBlockRowTop(PIX *pixg, l_uint32 startj, l_uint32 endj, l_uint32 left, l_uint32 right, l_uint32 kernelWidth, l_uint32 blackThresh);
 l_uint32 RemoveBlackPelsBlockRowBot(PIX *pixg, l_uint32 startj, l_uint32 endj, l_uint32 left, l_uint32 right, l_uint32 kernelWidth, l_uint32 blackThresh);
 
+l_int32 FindTextBlockCol_L(PIX *pixg, l_uint32 left, l_uint32 right, l_uint32 top, l_uint32 bottom, double thresh, l_uint32 threshBinding, l_int32 *retj, double *retVar);
+l_int32 FindTextBlockCol_R(PIX *pixg, l_uint32 left, l_uint32 right, l_uint32 top, l_uint32 bottom, double thresh, l_uint32 threshBinding, l_int32 *retj, double *retVar);
+l_int32 FindTextBlockRow_T(PIX *pixg, l_uint32 left, l_uint32 right, l_uint32 top, l_uint32 bottom, double thresh, l_int32 *retj, double *retVar);
+l_int32 FindTextBlockRow_B(PIX *pixg, l_uint32 left, l_uint32 right, l_uint32 top, l_uint32 bottom, double thresh, l_int32 *retj, double *retVar);
+
+l_int32 ViewInit(PIXVIEW *view, PIX *pix, BOX *box);
+PIX *ViewCopy(const PIXVIEW *view);
+PIX *ThresholdViewToBinary(const PIXVIEW *view, l_int32 thresh);
+PIX *ThresholdViewAndHistogram(const PIXVIEW *view, l_int32 thresh, NUMA **phist);
+NUMA *GetViewGrayHistogram(const PIXVIEW *view);
+
+l_int32 OtsuAdaptiveThreshold(PIX       *pixs,
+                              l_int32    sx,
+                              l_int32    sy,
+                              l_int32    smoothx,
+                              l_int32    smoothy,
+                              l_float32  scorefract,
+                              PIX      **ppixth,
+                              PIX      **ppixd);
+
+l_int32 FindSkewUsingProjections(PIX       *pixb,
+                                 l_float32 *angle,
+                                 l_float32 *conf);
+l_int32 FindSkewInView(const PIXVIEW *view,
+                       l_float32     *angle,
+                       l_float32     *conf);
+PIX *ReduceViewRankBinary2(const PIXVIEW *view);
+l_int32 FindSkewInReduced2(PIX       *pixsch,
+                           l_float32 *angle,
+                           l_float32 *conf);
+
+void RotateRows90(PIX            *pixd,
+                  const l_uint32 *datas,
+                  l_int32         wpls,
+                  l_int32         w,
+                  l_int32         h,
+                  l_int32         y0,
+                  l_int32         y1,
+                  l_int32         direction);
+
+PIX *Rotate90Tiled(PIX *pixs, l_int32 direction);
+
+PIX *RotateRegionAMGray(PIX       *pixs,
+                        l_float32  angle,
+                        l_uint8    grayval,
+                        BOX       *box);
+PIX *RotatePartsRegionAMGray(const GRAYPARTS *parts,
+                             l_float32        angle,
+                             l_uint8          grayval,
+                             BOX             *box);
+
+void GrayPartsInit(GRAYPARTS *parts, l_int32 w, l_int32 h);
+l_int32 GrayPartsAdd(GRAYPARTS *parts, PIX *pix, l_int32 x, l_int32 y, l_int32 pw, l_int32 ph);
+void GrayPartsCopyRows(GRAYPARTS *parts, PIX *pixStrip, l_int32 y0, l_int32 n);
+size_t GrayPartsBytes(const GRAYPARTS *parts);
+void GrayPartsDestroy(GRAYPARTS *parts);
+
 int FindInnerCrop(PIX *pixBigT,
     l_uint32 threshBinding,
     l_int32 outerCropL,
@@ -7,12 +7,14 @@ autoCropFoldout filein.jpg
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h> //for strcmp
 #include "allheaders.h"
 #include <assert.h>
 #include <math.h>   //for sqrt
 #include <float.h>  //for DBL_MAX
 #include <limits.h> //for INT_MAX
 #include "autoCropCommon.h"
+#include "autoCropJpeg.h"
 #include "autocrop_remove_bg.h"
 
 
@@ -33,6 +35,257 @@ static inline l_int32 max (l_int32 a, l_int32 b) {
     return a - ((a-b) & (a-b)>>31);
 }
 
+#define kMinRotateAngle 0.001 //radians, pixRotate() does not rotate below this
+
+/*  --tiled mode, for foldouts and maps too large to decode at once. The full
+    size image is decoded three times, a strip at a time:
+      1. gray histogram of the whole image, for the Otsu threshold
+      2. the skew box, bitonalized and reduced 2x for FindSkewInReduced2()
+      3. gray parts around the four proxy edges, for remove_bg_border_bands()
+    Only the reduced skew box and the edge parts are kept between strips. If a
+    band grows past its part, pass 3 is rerun with larger parts.
+*/
+#define kTiledDefaultCapMB 1024
+#define kTiledMinStripRows 16
+#define kTiledMaxStripRows 512
+
+struct TiledHist {
+    l_float64 counts[256];
+};
+
+struct TiledSkew {
+    l_int32  thresh;
+    l_int32  bx, by, bw, bh;  //skew box, clipped to the image
+    PIX     *pixPairs;        //bitonalized box rows waiting to be reduced
+    l_int32  carry;           //1 if row 0 of pixPairs is left from the last strip
+    PIX     *pixsch;          //the box reduced 2x
+    l_int32  nextRow;
+};
+
+
+/// TiledHistStrip()
+/// Pass 1: add the strip to the histogram.
+///____________________________________________________________________________
+static l_int32 TiledHistStrip(PIX *pixStrip, l_int32 y0, l_int32 n, l_int32 w, l_int32 h, void *data)
+{
+    struct TiledHist *th = (struct TiledHist *)data;
+
+    PIXVIEW view = {pixStrip, 0, 0, w, n};
+    NUMA *hist = GetViewGrayHistogram(&view);
+    if (NULL == hist) return 1;
+
+    l_int32 i;
+    for (i=0; i<256; i++) {
+        l_float32 val;
+        numaGetFValue(hist, i, &val);
+        th->counts[i] += val;
+    }
+    numaDestroy(&hist);
+    return 0;
+}
+
+
+/// TiledSkewStrip()
+/// Pass 2: bitonalize the rows of the strip inside the skew box and reduce
+/// them 2x into pixsch. Rows are reduced in pairs counted from the top of the
+/// box, so an odd row at the end of a strip waits for the next one.
+///____________________________________________________________________________
+static l_int32 TiledSkewStrip(PIX *pixStrip, l_int32 y0, l_int32 n, l_int32 w, l_int32 h, void *data)
+{
+    struct TiledSkew *ts = (struct TiledSkew *)data;
+
+    l_int32 r0 = max(y0, ts->by);
+    l_int32 r1 = min(y0 + n, ts->by + 2*pixGetHeight(ts->pixsch));
+    if (r1 <= r0) return 0;
+
+    PIXVIEW view = {pixStrip, ts->bx, r0 - y0, ts->bw, r1 - r0};
+    PIX *pixt = ThresholdViewToBinary(&view, ts->thresh);
+    if (NULL == pixt) return 1;
+
+    l_int32 wpl = pixGetWpl(ts->pixPairs);
+    memcpy(pixGetData(ts->pixPairs) + ts->carry * wpl, pixGetData(pixt), sizeof(l_uint32) * wpl * (r1 - r0));
+    pixDestroy(&pixt);
+
+    l_int32 rows  = ts->carry + r1 - r0;
+    l_int32 pairs = rows / 2;
+    if (pairs > 0) {
+        PIXVIEW viewPairs = {ts->pixPairs, 0, 0, ts->bw, 2*pairs};
+        PIX *pixr = ReduceViewRankBinary2(&viewPairs);
+        if (NULL == pixr) return 1;
+        l_int32 wplr = pixGetWpl(ts->pixsch);
+        memcpy(pixGetData(ts->pixsch) + ts->nextRow * wplr, pixGetData(pixr), sizeof(l_uint32) * wplr * pairs);
+        pixDestroy(&pixr);
+        ts->nextRow += pairs;
+    }
+
+    ts->carry = rows & 1;
+    if (ts->carry) {
+        l_uint32 *datap = pixGetData(ts->pixPairs);
+        memcpy(datap, datap + (rows - 1) * wpl, sizeof(l_uint32) * wpl);
+    }
+    return 0;
+}
+
+
+/// TiledPartsStrip()
+/// Pass 3: copy the rows of the strip that the edge parts cover.
+///____________________________________________________________________________
+static l_int32 TiledPartsStrip(PIX *pixStrip, l_int32 y0, l_int32 n, l_int32 w, l_int32 h, void *data)
+{
+    GrayPartsCopyRows((GRAYPARTS *)data, pixStrip, y0, n);
+    return 0;
+}
+
+
+/// TiledThresholdAndSkew()
+/// Passes 1 and 2 of --tiled: the Otsu threshold of the full-size w x h
+/// image, as OtsuAdaptiveThreshold() with a single tile gives, and the text
+/// skew in box, as FindSkewInView() on the bitonalized image gives. Skips
+/// the skew if should_deskew is 0. Returns 0 if OK, 1 on error.
+///____________________________________________________________________________
+static l_int32 TiledThresholdAndSkew(const char *filein,
+                                     l_int32     grayChannel,
+                                     l_int32     stripRows,
+                                     size_t      capBytes,
+                                     l_int32     w,
+                                     l_int32     h,
+                                     BOX        *box,
+                                     l_int32     should_deskew,
+                                     l_uint32   *thresh,
+                                     l_float32  *textAngle,
+                                     l_float32  *conf)
+{
+    static char procName[] = "TiledThresholdAndSkew";
+
+    *textAngle = *conf = 0.0;
+
+    struct TiledHist th;
+    memset(&th, 0, sizeof(th));
+    if (ReadJpegStrips(filein, grayChannel, stripRows, TiledHistStrip, &th)) {
+        return ERROR_INT("pass 1 failed", procName, 1);
+    }
+
+    NUMA *hist = numaCreate(256);
+    l_int32 i;
+    for (i=0; i<256; i++) {
+        numaAddNumber(hist, th.counts[i]);
+    }
+    l_int32   otsuThresh;
+    l_float32 avefg, avebg;
+    l_int32 ret = numaSplitDistribution(hist, 0.1, &otsuThresh, &avefg, &avebg, NULL, NULL, NULL);
+    numaDestroy(&hist);
+    if (ret) {
+        return ERROR_INT("no threshold", procName, 1);
+    }
+    *thresh = otsuThresh;
+    debugstr("tiled: threshold %d\n", otsuThresh);
+
+    if (!should_deskew) return 0;
+
+    struct TiledSkew ts;
+    ts.thresh  = otsuThresh;
+    ts.bx      = max(box->x, 0);
+    ts.by      = max(box->y, 0);
+    ts.bw      = min(box->x + box->w, w) - ts.bx;
+    ts.bh      = min(box->y + box->h, h) - ts.by;
+    ts.carry   = 0;
+    ts.nextRow = 0;
+    if ((ts.bw < 2) || (ts.bh < 2)) {
+        debugstr("tiled: skew box is empty\n");
+        return 0;
+    }
+
+    ts.pixPairs = pixCreateNoInit(ts.bw, stripRows + 1, 1);
+    ts.pixsch   = pixCreate(ts.bw / 2, ts.bh / 2, 1);
+    if ((NULL == ts.pixPairs) || (NULL == ts.pixsch)) {
+        pixDestroy(&ts.pixPairs);
+        pixDestroy(&ts.pixsch);
+        return ERROR_INT("skew images not made", procName, 1);
+    }
+
+    size_t bytes = (size_t)stripRows * (w + ts.bw / 8) +
+                   (size_t)4 * pixGetWpl(ts.pixsch) * pixGetHeight(ts.pixsch);
+    debugstr("tiled: pass 2 holds %lu bytes\n", (unsigned long)bytes);
+
+    if (bytes > capBytes) {
+        ret = ERROR_INT("memory cap too small for the skew box", procName, 1);
+    } else if (ReadJpegStrips(filein, grayChannel, stripRows, TiledSkewStrip, &ts)) {
+        ret = ERROR_INT("pass 2 failed", procName, 1);
+    } else {
+        assert(ts.nextRow == pixGetHeight(ts.pixsch));
+        if (FindSkewInReduced2(ts.pixsch, textAngle, conf)) {
+            debugstr("tiled: no skew found\n");
+        }
+    }
+
+    pixDestroy(&ts.pixPairs);
+    pixDestroy(&ts.pixsch);
+    return ret;
+}
+
+
+/// TiledBorderBands()
+/// Pass 3 of --tiled: keep the gray parts of the full-size image around the
+/// edges found on the proxy and refine the edges on them with
+/// remove_bg_border_bands(). The parts start at five band margins on each
+/// side of the proxy edges, which lets each band grow once, and double until
+/// the bands fit or the memory cap is reached. Returns 0 if OK, 1 on error.
+///____________________________________________________________________________
+static l_int32 TiledBorderBands(const char *filein,
+                                l_int32     grayChannel,
+                                l_int32     stripRows,
+                                size_t      capBytes,
+                                l_int32     w,
+                                l_int32     h,
+                                l_float32   angle,
+                                l_uint32    thresh,
+                                l_int32     proxyT,
+                                l_int32     proxyB,
+                                l_int32     proxyL,
+                                l_int32     proxyR,
+                                l_int32    *cropT,
+                                l_int32    *cropB,
+                                l_int32    *cropL,
+                                l_int32    *cropR)
+{
+    static char procName[] = "TiledBorderBands";
+
+    l_int32 reach = 5 * remove_bg_border_band_margin(w, h, angle);
+    while (1) {
+        GRAYPARTS parts;
+        GrayPartsInit(&parts, w, h);
+        if (GrayPartsAdd(&parts, NULL, 0, proxyT - reach, w, 2*reach + 1) ||
+            GrayPartsAdd(&parts, NULL, 0, proxyB - reach, w, 2*reach + 1) ||
+            GrayPartsAdd(&parts, NULL, proxyL - reach, 0, 2*reach + 1, h) ||
+            GrayPartsAdd(&parts, NULL, proxyR - reach, 0, 2*reach + 1, h)) {
+            GrayPartsDestroy(&parts);
+            return ERROR_INT("parts not made", procName, 1);
+        }
+
+        size_t bytes = (size_t)stripRows * w + GrayPartsBytes(&parts);
+        debugstr("tiled: pass 3 reaches %d pels from the edges, holds %lu bytes\n", reach, (unsigned long)bytes);
+        if (bytes > capBytes) {
+            GrayPartsDestroy(&parts);
+            return ERROR_INT("memory cap too small for the border bands", procName, 1);
+        }
+
+        if (ReadJpegStrips(filein, grayChannel, stripRows, TiledPartsStrip, &parts)) {
+            GrayPartsDestroy(&parts);
+            return ERROR_INT("pass 3 failed", procName, 1);
+        }
+
+        l_int32 ret = remove_bg_border_bands(&parts, angle, thresh,
+                                             proxyT, proxyB, proxyL, proxyR,
+                                             black_pixel_percentage_foldout,
+                                             cropT, cropB, cropL, cropR);
+        GrayPartsDestroy(&parts);
+        if (0 == ret) return 0;
+
+        reach *= 2;
+    }
+}
+
+
 /// main()
 ///____________________________________________________________________________
 int main(int argc, char **argv) {
@@ -41,16 +294,45 @@ int main(int argc, char **argv) {
     static char  mainName[] = "autoCropFoldout";
     FILE        *fp;
     long int    should_deskew;
+    l_int32     rotate_binary = 0;
+    l_int32     border_bands = 0;
+    l_int32     tiled = 0;
+    long int    capMB = kTiledDefaultCapMB;
+
+    /// --rotate-binary: after deskew, rotate the full-res binary image by
+    /// shear instead of rotating the gray image and binarizing it again
+    /// --border-bands: after deskew, only rotate and binarize bands around the
+    /// edges found on the reduced image
+    /// --tiled[=capMB]: never hold the full-size image, see TiledBorderBands()
+    l_int32 i, nargs = 0;
+    char *args[2];
+    for (i=1; i<argc; i++) {
+        if (0 == strcmp(argv[i], "--rotate-binary")) {
+            rotate_binary = 1;
+        } else if (0 == strcmp(argv[i], "--border-bands")) {
+            border_bands = 1;
+        } else if ((0 == strcmp(argv[i], "--tiled")) || (0 == strncmp(argv[i], "--tiled=", 8))) {
+            tiled = 1;
+            if ('=' == argv[i][7]) {
+                capMB = strtol(argv[i] + 8, NULL, 10);
+            }
+        } else if (nargs < 2) {
+            args[nargs++] = argv[i];
+        } else {
+            nargs = 0;
+            break;
+        }
+    }
 
-    if ((argc < 2) || (argc > 3)) {
-        exit(ERROR_INT(" Syntax:  autoCropFoldout filein.jpg [should_deskew=1]",
+    if (nargs < 1) {
+        exit(ERROR_INT(" Syntax:  autoCropFoldout filein.jpg [should_deskew=1] [--rotate-binary] [--border-bands] [--tiled[=capMB]] (jpeg only)",
                          mainName, 1));
     }
 
-    filein  = argv[1];
+    filein  = args[0];
 
-    if (argc == 3) {
-        should_deskew = strtol(argv[2], NULL, 10);
+    if (nargs == 2) {
+        should_deskew = strtol(args[1], NULL, 10);
     } else {
         should_deskew = 1;
     }
@@ -62,9 +344,17 @@ int main(int argc, char **argv) {
     }
     debugstr("Opened file handle\n");
 
+    /// libjpeg decodes both the 1/8 size proxy and the full size image (or
+    /// its strips, with --tiled), so only jpegs can be read
+    l_int32 format;
+    if (findFileFormatStream(fp, &format) || (IFF_JFIF_JPEG != format)) {
+        exit(ERROR_INT("filein is not a jpeg", mainName, 1));
+    }
+
     if ((pixs = pixReadStreamJpeg(fp, 0, 8, NULL, 0)) == NULL) {
        exit(ERROR_INT("pixs not made", mainName, 1));
     }
+    fclose(fp);
     debugstr("Read jpeg\n");
 
     //we don't rotate foldouts
@@ -96,14 +386,14 @@ int main(int argc, char **argv) {
     l_int32    w_8, h_8, d;
     pixGetDimensions(pixg, &w_8, &h_8, &d);
 
-    pixOtsuAdaptiveThreshold(pixg,
-                             w_8,
-                             h_8,
-                             1,
-                             1,
-                             0.1,
-                             NULL,
-                             &pixb);
+    OtsuAdaptiveThreshold(pixg,
+                          w_8,
+                          h_8,
+                          1,
+                          1,
+                          0.1,
+                          NULL,
+                          &pixb);
 
     #ifdef WRITE_DEBUG_IMAGES
     {
@@ -136,59 +426,81 @@ int main(int argc, char **argv) {
 
     double skewScore, skewConf;
 
-    PIX *pixBig;
-
-    startTimer();
-    if ((pixBig = pixRead(filein)) == NULL) {
-       exit(ERROR_INT("pixBig not made", mainName, 1));
-    }
-    printf("opened large jpg in %7.3f sec\n", stopTimer());
-
-    PIX *pixBigG;
-    if (kGrayModeThreeChannel != grayChannel) {
-        pixBigG = pixConvertRGBToGray (pixBig, (0==grayChannel), (1==grayChannel), (2==grayChannel));
-    } else {
-        pixBigG = pixConvertRGBToGray (pixBig, 0.30, 0.60, 0.10);
-    }
-
-
+    PIX *pixBigG = NULL;
+    PIX *pixBigBFull = NULL; // = pixThresholdToBinary (pixBigC, threshInitial);
+    l_uint32 threshBig;
+    l_int32 w, h;
+    l_float32 angle, conf, textAngle;
 
-    PIX *pixBigBFull; // = pixThresholdToBinary (pixBigC, threshInitial);
-    l_int32 w = pixGetWidth(pixBigG);
-    l_int32 h = pixGetHeight(pixBigG);
+    size_t  capBytes  = (size_t)capMB << 20;
+    l_int32 stripRows = 0;
 
-    pixOtsuAdaptiveThreshold(pixBigG,
-                             w,
-                             h,
-                             50,
-                             50,
-                             0.1,
-                             NULL,
-                             &pixBigBFull);
-
-    PIX *pixBigB = pixClipRectangle(pixBigBFull, box, NULL);
-    debugstr("croppedWidth = %d, croppedHeight=%d\n", pixGetWidth(pixBigB), pixGetHeight(pixBigB));
-
-    #ifdef WRITE_DEBUG_IMAGES
-    {
-        pixWrite(DEBUG_IMAGE_DIR "outbinfull.png", pixBigBFull, IFF_PNG);
-        pixWrite(DEBUG_IMAGE_DIR "outbinbig.png", pixBigB, IFF_PNG);
-    }
-    #endif
-
-
-    l_float32    angle, conf, textAngle;
-
-    if (should_deskew) {
-        debugstr("calling pixFindSkew\n");
-        if (pixFindSkew(pixBigB, &textAngle, &conf)) {
-          /* an error occured! */
-            debugstr("textAngle=%.2f\ntextConf=%.2f\n", 0.0, -1.0);
-         } else {
-            debugstr("textAngle=%.2f\ntextConf=%.2f\n", textAngle, conf);
+    if (tiled) {
+        /// only the size is read here; the passes decode a strip at a time
+        if (readHeaderJpeg(filein, &w, &h, NULL, NULL, NULL)) {
+            exit(ERROR_INT("can't read jpeg header", mainName, 1));
         }
+        stripRows = (l_int32)(capBytes / 16 / w);
+        stripRows = max(kTiledMinStripRows, min(kTiledMaxStripRows, stripRows));
+        debugstr("tiled: %d x %d, cap %ld MB, %d rows per strip\n", w, h, capMB, stripRows);
+
+        startTimer();
+        if (TiledThresholdAndSkew(filein, grayChannel, stripRows, capBytes, w, h, box,
+                                  should_deskew, &threshBig, &textAngle, &conf)) {
+            exit(ERROR_INT("tiled threshold and skew failed", mainName, 1));
+        }
+        printf("tiled threshold and skew in %7.3f sec\n", stopTimer());
+        debugstr("textAngle=%.2f\ntextConf=%.2f\n", textAngle, conf);
     } else {
-        angle = textAngle = conf = 0.0;
+        /// decode the full size image straight to gray
+        startTimer();
+        if ((pixBigG = ReadJpegRotated(filein, 1, 0, grayChannel)) == NULL) {
+           exit(ERROR_INT("pixBigG not made", mainName, 1));
+        }
+        printf("opened large jpg in %7.3f sec\n", stopTimer());
+
+        PIX *pixBigTh;
+        w = pixGetWidth(pixBigG);
+        h = pixGetHeight(pixBigG);
+
+        OtsuAdaptiveThreshold(pixBigG,
+                              w,
+                              h,
+                              50,
+                              50,
+                              0.1,
+                              &pixBigTh,
+                              &pixBigBFull);
+
+        /// a single tile, so this is the threshold for the whole image
+        pixGetPixel(pixBigTh, 0, 0, &threshBig);
+        pixDestroy(&pixBigTh);
+
+        PIXVIEW viewBigB;
+        ViewInit(&viewBigB, pixBigBFull, box);
+        debugstr("croppedWidth = %d, croppedHeight=%d\n", viewBigB.w, viewBigB.h);
+
+        #ifdef WRITE_DEBUG_IMAGES
+        {
+            pixWrite(DEBUG_IMAGE_DIR "outbinfull.png", pixBigBFull, IFF_PNG);
+            PIX *pixBigB = ViewCopy(&viewBigB);
+            pixWrite(DEBUG_IMAGE_DIR "outbinbig.png", pixBigB, IFF_PNG);
+            pixDestroy(&pixBigB);
+        }
+        #endif
+
+
+        if (should_deskew) {
+            debugstr("calling FindSkewInView\n");
+            if (FindSkewInView(&viewBigB, &textAngle, &conf)) {
+              /* an error occured! */
+                debugstr("textAngle=%.2f\ntextConf=%.2f\n", 0.0, -1.0);
+             } else {
+                debugstr("textAngle=%.2f\ntextConf=%.2f\n", textAngle, conf);
+            }
+        } else {
+            angle = textAngle = conf = 0.0;
+        }
     }
 
     //Deskew(pixbBig, cropL*8, cropR*8, cropT*8, cropB*8, &skewScore, &skewConf);
@@ -207,10 +519,6 @@ int main(int argc, char **argv) {
 
     debugstr("rotating by %f\n", angle);
 
-    PIX *pixBigT = pixRotate(pixBigG,
-                    deg2rad*angle,
-                    L_ROTATE_AREA_MAP,
-                    L_BRING_IN_BLACK,0,0);
 
     cropT = topEdge*8;
     cropB = bottomEdge*8;
@@ -226,42 +534,84 @@ int main(int argc, char **argv) {
 
     debugstr("finding clean lines...\n");
 
-    w = pixGetWidth(pixBigT);
-    h = pixGetHeight(pixBigT);
+    PIX *pixBigTbin = NULL;
+    if (tiled) {
+        /// below kMinRotateAngle the bands are copied, not rotated, so this
+        /// matches reusing the full-res binary
+        startTimer();
+        if (TiledBorderBands(filein, grayChannel, stripRows, capBytes, w, h,
+                             deg2rad*angle, threshBig,
+                             cropT, cropB, cropL, cropR,
+                             &cropT, &cropB, &cropL, &cropR)) {
+            exit(ERROR_INT("tiled border bands failed", mainName, 1));
+        }
+        printf("tiled border bands in %7.3f sec\n", stopTimer());
+    } else if (fabs(deg2rad*angle) < kMinRotateAngle) {
+        /// pixRotate() would return the gray image unchanged, and binarizing it
+        /// with the same tiling gives pixBigBFull again
+        debugstr("no rotation, reusing full-res binary\n");
+        pixBigTbin = pixClone(pixBigBFull);
+    } else if (border_bands) {
+        /// the edges are all we need, so skip the full-size rotation and
+        /// threshold the bands with the threshold of the unrotated image
+        GRAYPARTS whole;
+        GrayPartsInit(&whole, w, h);
+        GrayPartsAdd(&whole, pixBigG, 0, 0, w, h);
+        remove_bg_border_bands(&whole,
+                               deg2rad*angle,
+                               threshBig,
+                               cropT, cropB, cropL, cropR,
+                               black_pixel_percentage_foldout,
+                               &cropT, &cropB, &cropL, &cropR);
+        GrayPartsDestroy(&whole);
+    } else if (rotate_binary) {
+        /// shear the 1bpp image, 1/8 of the data of the gray image
+        pixBigTbin = pixRotate(pixBigBFull,
+                        deg2rad*angle,
+                        L_ROTATE_SHEAR,
+                        L_BRING_IN_BLACK,0,0);
+    } else {
+        PIX *pixBigT = pixRotate(pixBigG,
+                        deg2rad*angle,
+                        L_ROTATE_AREA_MAP,
+                        L_BRING_IN_BLACK,0,0);
+
+        OtsuAdaptiveThreshold(pixBigT,
+                              pixGetWidth(pixBigT),
+                              pixGetHeight(pixBigT),
+                              50,
+                              50,
+                              0.1,
+                              NULL,
+                              &pixBigTbin);
+        pixDestroy(&pixBigT);
+    }
 
+    //pixRotate() keeps the size, so w and h are the same as for pixBigG
     l_int32 limitLeft = calcLimitLeft(w,h,angle);
     l_int32 limitTop  = calcLimitTop(w,h,angle);
 
-    PIX *pixBigTbin;
-    pixOtsuAdaptiveThreshold(pixBigT,
-                             w,
-                             h,
-                             50,
-                             50,
-                             0.1,
-                             NULL,
-                             &pixBigTbin);
-
-    #ifdef WRITE_DEBUG_IMAGES
-    {
-        pixWrite(DEBUG_IMAGE_DIR "outbinT.png", pixBigTbin, IFF_PNG);
-    }
-    #endif
-
+    assert(bottomEdge>topEdge);
 
-    //redo the rough crop on the full-resolution rotated image
-    cropT = remove_bg_top(pixBigTbin, 0, black_pixel_percentage_foldout);
-    debugstr("new cropT is %d\n", cropT);
+    if (NULL != pixBigTbin) {
+        #ifdef WRITE_DEBUG_IMAGES
+        {
+            pixWrite(DEBUG_IMAGE_DIR "outbinT.png", pixBigTbin, IFF_PNG);
+        }
+        #endif
 
-    cropB = remove_bg_bottom(pixBigTbin, 0, black_pixel_percentage_foldout);
-    debugstr("bottomEdge is %d\n", cropB);
+        //redo the rough crop on the full-resolution rotated image
+        cropT = remove_bg_top(pixBigTbin, 0, black_pixel_percentage_foldout);
+        debugstr("new cropT is %d\n", cropT);
 
-    assert(bottomEdge>topEdge);
+        cropB = remove_bg_bottom(pixBigTbin, 0, black_pixel_percentage_foldout);
+        debugstr("bottomEdge is %d\n", cropB);
 
-    cropR = remove_bg_outer(pixBigTbin, 1,  cropT, cropB, black_pixel_percentage_foldout);
-    cropL = remove_bg_outer(pixBigTbin, -1, cropT, cropB, black_pixel_percentage_foldout);
-    debugstr("rightEdge is %d\n", rightEdge);
-    debugstr("leftEdge is %d\n", leftEdge);
+        cropR = remove_bg_outer(pixBigTbin, 1,  cropT, cropB, black_pixel_percentage_foldout);
+        cropL = remove_bg_outer(pixBigTbin, -1, cropT, cropB, black_pixel_percentage_foldout);
+        debugstr("rightEdge is %d\n", rightEdge);
+        debugstr("leftEdge is %d\n", leftEdge);
+    }
 
 
     debugstr("adjusted: cL=%d, cR=%d, cT=%d, cB=%d limitLeft=%d, limitTop=%d\n", cropL, cropR, cropT, cropB, limitLeft, limitTop);
@@ -323,4 +673,12 @@ int main(int argc, char **argv) {
     }
     #endif
 
+    /// cleanup; pixd is pixs
+    pixDestroy(&pixBigTbin);
+    pixDestroy(&pixBigBFull);
+    pixDestroy(&pixBigG);
+    boxDestroy(&box);
+    pixDestroy(&pixb);
+    pixDestroy(&pixg);
+    pixDestroy(&pixd);
 }
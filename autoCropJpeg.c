@@ -0,0 +1,629 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <fcntl.h>  //for posix_fadvise
+#include "allheaders.h"
+#include <assert.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "jpeglib.h"
+#include "jerror.h"
+#ifdef __cplusplus
+}
+#endif
+#include "autoCropCommon.h"
+#include "autoCropJpeg.h"
+
+/*  Jpeg decoding that folds the 90 degree rotation of Scribe images into the
+    decode. Scanlines are decoded into a small strip buffer, converted to gray
+    if asked, and each strip is transposed into the columns of the portrait
+    image with RotateRows90(). The landscape image is never built.
+
+    The pels are the same as pixReadStreamJpeg() followed by pixRotate90(),
+    and pixConvertRGBToGray() when a gray channel is given.
+
+    ReadJpegStrips() uses the same decoder for images that are too large to
+    hold: it hands each gray strip to a callback and keeps nothing.
+
+    ReadJpegRotatedMem() and ReadJpegSizeMem() decode from a jpeg already in
+    memory, as JpegFileRead() leaves it, so a leaf whose proxy, size and full
+    size image are all needed reads its file once. The file is read rather
+    than mapped: a jpeg replaced while it is mapped would fault the decoder,
+    and on NFS the reads of a mapping would land in the decode instead of the
+    read ahead of autoCropScribe --pipeline.
+*/
+
+#define kJpegStripRows 32
+
+struct JpegErrorMgr {
+    struct jpeg_error_mgr pub;
+    jmp_buf               jmpBuf;
+};
+
+/// Where a decode reads the jpeg from: fp, or size bytes at data
+struct JpegSource {
+    FILE           *fp;
+    const l_uint8  *data;
+    size_t          size;
+};
+
+/// Everything the decoder allocates, so it can be freed after a longjmp
+struct JpegRotateState {
+    struct jpeg_decompress_struct cinfo;
+    struct JpegErrorMgr           jerr;
+    l_int32                       haveDecompress;
+    JSAMPROW                      rowBuffer;
+    PIX                          *pixStrip;
+    PIX                          *pixd;
+};
+
+
+/// JpegErrorExit()
+/// libjpeg calls exit() on errors by default. Jump back to ReadJpegRotated()
+/// instead. The jmp_buf lives in the per-call error manager, so concurrent
+/// decodes in different threads do not share it.
+///____________________________________________________________________________
+static void JpegErrorExit(j_common_ptr cinfo)
+{
+    struct JpegErrorMgr *err = (struct JpegErrorMgr *)cinfo->err;
+    (*cinfo->err->output_message)(cinfo);
+    longjmp(err->jmpBuf, 1);
+}
+
+
+#if (JPEG_LIB_VERSION < 80) && !defined(MEM_SRCDST_SUPPORTED)
+/// A memory source for libjpeg 6b, which has no jpeg_mem_src(). Running off
+/// the end of the data gives a warning and a fake EOI marker, as the stdio
+/// source does at the end of a file.
+static void MemInitSource(j_decompress_ptr cinfo)
+{
+}
+
+static boolean MemFillInputBuffer(j_decompress_ptr cinfo)
+{
+    static const JOCTET eoi[2] = {0xFF, JPEG_EOI};
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+    cinfo->src->next_input_byte = eoi;
+    cinfo->src->bytes_in_buffer = 2;
+    return TRUE;
+}
+
+static void MemSkipInputData(j_decompress_ptr cinfo, long numBytes)
+{
+    struct jpeg_source_mgr *src = cinfo->src;
+    if (numBytes <= 0) return;
+    if ((size_t)numBytes > src->bytes_in_buffer) {
+        MemFillInputBuffer(cinfo);
+        return;
+    }
+    src->next_input_byte += numBytes;
+    src->bytes_in_buffer -= numBytes;
+}
+
+static void MemTermSource(j_decompress_ptr cinfo)
+{
+}
+
+static void jpeg_mem_src(j_decompress_ptr cinfo, unsigned char *data, unsigned long size)
+{
+    if (NULL == cinfo->src) {
+        cinfo->src = (struct jpeg_source_mgr *)(*cinfo->mem->alloc_small)((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                                                                          sizeof(struct jpeg_source_mgr));
+    }
+    struct jpeg_source_mgr *src = cinfo->src;
+    src->init_source       = MemInitSource;
+    src->fill_input_buffer = MemFillInputBuffer;
+    src->skip_input_data   = MemSkipInputData;
+    src->resync_to_restart = jpeg_resync_to_restart;
+    src->term_source       = MemTermSource;
+    src->next_input_byte   = (const JOCTET *)data;
+    src->bytes_in_buffer   = size;
+}
+#endif
+
+
+/// SetSource()
+///____________________________________________________________________________
+static void SetSource(j_decompress_ptr cinfo, const struct JpegSource *source)
+{
+    if (NULL != source->fp) {
+        jpeg_stdio_src(cinfo, source->fp);
+    } else {
+        jpeg_mem_src(cinfo, (unsigned char *)source->data, (unsigned long)source->size);
+    }
+}
+
+
+/// ConvertScanline()
+/// Convert one decoded scanline into row i of the strip. Three channel gray
+/// uses the same weights and rounding as pixConvertRGBToGray().
+///____________________________________________________________________________
+static void ConvertScanline(JSAMPROW  row,
+                            l_int32   spp,
+                            l_int32   w,
+                            l_int32   grayChannel,
+                            l_uint32 *lined)
+{
+    l_int32 j;
+
+    if (1 == spp) {
+        for (j=0; j<w; j++) {
+            SET_DATA_BYTE(lined, j, row[j]);
+        }
+    } else if (kJpegKeepColor == grayChannel) {
+        for (j=0; j<w; j++, row+=3) {
+            lined[j] = ((l_uint32)row[0] << L_RED_SHIFT) |
+                       ((l_uint32)row[1] << L_GREEN_SHIFT) |
+                       ((l_uint32)row[2] << L_BLUE_SHIFT);
+        }
+    } else if (kGrayModeThreeChannel == grayChannel) {
+        const l_float32 rwt = 0.30, gwt = 0.60, bwt = 0.10;
+        for (j=0; j<w; j++, row+=3) {
+            l_uint32 r = row[0], g = row[1], b = row[2];
+            l_int32 val = (l_int32)(rwt * r + gwt * g + bwt * b + 0.5);
+            SET_DATA_BYTE(lined, j, val);
+        }
+    } else {
+        for (j=0; j<w; j++, row+=3) {
+            SET_DATA_BYTE(lined, j, row[grayChannel]);
+        }
+    }
+}
+
+
+/// DecodeJpegRotated()
+/// Does the work for ReadJpegRotated(). Returns 0 on success, or 1 if the
+/// image is not 1 or 3 channel, in which case nothing has been decoded.
+///____________________________________________________________________________
+static l_int32 DecodeJpegRotated(struct JpegRotateState  *st,
+                                 const struct JpegSource *source,
+                                 l_int32                  reduction,
+                                 l_int32                  rotDir,
+                                 l_int32                  grayChannel)
+{
+    struct jpeg_decompress_struct *cinfo = &st->cinfo;
+
+    jpeg_create_decompress(cinfo);
+    st->haveDecompress = 1;
+    SetSource(cinfo, source);
+    jpeg_read_header(cinfo, TRUE);
+    cinfo->scale_num   = 1;
+    cinfo->scale_denom = reduction;
+    cinfo->quantize_colors = FALSE;
+    jpeg_calc_output_dimensions(cinfo);
+
+    l_int32 spp = cinfo->out_color_components;
+    l_int32 w   = cinfo->output_width;
+    l_int32 h   = cinfo->output_height;
+    if ((1 != spp) && (3 != spp)) {
+        return 1;
+    }
+
+    l_int32 d = ((3 == spp) && (kJpegKeepColor == grayChannel)) ? 32 : 8;
+
+    st->rowBuffer = (JSAMPROW)malloc(spp * w);
+    if (0 == rotDir) {
+        st->pixd = pixCreateNoInit(w, h, d);
+    } else {
+        st->pixd     = pixCreateNoInit(h, w, d);
+        st->pixStrip = pixCreateNoInit(w, kJpegStripRows, d);
+    }
+    if ((NULL == st->rowBuffer) || (NULL == st->pixd) ||
+        ((0 != rotDir) && (NULL == st->pixStrip))) {
+        ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
+    }
+
+    if (1 == cinfo->density_unit) {
+        pixSetXRes(st->pixd, cinfo->X_density);
+        pixSetYRes(st->pixd, cinfo->Y_density);
+    } else if (2 == cinfo->density_unit) {
+        pixSetXRes(st->pixd, (l_int32)((l_float32)cinfo->X_density * 2.54 + 0.5));
+        pixSetYRes(st->pixd, (l_int32)((l_float32)cinfo->Y_density * 2.54 + 0.5));
+    }
+
+    jpeg_start_decompress(cinfo);
+
+    /// Strips start a multiple of 4 rows away from the bottom for clockwise
+    /// rotation, so the first strip may be short. See RotateRows90().
+    l_int32 y0 = 0;
+    while (y0 < h) {
+        l_int32 n = kJpegStripRows;
+        if ((1 == rotDir) && (0 == y0) && (h & 3)) {
+            n = h & 3;
+        }
+        if (y0 + n > h) {
+            n = h - y0;
+        }
+
+        l_int32 i;
+        for (i=0; i<n; i++) {
+            if (1 != jpeg_read_scanlines(cinfo, &st->rowBuffer, 1)) {
+                ERREXIT(cinfo, JERR_INPUT_EOF);
+            }
+            l_uint32 *lined;
+            if (0 == rotDir) {
+                lined = pixGetData(st->pixd) + (y0+i) * pixGetWpl(st->pixd);
+            } else {
+                lined = pixGetData(st->pixStrip) + i * pixGetWpl(st->pixStrip);
+            }
+            ConvertScanline(st->rowBuffer, spp, w, grayChannel, lined);
+        }
+
+        if (0 != rotDir) {
+            RotateRows90(st->pixd, pixGetData(st->pixStrip), pixGetWpl(st->pixStrip),
+                         w, h, y0, y0+n, rotDir);
+        }
+        y0 += n;
+    }
+
+    jpeg_finish_decompress(cinfo);
+    return 0;
+}
+
+
+/// ReadRotated()
+/// Does the work for ReadJpegRotated() and ReadJpegRotatedMem().
+///____________________________________________________________________________
+static PIX *ReadRotated(const struct JpegSource *source,
+                        l_int32                  reduction,
+                        l_int32                  rotDir,
+                        l_int32                  grayChannel)
+{
+    static char procName[] = "ReadJpegRotated";
+
+    if ((1 != reduction) && (2 != reduction) && (4 != reduction) && (8 != reduction)) {
+        return (PIX *)ERROR_PTR("reduction not in {1,2,4,8}", procName, NULL);
+    }
+    if ((rotDir < -1) || (rotDir > 1)) {
+        return (PIX *)ERROR_PTR("invalid rotDir", procName, NULL);
+    }
+
+    struct JpegRotateState st;
+    st.haveDecompress = 0;
+    st.rowBuffer = NULL;
+    st.pixStrip  = NULL;
+    st.pixd      = NULL;
+    st.cinfo.err = jpeg_std_error(&st.jerr.pub);
+    st.jerr.pub.error_exit = JpegErrorExit;
+
+    PIX *pixd = NULL;
+    l_int32 fallback = 0;
+    if (0 == setjmp(st.jerr.jmpBuf)) {
+        fallback = DecodeJpegRotated(&st, source, reduction, rotDir, grayChannel);
+        if (!fallback) {
+            pixd = st.pixd;
+            st.pixd = NULL;
+        }
+    } else {
+        L_ERROR("internal jpeg error", procName);
+    }
+
+    if (st.haveDecompress) {
+        jpeg_destroy_decompress(&st.cinfo);
+    }
+    free(st.rowBuffer);
+    pixDestroy(&st.pixStrip);
+    pixDestroy(&st.pixd);
+
+    if (fallback) {
+        PIX *pixs = (NULL != source->fp) ? pixReadStreamJpeg(source->fp, 0, reduction, NULL, 0)
+                                         : pixReadMemJpeg(source->data, source->size, 0, reduction, NULL, 0);
+        PIX *pixg = pixs;
+        if ((NULL != pixs) && (32 == pixGetDepth(pixs)) && (kJpegKeepColor != grayChannel)) {
+            if (kGrayModeThreeChannel == grayChannel) {
+                pixg = pixConvertRGBToGray(pixs, 0.30, 0.60, 0.10);
+            } else {
+                pixg = pixConvertRGBToGray(pixs, (0==grayChannel), (1==grayChannel), (2==grayChannel));
+            }
+            pixDestroy(&pixs);
+        }
+        if ((NULL != pixg) && (0 != rotDir)) {
+            pixd = Rotate90Tiled(pixg, rotDir);
+            pixDestroy(&pixg);
+        } else {
+            pixd = pixg;
+        }
+    }
+
+    return pixd;
+}
+
+
+/// ReadJpegRotated()
+/// Decode a jpeg, reduced by 1, 2, 4 or 8 in libjpeg, directly into the
+/// orientation given by rotDir (1 = clockwise, -1 = counter-clockwise, 0 =
+/// none). grayChannel selects the output:
+///     kJpegKeepColor          32bpp RGB, as pixReadStreamJpeg()
+///     0, 1, 2                 8bpp, single channel (R, G or B)
+///     kGrayModeThreeChannel   8bpp, 0.30 R + 0.60 G + 0.10 B
+/// Grayscale jpegs always give 8bpp. CMYK and YCCK jpegs are read with
+/// pixReadStreamJpeg() and rotated afterwards. Returns NULL on error.
+///____________________________________________________________________________
+PIX *ReadJpegRotated(const char *filename,
+                     l_int32     reduction,
+                     l_int32     rotDir,
+                     l_int32     grayChannel)
+{
+    static char procName[] = "ReadJpegRotated";
+
+    struct JpegSource source;
+    source.fp   = fopenReadStream(filename);
+    source.data = NULL;
+    source.size = 0;
+    if (NULL == source.fp) {
+        return (PIX *)ERROR_PTR("image file not found", procName, NULL);
+    }
+
+    PIX *pixd = ReadRotated(&source, reduction, rotDir, grayChannel);
+    fclose(source.fp);
+    return pixd;
+}
+
+
+/// ReadJpegRotatedMem()
+/// ReadJpegRotated() from the size bytes of a jpeg at data, which must be
+/// followed by a null byte, as JpegFileRead() leaves them.
+///____________________________________________________________________________
+PIX *ReadJpegRotatedMem(const l_uint8 *data,
+                        size_t         size,
+                        l_int32        reduction,
+                        l_int32        rotDir,
+                        l_int32        grayChannel)
+{
+    static char procName[] = "ReadJpegRotatedMem";
+
+    if ((NULL == data) || (0 == size)) {
+        return (PIX *)ERROR_PTR("no jpeg data", procName, NULL);
+    }
+
+    struct JpegSource source;
+    source.fp   = NULL;
+    source.data = data;
+    source.size = size;
+    return ReadRotated(&source, reduction, rotDir, grayChannel);
+}
+
+
+/// ReadSize()
+/// Does the work for ReadJpegSize() and ReadJpegSizeMem().
+///____________________________________________________________________________
+static l_int32 ReadSize(const struct JpegSource *source,
+                        l_int32                  rotDir,
+                        l_int32                 *pw,
+                        l_int32                 *ph)
+{
+    static char procName[] = "ReadJpegSize";
+
+    struct jpeg_decompress_struct cinfo;
+    struct JpegErrorMgr           jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = JpegErrorExit;
+
+    l_int32 ret = 1;
+    jpeg_create_decompress(&cinfo);
+    if (0 == setjmp(jerr.jmpBuf)) {
+        SetSource(&cinfo, source);
+        jpeg_read_header(&cinfo, TRUE);
+        *pw = (0 == rotDir) ? cinfo.image_width : cinfo.image_height;
+        *ph = (0 == rotDir) ? cinfo.image_height : cinfo.image_width;
+        ret = 0;
+    } else {
+        L_ERROR("internal jpeg error", procName);
+    }
+    jpeg_destroy_decompress(&cinfo);
+    return ret;
+}
+
+
+/// ReadJpegSize()
+/// The size of a jpeg at full size, turned by rotDir as ReadJpegRotated()
+/// would, from its header alone. Returns 0 if OK, 1 on error.
+///____________________________________________________________________________
+l_int32 ReadJpegSize(const char *filename,
+                     l_int32     rotDir,
+                     l_int32    *pw,
+                     l_int32    *ph)
+{
+    static char procName[] = "ReadJpegSize";
+
+    struct JpegSource source;
+    source.fp   = fopenReadStream(filename);
+    source.data = NULL;
+    source.size = 0;
+    if (NULL == source.fp) {
+        return ERROR_INT("image file not found", procName, 1);
+    }
+
+    l_int32 ret = ReadSize(&source, rotDir, pw, ph);
+    fclose(source.fp);
+    return ret;
+}
+
+
+/// ReadJpegSizeMem()
+/// ReadJpegSize() from the size bytes of a jpeg at data.
+///____________________________________________________________________________
+l_int32 ReadJpegSizeMem(const l_uint8 *data,
+                        size_t         size,
+                        l_int32        rotDir,
+                        l_int32       *pw,
+                        l_int32       *ph)
+{
+    static char procName[] = "ReadJpegSizeMem";
+
+    if ((NULL == data) || (0 == size)) {
+        return ERROR_INT("no jpeg data", procName, 1);
+    }
+
+    struct JpegSource source;
+    source.fp   = NULL;
+    source.data = data;
+    source.size = size;
+    return ReadSize(&source, rotDir, pw, ph);
+}
+
+
+/// JpegFileRead()
+/// Read all of a jpeg file into jf->data, with a null byte after its
+/// jf->size bytes, for ReadJpegRotatedMem() and ReadJpegSizeMem(). Returns 0
+/// if OK, or 1 with jf->data NULL if the file cannot be read. Free with
+/// JpegFileFree().
+///____________________________________________________________________________
+l_int32 JpegFileRead(JPEGFILE   *jf,
+                     const char *filename)
+{
+    static char procName[] = "JpegFileRead";
+
+    jf->data = NULL;
+    jf->size = 0;
+
+    FILE *fp = fopenReadStream(filename);
+    if (NULL == fp) {
+        return ERROR_INT("image file not found", procName, 1);
+    }
+    posix_fadvise(fileno(fp), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    size_t size = fnbytesInFile(fp);
+    l_uint8 *data = (l_uint8 *)malloc(size + 1);
+    if (NULL == data) {
+        fclose(fp);
+        return ERROR_INT("data not made", procName, 1);
+    }
+    if ((0 == size) || (size != fread(data, 1, size, fp))) {
+        free(data);
+        fclose(fp);
+        return ERROR_INT("jpeg file not read", procName, 1);
+    }
+    fclose(fp);
+
+    data[size] = 0;
+    jf->data = data;
+    jf->size = size;
+    return 0;
+}
+
+
+/// JpegFileFree()
+///____________________________________________________________________________
+void JpegFileFree(JPEGFILE *jf)
+{
+    free(jf->data);
+    jf->data = NULL;
+    jf->size = 0;
+}
+
+
+/// DecodeJpegStrips()
+/// Does the work for ReadJpegStrips(). Returns 0 on success, or 1 if the image
+/// is not 1 or 3 channel or stripFn asked to stop.
+///____________________________________________________________________________
+static l_int32 DecodeJpegStrips(struct JpegRotateState  *st,
+                                const struct JpegSource *source,
+                                l_int32                  grayChannel,
+                                l_int32                  stripRows,
+                                JpegStripFn              stripFn,
+                                void                    *data)
+{
+    static char procName[] = "ReadJpegStrips";
+    struct jpeg_decompress_struct *cinfo = &st->cinfo;
+
+    jpeg_create_decompress(cinfo);
+    st->haveDecompress = 1;
+    SetSource(cinfo, source);
+    jpeg_read_header(cinfo, TRUE);
+    cinfo->quantize_colors = FALSE;
+    jpeg_calc_output_dimensions(cinfo);
+
+    l_int32 spp = cinfo->out_color_components;
+    l_int32 w   = cinfo->output_width;
+    l_int32 h   = cinfo->output_height;
+    if ((1 != spp) && (3 != spp)) {
+        return ERROR_INT("only 1 and 3 channel jpegs can be read in strips", procName, 1);
+    }
+
+    st->rowBuffer = (JSAMPROW)malloc(spp * w);
+    st->pixStrip  = pixCreateNoInit(w, stripRows, 8);
+    if ((NULL == st->rowBuffer) || (NULL == st->pixStrip)) {
+        ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
+    }
+
+    jpeg_start_decompress(cinfo);
+
+    l_int32 y0;
+    for (y0=0; y0<h; y0+=stripRows) {
+        l_int32 n = min_int32(stripRows, h - y0);
+        l_int32 i;
+        for (i=0; i<n; i++) {
+            if (1 != jpeg_read_scanlines(cinfo, &st->rowBuffer, 1)) {
+                ERREXIT(cinfo, JERR_INPUT_EOF);
+            }
+            l_uint32 *lined = pixGetData(st->pixStrip) + i * pixGetWpl(st->pixStrip);
+            ConvertScanline(st->rowBuffer, spp, w, grayChannel, lined);
+        }
+        if (stripFn(st->pixStrip, y0, n, w, h, data)) {
+            return 1;
+        }
+    }
+
+    jpeg_finish_decompress(cinfo);
+    return 0;
+}
+
+
+/// ReadJpegStrips()
+/// Decode a jpeg at full size to 8bpp gray (grayChannel as in
+/// ReadJpegRotated(), but not kJpegKeepColor) stripRows rows at a time, and
+/// call stripFn(pixStrip, y0, n, w, h, data) for each strip. The first n rows
+/// of pixStrip are rows [y0, y0+n) of the w x h image; n is stripRows except
+/// for the last strip. pixStrip is reused, so stripFn must copy what it
+/// keeps. Returns 0 if OK, 1 on error or if stripFn returned nonzero.
+/// CMYK and YCCK jpegs are not supported.
+///____________________________________________________________________________
+l_int32 ReadJpegStrips(const char  *filename,
+                       l_int32      grayChannel,
+                       l_int32      stripRows,
+                       JpegStripFn  stripFn,
+                       void        *data)
+{
+    static char procName[] = "ReadJpegStrips";
+
+    if (kJpegKeepColor == grayChannel) {
+        return ERROR_INT("strips are always gray", procName, 1);
+    }
+    if (stripRows < 1) {
+        return ERROR_INT("stripRows < 1", procName, 1);
+    }
+
+    struct JpegSource source;
+    source.fp   = fopenReadStream(filename);
+    source.data = NULL;
+    source.size = 0;
+    if (NULL == source.fp) {
+        return ERROR_INT("image file not found", procName, 1);
+    }
+
+    struct JpegRotateState st;
+    st.haveDecompress = 0;
+    st.rowBuffer = NULL;
+    st.pixStrip  = NULL;
+    st.pixd      = NULL;
+    st.cinfo.err = jpeg_std_error(&st.jerr.pub);
+    st.jerr.pub.error_exit = JpegErrorExit;
+
+    l_int32 ret = 1;
+    if (0 == setjmp(st.jerr.jmpBuf)) {
+        ret = DecodeJpegStrips(&st, &source, grayChannel, stripRows, stripFn, data);
+    } else {
+        L_ERROR("internal jpeg error", procName);
+    }
+
+    if (st.haveDecompress) {
+        jpeg_destroy_decompress(&st.cinfo);
+    }
+    free(st.rowBuffer);
+    pixDestroy(&st.pixStrip);
+
+    fclose(source.fp);
+    return ret;
+}
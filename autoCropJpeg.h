@@ -0,0 +1,54 @@
+#ifndef AUTOCROP_AUTOCROPJPEG_H
+#define AUTOCROP_AUTOCROPJPEG_H
+
+//grayChannel value for ReadJpegRotated() to keep the color channels
+#define kJpegKeepColor -1
+
+PIX *ReadJpegRotated(const char *filename,
+                     l_int32     reduction,
+                     l_int32     rotDir,
+                     l_int32     grayChannel);
+
+l_int32 ReadJpegSize(const char *filename,
+                     l_int32     rotDir,
+                     l_int32    *pw,
+                     l_int32    *ph);
+
+//a jpeg file read into memory once, to decode from it as often as needed
+typedef struct JpegFile {
+    l_uint8  *data;   //size bytes, then a null byte
+    size_t    size;
+} JPEGFILE;
+
+l_int32 JpegFileRead(JPEGFILE   *jf,
+                     const char *filename);
+
+void JpegFileFree(JPEGFILE *jf);
+
+PIX *ReadJpegRotatedMem(const l_uint8 *data,
+                        size_t         size,
+                        l_int32        reduction,
+                        l_int32        rotDir,
+                        l_int32        grayChannel);
+
+l_int32 ReadJpegSizeMem(const l_uint8 *data,
+                        size_t         size,
+                        l_int32        rotDir,
+                        l_int32       *pw,
+                        l_int32       *ph);
+
+//called by ReadJpegStrips() for each strip; return nonzero to stop
+typedef l_int32 (*JpegStripFn)(PIX     *pixStrip,
+                               l_int32  y0,
+                               l_int32  n,
+                               l_int32  w,
+                               l_int32  h,
+                               void    *data);
+
+l_int32 ReadJpegStrips(const char  *filename,
+                       l_int32      grayChannel,
+                       l_int32      stripRows,
+                       JpegStripFn  stripFn,
+                       void        *data);
+
+#endif
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "allheaders.h"
+#include <assert.h>
+#include "autoCropPipeline.h"
+
+/*  Stages on threads of their own, between a list of items and a consumer
+    that takes the items in list order, as the batch mode of autoCropScribe
+    reads and decodes the jpegs of the next leaves while it crops this one.
+
+    Each stage takes the items in list order, an item only once the stage
+    before it is done with it, and may run several threads, which then work
+    on successive items at once. Items come out of PipelineNext() in list
+    order once every stage is done with them. The first stage does not start
+    an item more than depth items ahead of the consumer, which bounds the
+    items (and their decoded images) held at once.
+
+    One mutex and one condition variable cover the whole pipeline: stages
+    work on whole leaves, so waking every waiting thread when an item moves
+    on costs nothing next to the work.
+*/
+
+typedef struct PipeThread {
+    PIPELINE  *pipeline;
+    l_int32    stage;
+} PIPETHREAD;
+
+
+/// PipelineInit()
+/// A pipeline over numItems items, with no stages yet. depth is at least 1.
+///____________________________________________________________________________
+void PipelineInit(PIPELINE *pipeline, void **items, l_int32 numItems, l_int32 depth)
+{
+    memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->items    = items;
+    pipeline->numItems = numItems;
+    pipeline->depth    = L_MAX(depth, 1);
+    pipeline->numDone  = (l_int32 *)CALLOC(L_MAX(numItems, 1), sizeof(l_int32));
+    pthread_mutex_init(&pipeline->lock, NULL);
+    pthread_cond_init(&pipeline->cond, NULL);
+}
+
+
+/// PipelineAddStage()
+/// Run fn(item, arg) on every item, after the stages added before it, on
+/// numThreads threads. Call before PipelineStart().
+///____________________________________________________________________________
+void PipelineAddStage(PIPELINE *pipeline, PIPESTAGEFN fn, void *arg, l_int32 numThreads)
+{
+    assert(pipeline->numStages < kPipeMaxStages);
+    assert(numThreads >= 1);
+    PIPESTAGE *s  = &pipeline->stages[pipeline->numStages++];
+    s->fn         = fn;
+    s->arg        = arg;
+    s->numThreads = numThreads;
+    s->next       = 0;
+}
+
+
+/// StageThread()
+///____________________________________________________________________________
+static void *StageThread(void *arg)
+{
+    PIPETHREAD *t        = (PIPETHREAD *)arg;
+    PIPELINE   *pipeline = t->pipeline;
+    l_int32     stage    = t->stage;
+    PIPESTAGE  *s        = &pipeline->stages[stage];
+
+    pthread_mutex_lock(&pipeline->lock);
+    while (!pipeline->stopping && (s->next < pipeline->numItems)) {
+        l_int32 i = s->next;
+        if ((pipeline->numDone[i] < stage)
+            || ((0 == stage) && (i >= pipeline->taken + pipeline->depth))) {
+            pthread_cond_wait(&pipeline->cond, &pipeline->lock);
+            continue;
+        }
+        s->next++;
+        pthread_mutex_unlock(&pipeline->lock);
+
+        s->fn(pipeline->items[i], s->arg);
+
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->numDone[i] = stage + 1;
+        pthread_cond_broadcast(&pipeline->cond);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+    return NULL;
+}
+
+
+/// PipelineStart()
+/// Start the stage threads. Returns 0, or 1 if a thread could not be started;
+/// PipelineDestroy() must be called either way.
+///____________________________________________________________________________
+l_int32 PipelineStart(PIPELINE *pipeline)
+{
+    static char procName[] = "PipelineStart";
+
+    l_int32 i, k, total = 0;
+    for (i=0; i<pipeline->numStages; i++) total += pipeline->stages[i].numThreads;
+    pipeline->threads    = (pthread_t *)CALLOC(L_MAX(total, 1), sizeof(pthread_t));
+    pipeline->threadArgs = (PIPETHREAD *)CALLOC(L_MAX(total, 1), sizeof(PIPETHREAD));
+
+    for (i=0; i<pipeline->numStages; i++) {
+        for (k=0; k<pipeline->stages[i].numThreads; k++) {
+            PIPETHREAD *t = &pipeline->threadArgs[pipeline->numThreads];
+            t->pipeline   = pipeline;
+            t->stage      = i;
+            if (pthread_create(&pipeline->threads[pipeline->numThreads], NULL, StageThread, t)) {
+                return ERROR_INT("cannot start stage thread", procName, 1);
+            }
+            pipeline->numThreads++;
+        }
+    }
+    return 0;
+}
+
+
+/// PipelineNext()
+/// Wait for the next item in list order to get through every stage, and
+/// return it, or NULL after the last item.
+///____________________________________________________________________________
+void *PipelineNext(PIPELINE *pipeline)
+{
+    pthread_mutex_lock(&pipeline->lock);
+    if (pipeline->taken >= pipeline->numItems) {
+        pthread_mutex_unlock(&pipeline->lock);
+        return NULL;
+    }
+    while (pipeline->numDone[pipeline->taken] < pipeline->numStages) {
+        pthread_cond_wait(&pipeline->cond, &pipeline->lock);
+    }
+    void *item = pipeline->items[pipeline->taken++];
+    pthread_cond_broadcast(&pipeline->cond);
+    pthread_mutex_unlock(&pipeline->lock);
+    return item;
+}
+
+
+/// PipelineDestroy()
+/// Stop the stages, wait for their threads, and free the pipeline. Items a
+/// stage is working on are finished; the items themselves are the caller's.
+///____________________________________________________________________________
+void PipelineDestroy(PIPELINE *pipeline)
+{
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->stopping = 1;
+    pthread_cond_broadcast(&pipeline->cond);
+    pthread_mutex_unlock(&pipeline->lock);
+
+    l_int32 i;
+    for (i=0; i<pipeline->numThreads; i++) pthread_join(pipeline->threads[i], NULL);
+
+    FREE(pipeline->threads);
+    FREE(pipeline->threadArgs);
+    FREE(pipeline->numDone);
+    pthread_cond_destroy(&pipeline->cond);
+    pthread_mutex_destroy(&pipeline->lock);
+}
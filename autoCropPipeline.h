@@ -0,0 +1,40 @@
+#ifndef AUTOCROP_AUTOCROPPIPELINE_H
+#define AUTOCROP_AUTOCROPPIPELINE_H
+
+#define kPipeMaxStages 4
+
+/// Runs one stage on one item, on a stage thread.
+typedef void (*PIPESTAGEFN)(void *item, void *arg);
+
+typedef struct PipeStage {
+    PIPESTAGEFN  fn;
+    void        *arg;
+    l_int32      numThreads;
+    l_int32      next;        //the next item the stage will take
+} PIPESTAGE;
+
+/// Items run through each stage in turn on stage threads, in list order,
+/// ahead of a consumer that takes them with PipelineNext(). Needs pthread.h.
+typedef struct Pipeline {
+    void             **items;
+    l_int32            numItems;
+    l_int32            depth;      //items started and not yet taken, at most
+    l_int32            numStages;
+    PIPESTAGE          stages[kPipeMaxStages];
+    l_int32           *numDone;    //stages each item has been through
+    l_int32            taken;      //items taken by PipelineNext()
+    l_int32            stopping;
+    l_int32            numThreads;
+    pthread_t         *threads;
+    struct PipeThread *threadArgs;
+    pthread_mutex_t    lock;
+    pthread_cond_t     cond;
+} PIPELINE;
+
+void    PipelineInit(PIPELINE *pipeline, void **items, l_int32 numItems, l_int32 depth);
+void    PipelineAddStage(PIPELINE *pipeline, PIPESTAGEFN fn, void *arg, l_int32 numThreads);
+l_int32 PipelineStart(PIPELINE *pipeline);
+void   *PipelineNext(PIPELINE *pipeline);
+void    PipelineDestroy(PIPELINE *pipeline);
+
+#endif
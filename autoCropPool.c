@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "allheaders.h"
+#include <assert.h>
+#include "autoCropCommon.h"
+#include "autoCropPool.h"
+
+/*  Size-classed pool for PIX image data, installed with Leptonica's
+    setPixMemoryManager(). Every leaf of a batch allocates and frees the same
+    sequence of large images (full-res gray, its rotated copy, binaries,
+    rotated proxies). glibc serves each of those with a fresh mmap, so every
+    leaf pays for the syscalls and the page faults again.
+
+    Buffers of kPoolMinBytes or more are rounded up to one of four size classes
+    per doubling and, when freed, kept on a free list for their class instead
+    of going back to the system. Once the first leaf has run, later leaves of
+    the same size reuse those buffers and make no large allocations. The cache
+    is capped; buffers freed past the cap go back to malloc.
+
+    Every buffer is counted while it is live, so a leaf that leaks a PIX shows
+    up in PixPoolGetStats().
+
+    One mutex guards the free lists and the counts, so threads that decode
+    or crop leaves can share the pool. Must be installed before any PIX is
+    created.
+*/
+
+#define kPoolMinBytes           (256 << 10)  //smaller buffers go straight to malloc
+#define kPoolClassesPerDoubling 4
+#define kPoolNumClasses         64           //kPoolMinBytes << 16 is the largest class
+
+/// Sits in front of every buffer handed to Leptonica. 16 bytes, so the data
+/// keeps malloc's 16 byte alignment for SSE2 loads.
+typedef union PoolHeader {
+    struct {
+        union PoolHeader *next;       //free list link while cached
+        l_int32           sizeClass;  //-1 if not pooled
+    } h;
+    char pad[16];
+} POOLHEADER;
+
+static POOLHEADER   *freeList[kPoolNumClasses];
+static size_t        maxCached = 0;
+static PIXPOOLSTATS  poolStats = {0, 0, 0, 0, 0};
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/// ClassBytes()
+/// Size of the buffers in sizeClass.
+///____________________________________________________________________________
+static size_t ClassBytes(l_int32 sizeClass)
+{
+    size_t base = (size_t)kPoolMinBytes << (sizeClass / kPoolClassesPerDoubling);
+    return base + base / kPoolClassesPerDoubling * (sizeClass % kPoolClassesPerDoubling);
+}
+
+
+/// PoolAlloc()
+/// The allocator given to setPixMemoryManager().
+///____________________________________________________________________________
+static void *PoolAlloc(size_t bytes)
+{
+    pthread_mutex_lock(&poolLock);
+    poolStats.allocBytes += bytes;
+
+    l_int32 sizeClass = -1;
+    if (bytes >= kPoolMinBytes) {
+        for (sizeClass=0; sizeClass<kPoolNumClasses; sizeClass++) {
+            if (ClassBytes(sizeClass) >= bytes) break;
+        }
+        if (kPoolNumClasses == sizeClass) sizeClass = -1;
+    }
+
+    POOLHEADER *hdr;
+    if ((-1 != sizeClass) && (NULL != freeList[sizeClass])) {
+        hdr = freeList[sizeClass];
+        freeList[sizeClass] = hdr->h.next;
+        poolStats.cachedBytes -= ClassBytes(sizeClass);
+        poolStats.reused++;
+    } else {
+        if (-1 != sizeClass) {
+            bytes = ClassBytes(sizeClass);
+            poolStats.largeAllocs++;
+        }
+        pthread_mutex_unlock(&poolLock);
+        hdr = (POOLHEADER *)malloc(sizeof(POOLHEADER) + bytes);
+        if (NULL == hdr) return NULL;
+        pthread_mutex_lock(&poolLock);
+    }
+
+    hdr->h.next      = NULL;
+    hdr->h.sizeClass = sizeClass;
+    poolStats.liveBuffers++;
+    pthread_mutex_unlock(&poolLock);
+    return hdr + 1;
+}
+
+
+/// PoolFree()
+/// The deallocator given to setPixMemoryManager().
+///____________________________________________________________________________
+static void PoolFree(void *ptr)
+{
+    if (NULL == ptr) return;
+
+    POOLHEADER *hdr = (POOLHEADER *)ptr - 1;
+    l_int32 sizeClass = hdr->h.sizeClass;
+    pthread_mutex_lock(&poolLock);
+    poolStats.liveBuffers--;
+    if ((-1 == sizeClass) || (poolStats.cachedBytes + ClassBytes(sizeClass) > maxCached)) {
+        pthread_mutex_unlock(&poolLock);
+        free(hdr);
+        return;
+    }
+
+    hdr->h.next = freeList[sizeClass];
+    freeList[sizeClass] = hdr;
+    poolStats.cachedBytes += ClassBytes(sizeClass);
+    pthread_mutex_unlock(&poolLock);
+}
+
+
+/// PixPoolInstall()
+/// Route all PIX image data through the pool, keeping at most maxCachedBytes
+/// of freed buffers for reuse. Call before any PIX is created: data that was
+/// allocated by plain malloc would be handed to PoolFree().
+///____________________________________________________________________________
+void PixPoolInstall(size_t maxCachedBytes)
+{
+    maxCached = maxCachedBytes;
+    setPixMemoryManager(PoolAlloc, PoolFree);
+}
+
+
+/// PixPoolGetStats()
+/// Counts since the pool was installed.
+///____________________________________________________________________________
+void PixPoolGetStats(PIXPOOLSTATS *stats)
+{
+    pthread_mutex_lock(&poolLock);
+    *stats = poolStats;
+    pthread_mutex_unlock(&poolLock);
+}
+
+
+/// PixPoolRelease()
+/// Give every cached buffer back to the system. The pool stays installed.
+///____________________________________________________________________________
+void PixPoolRelease()
+{
+    l_int32 i;
+    pthread_mutex_lock(&poolLock);
+    for (i=0; i<kPoolNumClasses; i++) {
+        while (NULL != freeList[i]) {
+            POOLHEADER *hdr = freeList[i];
+            freeList[i] = hdr->h.next;
+            free(hdr);
+        }
+    }
+    poolStats.cachedBytes = 0;
+    pthread_mutex_unlock(&poolLock);
+}
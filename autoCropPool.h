@@ -0,0 +1,18 @@
+#ifndef AUTOCROP_AUTOCROPPOOL_H
+#define AUTOCROP_AUTOCROPPOOL_H
+
+#define kPixPoolDefaultCacheMB 1024
+
+typedef struct PixPoolStats {
+    l_int32  largeAllocs;   //pooled-size buffers that came from malloc
+    l_int32  reused;        //pooled-size buffers that came from the cache
+    size_t   cachedBytes;   //bytes waiting in the cache now
+    l_int32  liveBuffers;   //buffers of any size handed out and not yet freed
+    size_t   allocBytes;    //bytes asked for by Leptonica, all sizes
+} PIXPOOLSTATS;
+
+void PixPoolInstall(size_t maxCachedBytes);
+void PixPoolGetStats(PIXPOOLSTATS *stats);
+void PixPoolRelease();
+
+#endif
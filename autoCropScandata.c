@@ -0,0 +1,619 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "allheaders.h"
+#include <assert.h>
+#include "autoCropCommon.h"
+#include "autoCropScandata.h"
+
+/*  Streaming reader and writer for Scribe's scandata.xml.
+
+    scandata.xml is one <book> with a <bookData> and a <page> per leaf. A
+    large book's file runs to several MB, so neither the reader nor the
+    writer holds the document: they read it a token at a time, and keep
+    only the <page> (or <bookData>) being read.
+
+    ScandataReadPages() hands each page to a callback as soon as its </page>
+    is read, so a leaf can be processed while the rest of the file is still
+    unread.
+
+    ScandataWrite() copies the file token by token. For each page the callback
+    has autocrop elements for, the old cropBox, cropBoxAutoDetect and skew
+    elements are dropped, and the callback writes the new ones at the end of
+    the page, as processScribe.py's removeElements() and SubElement() did.
+    The autoCropVersion of <bookData> is replaced the same way. Everything
+    else, including the whitespace and comments, is copied as it was.
+
+    This is not a general XML parser: there is no namespace or DTD support,
+    and only the five predefined entities are decoded. That is all
+    scandata.xml uses.
+*/
+
+#define kXmlMaxName 64
+
+enum {
+    kTokEOF,
+    kTokText,
+    kTokStart,      //<name ...>
+    kTokEnd,        //</name>
+    kTokEmpty,      //<name .../>
+    kTokOther,      //comment, processing instruction, CDATA or DOCTYPE
+    kTokError
+};
+
+typedef struct XmlBuf {
+    char    *s;
+    size_t   len, cap;
+} XMLBUF;
+
+typedef struct XmlReader {
+    FILE    *fp;
+    XMLBUF   raw;                  //the bytes of the last token
+    char     name[kXmlMaxName];    //its element name, for tags
+} XMLREADER;
+
+/// What the reader knows about where it is in the document.
+typedef struct ScanState {
+    l_int32   depth;
+    l_int32   pageDepth;           //-1 outside a <page>
+    l_int32   bookDataDepth;       //-1 outside <bookData>
+    char      child[kXmlMaxName];  //the child of the page or bookData being read
+    XMLBUF    childText;
+    char      bookId[kScandataMaxText];
+    SCANPAGE  page;
+} SCANSTATE;
+
+enum {
+    kEventNone,
+    kEventPageStart,
+    kEventPageEnd,
+    kEventBookDataStart,
+    kEventBookDataEnd,
+    kEventChildStart               //a child of the page or bookData
+};
+
+
+/// BufAppend()
+///____________________________________________________________________________
+static void BufAppend(XMLBUF *b, const char *s, size_t n)
+{
+    if (b->len + n + 1 > b->cap) {
+        b->cap = (b->cap ? 2 * b->cap : 256);
+        while (b->len + n + 1 > b->cap) b->cap *= 2;
+        b->s = (char *)realloc(b->s, b->cap);
+        assert(NULL != b->s);
+    }
+    memcpy(b->s + b->len, s, n);
+    b->len += n;
+    b->s[b->len] = '\0';
+}
+
+
+/// BufAppendChar()
+///____________________________________________________________________________
+static inline void BufAppendChar(XMLBUF *b, char c)
+{
+    BufAppend(b, &c, 1);
+}
+
+
+/// BufClear()
+///____________________________________________________________________________
+static inline void BufClear(XMLBUF *b)
+{
+    b->len = 0;
+    if (b->s) b->s[0] = '\0';
+}
+
+
+/// BufFree()
+///____________________________________________________________________________
+static void BufFree(XMLBUF *b)
+{
+    free(b->s);
+    memset(b, 0, sizeof(*b));
+}
+
+
+/// ReadUntil()
+/// Append characters to raw until it ends with term. Returns 0, or 1 at EOF.
+///____________________________________________________________________________
+static l_int32 ReadUntil(XMLREADER *r, const char *term)
+{
+    size_t n = strlen(term);
+    l_int32 c;
+    while (EOF != (c = getc(r->fp))) {
+        BufAppendChar(&r->raw, (char)c);
+        if ((r->raw.len >= n) && (0 == memcmp(r->raw.s + r->raw.len - n, term, n))) return 0;
+    }
+    return 1;
+}
+
+
+/// ReadToken()
+/// Read the next token into r->raw, and for tags its name into r->name.
+///____________________________________________________________________________
+static l_int32 ReadToken(XMLREADER *r)
+{
+    BufClear(&r->raw);
+    r->name[0] = '\0';
+
+    l_int32 c = getc(r->fp);
+    if (EOF == c) return kTokEOF;
+
+    if ('<' != c) {
+        do {
+            BufAppendChar(&r->raw, (char)c);
+        } while ((EOF != (c = getc(r->fp))) && ('<' != c));
+        if (EOF != c) ungetc(c, r->fp);
+        return kTokText;
+    }
+
+    BufAppendChar(&r->raw, '<');
+    c = getc(r->fp);
+    if (EOF == c) return kTokError;
+    BufAppendChar(&r->raw, (char)c);
+
+    if ('?' == c) {
+        return ReadUntil(r, "?>") ? kTokError : kTokOther;
+    }
+
+    if ('!' == c) {
+        /// comment, CDATA, or DOCTYPE with an optional [internal subset]
+        l_int32 bracket = 0;
+        while (EOF != (c = getc(r->fp))) {
+            BufAppendChar(&r->raw, (char)c);
+            if ((4 == r->raw.len) && (0 == memcmp(r->raw.s, "<!--", 4))) {
+                return ReadUntil(r, "-->") ? kTokError : kTokOther;
+            }
+            if ((9 == r->raw.len) && (0 == memcmp(r->raw.s, "<![CDATA[", 9))) {
+                return ReadUntil(r, "]]>") ? kTokError : kTokOther;
+            }
+            if ('[' == c) bracket++;
+            if (']' == c) bracket--;
+            if (('>' == c) && (bracket <= 0)) return kTokOther;
+        }
+        return kTokError;
+    }
+
+    /// a tag; '>' may appear in quoted attribute values
+    char quote = 0;
+    if ('>' != c) {
+        while (EOF != (c = getc(r->fp))) {
+            BufAppendChar(&r->raw, (char)c);
+            if (quote) {
+                if (c == quote) quote = 0;
+            } else if (('"' == c) || ('\'' == c)) {
+                quote = (char)c;
+            } else if ('>' == c) {
+                break;
+            }
+        }
+        if (EOF == c) return kTokError;
+    }
+
+    const char *p = r->raw.s + 1;
+    l_int32 isEnd = ('/' == *p);
+    if (isEnd) p++;
+    size_t n = 0;
+    while (p[n] && !isspace((unsigned char)p[n]) && ('/' != p[n]) && ('>' != p[n]) && (n < kXmlMaxName-1)) {
+        r->name[n] = p[n];
+        n++;
+    }
+    r->name[n] = '\0';
+
+    if (isEnd) return kTokEnd;
+    if ((r->raw.len >= 2) && ('/' == r->raw.s[r->raw.len-2])) return kTokEmpty;
+    return kTokStart;
+}
+
+
+/// DecodeText()
+/// Copy text to out, trimmed and with the predefined entities decoded.
+///____________________________________________________________________________
+static void DecodeText(const char *text, char *out, size_t size)
+{
+    static const char *entities[][2] = {
+        {"&amp;", "&"}, {"&lt;", "<"}, {"&gt;", ">"}, {"&quot;", "\""}, {"&apos;", "'"}
+    };
+
+    while (isspace((unsigned char)*text)) text++;
+
+    size_t n = 0;
+    while (*text && (n < size-1)) {
+        l_int32 k, matched = 0;
+        if ('&' == *text) {
+            for (k=0; k<5; k++) {
+                size_t len = strlen(entities[k][0]);
+                if (0 == strncmp(text, entities[k][0], len)) {
+                    out[n++] = entities[k][1][0];
+                    text += len;
+                    matched = 1;
+                    break;
+                }
+            }
+        }
+        if (!matched) out[n++] = *text++;
+    }
+    while ((n > 0) && isspace((unsigned char)out[n-1])) n--;
+    out[n] = '\0';
+}
+
+
+/// AttrInt()
+/// The value of the integer attribute name of a start tag, or -1.
+///____________________________________________________________________________
+static l_int32 AttrInt(const char *tag, const char *name)
+{
+    size_t n = strlen(name);
+    const char *p = tag;
+    while (NULL != (p = strstr(p, name))) {
+        const char *q = p + n;
+        if (isspace((unsigned char)p[-1])) {
+            while (isspace((unsigned char)*q)) q++;
+            if ('=' == *q) {
+                q++;
+                while (isspace((unsigned char)*q)) q++;
+                if (('"' == *q) || ('\'' == *q)) return atoi(q+1);
+            }
+        }
+        p = q;
+    }
+    return -1;
+}
+
+
+/// PageInit()
+///____________________________________________________________________________
+static void PageInit(SCANPAGE *page, const char *tag)
+{
+    memset(page, 0, sizeof(*page));
+    page->leafNum      = AttrInt(tag, "leafNum");
+    page->rotateDegree = -1;
+    page->origWidth    = -1;
+    page->origHeight   = -1;
+}
+
+
+/// PageSetField()
+///____________________________________________________________________________
+static void PageSetField(SCANPAGE *page, const char *name, const char *text)
+{
+    char value[kScandataMaxText];
+    DecodeText(text, value, sizeof(value));
+
+    if      (0 == strcmp(name, "pageType"))     strcpy(page->pageType, value);
+    else if (0 == strcmp(name, "handSide"))     strcpy(page->handSide, value);
+    else if (0 == strcmp(name, "rotateDegree")) page->rotateDegree = atoi(value);
+    else if (0 == strcmp(name, "origWidth"))    page->origWidth    = atoi(value);
+    else if (0 == strcmp(name, "origHeight"))   page->origHeight   = atoi(value);
+}
+
+
+/// TrackToken()
+/// Follow the document through the token just read, filling in the page and
+/// the book id. Returns the kEvent the token made.
+///____________________________________________________________________________
+static l_int32 TrackToken(SCANSTATE *st, const XMLREADER *r, l_int32 tok)
+{
+    l_int32 inRecord = (st->pageDepth >= 0) || (st->bookDataDepth >= 0);
+    l_int32 record   = (st->pageDepth >= 0) ? st->pageDepth : st->bookDataDepth;
+
+    if ((kTokStart == tok) || (kTokEmpty == tok)) {
+        l_int32 event = kEventNone;
+        st->depth++;
+        if (!inRecord && (0 == strcmp(r->name, "page"))) {
+            st->pageDepth = st->depth;
+            PageInit(&st->page, r->raw.s);
+            event = kEventPageStart;
+        } else if (!inRecord && (0 == strcmp(r->name, "bookData"))) {
+            st->bookDataDepth = st->depth;
+            event = kEventBookDataStart;
+        } else if (inRecord && (record + 1 == st->depth)) {
+            strcpy(st->child, r->name);
+            BufClear(&st->childText);
+            event = kEventChildStart;
+        }
+        if (kTokEmpty == tok) {
+            /// an empty page or child ends here too
+            if (st->pageDepth == st->depth) {
+                st->pageDepth = -1;
+                event = kEventPageEnd;
+            } else if (st->bookDataDepth == st->depth) {
+                st->bookDataDepth = -1;
+                event = kEventBookDataEnd;
+            } else if (kEventChildStart == event) {
+                st->child[0] = '\0';
+            }
+            st->depth--;
+        }
+        return event;
+    }
+
+    if (kTokText == tok) {
+        if (inRecord && (record + 1 == st->depth) && st->child[0]) {
+            BufAppend(&st->childText, r->raw.s, r->raw.len);
+        }
+        return kEventNone;
+    }
+
+    if (kTokEnd == tok) {
+        l_int32 event = kEventNone;
+        if (inRecord && (record + 1 == st->depth) && st->child[0]) {
+            const char *text = st->childText.s ? st->childText.s : "";
+            if (st->pageDepth >= 0) {
+                PageSetField(&st->page, st->child, text);
+            } else if (0 == strcmp(st->child, "bookId")) {
+                DecodeText(text, st->bookId, sizeof(st->bookId));
+            }
+            st->child[0] = '\0';
+        } else if (st->pageDepth == st->depth) {
+            st->pageDepth = -1;
+            event = kEventPageEnd;
+        } else if (st->bookDataDepth == st->depth) {
+            st->bookDataDepth = -1;
+            event = kEventBookDataEnd;
+        }
+        st->depth--;
+        return event;
+    }
+
+    return kEventNone;
+}
+
+
+/// StateInit()
+///____________________________________________________________________________
+static void StateInit(SCANSTATE *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->pageDepth     = -1;
+    st->bookDataDepth = -1;
+}
+
+
+/// ScandataReadPages()
+/// Read filename, calling func for each <page>. Returns 0 if OK, or 1 if the
+/// file could not be read or is not well formed.
+///____________________________________________________________________________
+l_int32 ScandataReadPages(const char *filename, SCANPAGEFUNC func, void *arg)
+{
+    static char procName[] = "ScandataReadPages";
+
+    XMLREADER r;
+    memset(&r, 0, sizeof(r));
+    if (NULL == (r.fp = fopen(filename, "r"))) {
+        return ERROR_INT("scandata not found", procName, 1);
+    }
+
+    SCANSTATE st;
+    StateInit(&st);
+
+    l_int32 tok, ret = 0;
+    while ((kTokEOF != (tok = ReadToken(&r))) && (kTokError != tok)) {
+        if (kEventPageEnd == TrackToken(&st, &r, tok)) {
+            if (func(st.bookId, &st.page, arg)) break;
+        }
+    }
+    if ((kTokError == tok) || ((kTokEOF == tok) && (0 != st.depth))) {
+        ret = ERROR_INT("scandata is not well formed", procName, 1);
+    }
+
+    fclose(r.fp);
+    BufFree(&r.raw);
+    BufFree(&st.childText);
+    return ret;
+}
+
+
+/// IsAutoCropElement()
+/// Elements of a page or bookData that autocrop writes, and so replaces.
+///____________________________________________________________________________
+static l_int32 IsAutoCropElement(l_int32 inPage, const char *name)
+{
+    static const char *pageNames[] = {
+        "cropBox", "cropBoxAutoDetect", "skewAngle", "skewAngleDetect", "skewScore", "skewActive"
+    };
+    if (!inPage) return (0 == strcmp(name, "autoCropVersion"));
+
+    l_int32 i;
+    for (i=0; i<(l_int32)(sizeof(pageNames)/sizeof(pageNames[0])); i++) {
+        if (0 == strcmp(name, pageNames[i])) return 1;
+    }
+    return 0;
+}
+
+
+/// IsBlank()
+///____________________________________________________________________________
+static l_int32 IsBlank(const XMLBUF *b)
+{
+    size_t i;
+    for (i=0; i<b->len; i++) {
+        if (!isspace((unsigned char)b->s[i])) return 0;
+    }
+    return 1;
+}
+
+
+/// ScandataWrite()
+/// Copy filein to fileout, replacing the autocrop elements of each page func
+/// has elements for, and setting autoCropVersion to version. Returns 0 if OK,
+/// or 1 if filein could not be read or fileout written.
+///____________________________________________________________________________
+l_int32 ScandataWrite(const char  *filein,
+                      const char  *fileout,
+                      const char  *version,
+                      SCANWRITEFUNC func,
+                      void        *arg)
+{
+    static char procName[] = "ScandataWrite";
+
+    XMLREADER r;
+    memset(&r, 0, sizeof(r));
+    if (NULL == (r.fp = fopen(filein, "r"))) {
+        return ERROR_INT("scandata not found", procName, 1);
+    }
+    FILE *fpout = fopen(fileout, "w");
+    if (NULL == fpout) {
+        fclose(r.fp);
+        return ERROR_INT("could not open output", procName, 1);
+    }
+
+    SCANSTATE st;
+    StateInit(&st);
+
+    /// the page or bookData being copied: as it was, and without its
+    /// autocrop elements, and the blank text before its next child or end
+    XMLBUF  raw, kept, pending, indent;
+    memset(&raw, 0, sizeof(raw));
+    memset(&kept, 0, sizeof(kept));
+    memset(&pending, 0, sizeof(pending));
+    memset(&indent, 0, sizeof(indent));
+    l_int32 inRecord = 0, inPage = 0, dropDepth = -1, haveIndent = 0;
+
+    l_int32 tok;
+    while ((kTokEOF != (tok = ReadToken(&r))) && (kTokError != tok)) {
+        l_int32 depthBefore = st.depth;
+        l_int32 event       = TrackToken(&st, &r, tok);
+
+        if ((kEventPageStart == event) || (kEventBookDataStart == event)) {
+            inRecord   = 1;
+            inPage     = (kEventPageStart == event);
+            dropDepth  = -1;
+            haveIndent = 0;
+            BufClear(&raw);
+            BufClear(&kept);
+            BufClear(&pending);
+            BufClear(&indent);
+        }
+
+        if (!inRecord) {
+            fwrite(r.raw.s, 1, r.raw.len, fpout);
+            continue;
+        }
+
+        BufAppend(&raw, r.raw.s, r.raw.len);
+
+        if ((kEventPageEnd == event) || (kEventBookDataEnd == event)) {
+            l_int32 replace = inPage ? func(NULL, &st.page, indent.s ? indent.s : "", arg)
+                                     : (NULL != version);
+            if (replace) {
+                fwrite(kept.s, 1, kept.len, fpout);
+                const char *ind = indent.s ? indent.s : "";
+                if (inPage) {
+                    func(fpout, &st.page, ind, arg);
+                } else {
+                    ScandataWriteText(fpout, ind, "autoCropVersion", version);
+                }
+                fwrite(pending.s, 1, pending.len, fpout);
+                fwrite(r.raw.s, 1, r.raw.len, fpout);
+            } else {
+                fwrite(raw.s, 1, raw.len, fpout);
+            }
+            inRecord = 0;
+            continue;
+        }
+
+        if ((kEventPageStart == event) || (kEventBookDataStart == event)) {
+            BufAppend(&kept, r.raw.s, r.raw.len);
+            continue;
+        }
+
+        if (dropDepth >= 0) {
+            /// inside an element being replaced
+            if ((kTokEnd == tok) && (depthBefore == dropDepth)) dropDepth = -1;
+            continue;
+        }
+
+        l_int32 recordDepth = inPage ? st.pageDepth : st.bookDataDepth;
+
+        if ((kTokText == tok) && (recordDepth == st.depth) && IsBlank(&r.raw)) {
+            /// blank text between the children, kept back until we know
+            /// whether the next child is dropped
+            if (!haveIndent) {
+                BufAppend(&indent, r.raw.s, r.raw.len);
+                haveIndent = 1;
+            }
+            BufAppend(&pending, r.raw.s, r.raw.len);
+            continue;
+        }
+
+        if ((kEventChildStart == event) && IsAutoCropElement(inPage, r.name)) {
+            BufClear(&pending);
+            if (kTokStart == tok) dropDepth = st.depth;
+            continue;
+        }
+
+        BufAppend(&kept, pending.s ? pending.s : "", pending.len);
+        BufClear(&pending);
+        BufAppend(&kept, r.raw.s, r.raw.len);
+    }
+
+    l_int32 ret = 0;
+    if ((kTokError == tok) || (0 != st.depth)) {
+        ret = ERROR_INT("scandata is not well formed", procName, 1);
+    }
+    if (0 != fclose(fpout)) {
+        ret = ERROR_INT("could not write output", procName, 1);
+    }
+    fclose(r.fp);
+    BufFree(&r.raw);
+    BufFree(&st.childText);
+    BufFree(&raw);
+    BufFree(&kept);
+    BufFree(&pending);
+    BufFree(&indent);
+    return ret;
+}
+
+
+/// WriteEscaped()
+///____________________________________________________________________________
+static void WriteEscaped(FILE *fp, const char *text)
+{
+    for (; *text; text++) {
+        switch (*text) {
+            case '&': fputs("&amp;", fp); break;
+            case '<': fputs("&lt;", fp);  break;
+            case '>': fputs("&gt;", fp);  break;
+            default:  putc(*text, fp);
+        }
+    }
+}
+
+
+/// ScandataWriteStart()
+///____________________________________________________________________________
+void ScandataWriteStart(FILE *fp, const char *indent, const char *name)
+{
+    fprintf(fp, "%s<%s>", indent, name);
+}
+
+
+/// ScandataWriteEnd()
+///____________________________________________________________________________
+void ScandataWriteEnd(FILE *fp, const char *indent, const char *name)
+{
+    fprintf(fp, "%s</%s>", indent, name);
+}
+
+
+/// ScandataWriteText()
+/// Write <name>text</name>, starting with indent.
+///____________________________________________________________________________
+void ScandataWriteText(FILE *fp, const char *indent, const char *name, const char *text)
+{
+    fprintf(fp, "%s<%s>", indent, name);
+    WriteEscaped(fp, text);
+    fprintf(fp, "</%s>", name);
+}
+
+
+/// ScandataWriteInt()
+///____________________________________________________________________________
+void ScandataWriteInt(FILE *fp, const char *indent, const char *name, l_int32 val)
+{
+    fprintf(fp, "%s<%s>%d</%s>", indent, name, val, name);
+}
@@ -0,0 +1,34 @@
+#ifndef AUTOCROP_AUTOCROPSCANDATA_H
+#define AUTOCROP_AUTOCROPSCANDATA_H
+
+#define kScandataMaxText 256
+
+/// The fields of a <page> of scandata.xml that autocrop uses. Numbers are -1
+/// and strings empty if the page does not have them.
+typedef struct ScanPage {
+    l_int32  leafNum;
+    char     pageType[kScandataMaxText];
+    l_int32  rotateDegree;
+    char     handSide[kScandataMaxText];
+    l_int32  origWidth, origHeight;
+} SCANPAGE;
+
+/// Called for each page as soon as its </page> is read. Returns 0 to go on,
+/// or 1 to stop reading.
+typedef l_int32 (*SCANPAGEFUNC)(const char *bookId, const SCANPAGE *page, void *arg);
+
+/// Called twice for each page as it is written: first with fp NULL, to ask
+/// whether there are autocrop elements for the page, and if it returned 1,
+/// again to write them to fp, each child of the page starting with indent.
+typedef l_int32 (*SCANWRITEFUNC)(FILE *fp, const SCANPAGE *page, const char *indent, void *arg);
+
+l_int32 ScandataReadPages(const char *filename, SCANPAGEFUNC func, void *arg);
+l_int32 ScandataWrite(const char *filein, const char *fileout, const char *version,
+                      SCANWRITEFUNC func, void *arg);
+
+void    ScandataWriteStart(FILE *fp, const char *indent, const char *name);
+void    ScandataWriteEnd(FILE *fp, const char *indent, const char *name);
+void    ScandataWriteText(FILE *fp, const char *indent, const char *name, const char *text);
+void    ScandataWriteInt(FILE *fp, const char *indent, const char *name, l_int32 val);
+
+#endif
@@ -2,7 +2,33 @@
 Copyright(c)2008 Internet Archive. Software license GPL version 2.
 
 run with:
-autoCropScribe filein.jpg rotateDirection
+autoCropScribe [--stats] [--progressive] filein.jpg rotateDirection
+or, for many leaves in one process:
+autoCropScribe [--stats] [--priors] [--book] [--progressive] [--cache cachefile]
+               [--pipeline readers,decoders] --batch listfile
+--priors starts each leaf's edge searches from where the previous leaf of the
+same hand found them, falling back to the full search if they are not there
+--book fits the crop boxes of the leaves to the book's page size at the end,
+as processScribe.py's pass 2 did
+--cache keeps the results of each leaf in cachefile, and does not crop leaves
+again whose jpeg has not changed since
+--progressive prints the crop from the 1/8 size proxy as soon as it is found,
+after a "phase: proxy" line, and then the refined crop after "phase: refine"
+--pipeline readers,decoders reads the jpegs of the next leaves into memory on
+readers threads (0 to read on the decoders) and decodes them on decoders
+threads while the current leaf is cropped, for jpgs on a slow or network disk. The
+output is the same. Not with --stats
+or, for a whole book, writing the crop boxes into its scandata.xml:
+autoCropScribe [--stats] [--priors] [--cache cachefile] --scandata scandata.xml jpgDir
+which keeps its cache in scandata.xml.autocrop-cache unless told otherwise,
+and resumes from it if run again. It exits with 2 if some leaves failed but
+scandata.xml was written, and 1 if it was not.
+or, for quick feedback at capture time, the outer crop and binding angle from
+the 1/8 size proxy alone, within about ms milliseconds (50):
+autoCropScribe [--stats] --mode=realtime [--budget ms] filein.jpg rotateDirection
+which prints the refinements it skipped and the time it took.
+or, to check that a leaf frees everything it allocates:
+autoCropScribe --leak-check numLeaves filein.jpg rotateDirection
 
 rotationDirection is 1, -1, or 0
 We use 1 to indicate that the page should be rotated clockwise, and -1 to
@@ -12,12 +38,24 @@ which do not need to be rotated.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h> //for strcmp
+#include <ctype.h>  //for isspace
+#include <unistd.h> //for sysconf, access
 #include "allheaders.h"
 #include <assert.h>
 #include <math.h>   //for sqrt
 #include <float.h>  //for DBL_MAX
+#include <pthread.h>
 #include <limits.h> //for INT_MAX
 #include "autoCropCommon.h"
+#include "autoCropJpeg.h"
+#include "autoCropPool.h"
+#include "autoCropStats.h"
+#include "autoCropBook.h"
+#include "autoCropScandata.h"
+#include "autoCropCache.h"
+#include "autoCropPipeline.h"
+#include "autoCropScribe.h"
 
 #define debugstr printf
 //#define debugstr
@@ -25,6 +63,20 @@ which do not need to be rotated.
 
 static const l_float32  deg2rad            = 3.1415926535 / 180.;
 
+/// windows around the previous leaf's edges for --priors, on the 1/8 proxy
+#define kPriorBindingCols     6     //columns either side of the strong edge
+#define kPriorBindingAngle    0.26  //degrees either side of the binding angle
+#define kPriorBindingMinDiff  0.7   //fraction of the previous strong edge's SAD
+#define kPriorEdgeSlack       8     //rows or columns outside the previous edge
+
+/// the binding sweep of AutoCropScribeLeafRealtime()
+#define kBudgetSweepStride    5     //try every 5th angle (0.25 degrees) first
+#define kBudgetSweepMaxAngles 64
+
+/// below these, a leaf gets a fallback crop instead of an edge search
+#define kLeafMinProxySize     64    //proxy pels wide and high, a 512 pel jpeg
+#define kLeafMinPageSize      16    //proxy pels between opposite edges
+
 
 static inline l_int32 min (l_int32 a, l_int32 b) {
     return b + ((a-b) & (a-b)>>31);
@@ -514,38 +566,23 @@ l_uint32 FindBindingEdge(PIX      *pixg,
 }
 
 
-/// FindBindingEdge3()
+/// SweepBindingEdge()
+/// Rotate the proxy by -1 to 1 degrees in 0.05 degree steps, and return the
+/// column with the largest SAD over all the angles, its SAD and its angle.
 ///____________________________________________________________________________
-l_int32 FindBindingEdge3(PIX      *pixg,
-                         l_int32  rotDir,
-                         l_uint32 topEdge,
-                         l_uint32 bottomEdge,
-                         float    *skew,
-                         l_uint32 *thesh)
+static void SweepBindingEdge(PIX      *pixg,
+                             l_int32  rotDir,
+                             l_uint32 jTop,
+                             l_uint32 jBot,
+                             l_int32  *edge,
+                             l_uint32 *diff,
+                             float    *skew)
 {
-
-    //Currently, we can only do right-hand leafs
-    assert((1 == rotDir) || (-1 == rotDir));
-
     l_uint32 w = pixGetWidth( pixg );
     l_uint32 h = pixGetHeight( pixg );
 
     l_uint32 width10 = (l_uint32)(w * 0.10);
 
-    //kernel has height of (h/2 +/- h*hPercent/2)
-    l_uint32 kernelHeight10 = (l_uint32)(0.10*(bottomEdge-topEdge));
-    //l_uint32 jTop = (l_uint32)((1-kKernelHeight)*0.5*h);
-    //l_uint32 jBot = (l_uint32)((1+kKernelHeight)*0.5*h);
-    //l_uint32 jTop = topEdge+kernelHeight10;
-    //l_uint32 jBot = bottomEdge-kernelHeight10;
-//we sometimes pick up an picture edge on teh opposing page..
-//extending jTop and jBot allows us to hopefully get some page margin in the calculation
-l_uint32 jTop = 0;
-l_uint32 jBot = h-1;
-
-    // Find the strong edge, which should be one of the two sides of the binding
-    // Rotate the image to maximize SAD
-
     l_uint32 left, right;
     if (1 == rotDir) {
         left  = 0;
@@ -566,6 +603,7 @@ l_uint32 jBot = h-1;
 
         if ((delta>-0.01) && (delta<0.01)) { continue;}
 
+        StatsBegin(kStageBindingSweep);
         PIX *pixt = pixRotate(pixg,
                         deg2rad*delta,
                         L_ROTATE_AREA_MAP,
@@ -602,15 +640,224 @@ l_uint32 jBot = h-1;
 
 
         pixDestroy(&pixt);
+        StatsEnd(kStageBindingSweep, (size_t)w*h);
     }
 
-    assert(-1 != bindingEdge); //TODO: handle error
-    printf("BEST: delta=%f, strongest edge of gutter is at i=%d with diff=%d\n", bindingDelta, bindingEdge, bindingEdgeDiff);
+    *edge = bindingEdge;
+    *diff = bindingEdgeDiff;
     *skew = bindingDelta;
+}
+
+
+/// SweepBindingEdgePrior()
+/// SweepBindingEdge() over the angles within kPriorBindingAngle of the
+/// previous leaf's binding angle, and the columns within kPriorBindingCols
+/// of its strong edge. Only those columns are rotated. Returns 0 if the edge
+/// found is inside both windows and about as strong as the previous one, or
+/// 1 if the full sweep should be run instead.
+///____________________________________________________________________________
+static l_int32 SweepBindingEdgePrior(PIX               *pixg,
+                                     l_int32           rotDir,
+                                     l_uint32          jTop,
+                                     l_uint32          jBot,
+                                     const SCRIBEPRIOR *prior,
+                                     l_int32           *edge,
+                                     l_uint32          *diff,
+                                     float             *skew)
+{
+    l_int32 w = pixGetWidth( pixg );
+    l_int32 h = pixGetHeight( pixg );
+
+    l_int32 width10 = (l_int32)(w * 0.10);
+
+    /// the columns of the full sweep at its widest, clipped to the window
+    l_int32 colMin, colMax;
+    if (1 == rotDir) {
+        colMin = max(prior->strongEdge - kPriorBindingCols, 0);
+        colMax = min(prior->strongEdge + kPriorBindingCols, width10);
+    } else {
+        colMin = max(prior->strongEdge - kPriorBindingCols, w - width10);
+        colMax = min(prior->strongEdge + kPriorBindingCols, w - 2);
+    }
+    if (colMax - colMin < 2) return 1;
+
+    l_int32    bindingEdge     = -1;
+    l_uint32   bindingEdgeDiff = 0;
+    float      bindingDelta    = 0.0;
+    float      deltaMin        = 2.0;
+    float      deltaMax        = -2.0;
+
+    if (fabs(prior->bindingAngle) <= kPriorBindingAngle) {
+        CalculateSADcol(pixg, colMin, colMax, jTop, jBot, &bindingEdge, &bindingEdgeDiff);
+        deltaMin = deltaMax = 0.0;
+    }
+
+    float delta;
+    //the same steps as SweepBindingEdge(), so the angles found match
+    for (delta=-1.0; delta<=1.0; delta+=0.05) {
+
+        if ((delta>-0.01) && (delta<0.01)) { continue;}
+        if (fabs(delta - prior->bindingAngle) > kPriorBindingAngle) { continue;}
+
+        /// the column range SweepBindingEdge() would search at this angle
+        l_int32 limitLeft = calcLimitLeft(w,h,delta);
+        l_int32 left, right;
+        if (1 == rotDir) {
+            left  = max(limitLeft, colMin);
+            right = colMax;
+        } else {
+            left  = colMin;
+            right = min(w - limitLeft-1, colMax);
+        }
+        if (right - left < 1) { continue;}
+
+        StatsBegin(kStageBindingSweep);
+        BOX *box  = boxCreate(left, 0, right-left+2, h);
+        PIX *pixt = RotateRegionAMGray(pixg, deg2rad*delta, 0, box);
+        assert(NULL != pixt);
+
+        l_int32    strongEdge;
+        l_uint32   strongEdgeDiff;
+        CalculateSADcol(pixt, 0, right-left, jTop, jBot, &strongEdge, &strongEdgeDiff);
+        if (strongEdgeDiff > bindingEdgeDiff) {
+            bindingEdge = left + strongEdge;
+            bindingEdgeDiff = strongEdgeDiff;
+            bindingDelta = delta;
+        }
+        if (delta < deltaMin) deltaMin = delta;
+        if (delta > deltaMax) deltaMax = delta;
+
+        pixDestroy(&pixt);
+        boxDestroy(&box);
+        StatsEnd(kStageBindingSweep, (size_t)(right-left+2)*h);
+    }
+
+    /// an edge on the border of either window may have a stronger one
+    /// just outside it
+    if ((-1 == bindingEdge) || (bindingEdge <= colMin) || (bindingEdge >= colMax-1)) return 1;
+    if ((bindingDelta <= deltaMin) || (bindingDelta >= deltaMax)) return 1;
+    if (bindingEdgeDiff < kPriorBindingMinDiff * prior->strongDiff) return 1;
+
     #if DEBUGMOV
-    debugmov.angle = bindingDelta;
+    debugmov.edgeBinding = bindingEdge;
     #endif //DEBUGMOV
 
+    *edge = bindingEdge;
+    *diff = bindingEdgeDiff;
+    *skew = bindingDelta;
+    return 0;
+}
+
+
+/// SweepBindingEdgeBudget()
+/// SweepBindingEdge() with a deadline, from MonotonicSeconds(). It tries the
+/// same angles and columns, but rotates only the columns each angle searches,
+/// and tries every kBudgetSweepStride'th angle first, so an early stop still
+/// covers the whole range coarsely. Ties go to the angle SweepBindingEdge()
+/// tries first, so a sweep that finishes finds the same edge. Returns the
+/// number of angles left untried.
+///____________________________________________________________________________
+static l_int32 SweepBindingEdgeBudget(PIX      *pixg,
+                                      l_int32  rotDir,
+                                      l_uint32 jTop,
+                                      l_uint32 jBot,
+                                      double   deadline,
+                                      l_int32  *edge,
+                                      l_uint32 *diff,
+                                      float    *skew)
+{
+    l_int32 w = pixGetWidth( pixg );
+    l_int32 h = pixGetHeight( pixg );
+
+    l_int32 width10 = (l_int32)(w * 0.10);
+
+    /// the angles of SweepBindingEdge(), in its order
+    float   deltas[kBudgetSweepMaxAngles];
+    l_int32 numDeltas = 0;
+    float   delta;
+    for (delta=-1.0; delta<=1.0; delta+=0.05) {
+        if ((delta>-0.01) && (delta<0.01)) { continue;}
+        assert(numDeltas < kBudgetSweepMaxAngles);
+        deltas[numDeltas++] = delta;
+    }
+
+    l_int32 left, right;
+    if (1 == rotDir) {
+        left  = 0;
+        right = width10;
+    } else {
+        left  = w - width10;
+        right = w - 1;
+    }
+
+    l_int32    bindingEdge;
+    l_uint32   bindingEdgeDiff;
+    float      bindingDelta = 0.0;
+    l_int32    bindingIndex = -1;  //the unrotated proxy is tried first
+    CalculateSADcol(pixg, left, right, jTop, jBot, &bindingEdge, &bindingEdgeDiff);
+
+    l_int32 numTried = 0;
+    l_int32 pass, k;
+    for (pass=0; pass<kBudgetSweepStride; pass++) {
+        for (k=pass; k<numDeltas; k+=kBudgetSweepStride) {
+            if (MonotonicSeconds() >= deadline) break;
+            numTried++;
+
+            delta = deltas[k];
+            l_int32 limitLeft = calcLimitLeft(w,h,delta);
+            if (1 == rotDir) {
+                left  = limitLeft;
+                right = width10;
+            } else {
+                left  = w - width10;
+                right = w - limitLeft-1;
+            }
+            if (right - left < 1) { continue;}
+
+            StatsBegin(kStageBindingSweep);
+            BOX *box  = boxCreate(left, 0, right-left+1, h);
+            PIX *pixt = RotateRegionAMGray(pixg, deg2rad*delta, 0, box);
+            assert(NULL != pixt);
+
+            l_int32    strongEdge;
+            l_uint32   strongEdgeDiff;
+            CalculateSADcol(pixt, 0, right-left, jTop, jBot, &strongEdge, &strongEdgeDiff);
+            if ((strongEdgeDiff > bindingEdgeDiff)
+                || ((strongEdgeDiff == bindingEdgeDiff) && (-1 != strongEdge) && (k < bindingIndex))) {
+                bindingEdge     = left + strongEdge;
+                bindingEdgeDiff = strongEdgeDiff;
+                bindingDelta    = delta;
+                bindingIndex    = k;
+            }
+
+            pixDestroy(&pixt);
+            boxDestroy(&box);
+            StatsEnd(kStageBindingSweep, (size_t)(right-left+1)*h);
+        }
+    }
+
+    *edge = bindingEdge;
+    *diff = bindingEdgeDiff;
+    *skew = bindingDelta;
+    return numDeltas - numTried;
+}
+
+
+/// BindingFromStrongEdge()
+/// The rest of FindBindingEdge3(), once the sweep has found the strong edge
+/// and its angle: the threshold between the two sides of the strong edge,
+/// and the edge of the binding on the page side of the dark gutter.
+///____________________________________________________________________________
+static l_int32 BindingFromStrongEdge(PIX      *pixg,
+                                     l_int32  rotDir,
+                                     l_uint32 jTop,
+                                     l_uint32 jBot,
+                                     l_int32  bindingEdge,
+                                     float    bindingDelta,
+                                     l_uint32 *thesh)
+{
+    l_uint32 w = pixGetWidth( pixg );
+
     // Now compute threshold for psudo-bitonalization
     // Use midpoint between avg luma of dark and light lines of binding edge
 
@@ -687,6 +934,7 @@ l_uint32 jBot = h-1;
         printf("numBlackLines = %d\n", numBlackLines);
 
     } else {
+        pixDestroy(&pixt);
         return -1; //TODO: handle error
     }
 
@@ -714,6 +962,8 @@ l_uint32 jBot = h-1;
     printf("%d: numBlack=%d\n", i, numBlackPels);
     */
     ///end temp code
+    pixDestroy(&pixt);
+
 printf("rightEdge = %d, bindingEdge = %d\n", rightEdge, bindingEdge);
     if ((numBlackLines >=1) && (numBlackLines<width3p)) {
         if (1 == rotDir) {
@@ -721,7 +971,7 @@ printf("rightEdge = %d, bindingEdge = %d\n", rightEdge, bindingEdge);
         } else if (-1 == rotDir) {
             return leftEdge;
         } else {
-            assert(0);
+            return -1;
         }
     } else {
         debugstr("COULD NOT FIND BINDING, using strongest edge!\n");
@@ -731,6 +981,69 @@ printf("rightEdge = %d, bindingEdge = %d\n", rightEdge, bindingEdge);
     return 1; //TODO: return error code on failure
 }
 
+
+/// FindBindingEdge3()
+/// If prior is not NULL, the sweep for the strong edge starts from the
+/// previous leaf's binding, and the strong edge found is kept in it.
+///____________________________________________________________________________
+l_int32 FindBindingEdge3(PIX         *pixg,
+                         l_int32     rotDir,
+                         l_uint32    topEdge,
+                         l_uint32    bottomEdge,
+                         float       *skew,
+                         l_uint32    *thesh,
+                         SCRIBEPRIOR *prior)
+{
+
+    //Currently, we can only do right-hand leafs
+    assert((1 == rotDir) || (-1 == rotDir));
+
+    l_uint32 h = pixGetHeight( pixg );
+
+    //kernel has height of (h/2 +/- h*hPercent/2)
+    l_uint32 kernelHeight10 = (l_uint32)(0.10*(bottomEdge-topEdge));
+    //l_uint32 jTop = (l_uint32)((1-kKernelHeight)*0.5*h);
+    //l_uint32 jBot = (l_uint32)((1+kKernelHeight)*0.5*h);
+    //l_uint32 jTop = topEdge+kernelHeight10;
+    //l_uint32 jBot = bottomEdge-kernelHeight10;
+//we sometimes pick up an picture edge on teh opposing page..
+//extending jTop and jBot allows us to hopefully get some page margin in the calculation
+l_uint32 jTop = 0;
+l_uint32 jBot = h-1;
+
+    // Find the strong edge, which should be one of the two sides of the binding
+    // Rotate the image to maximize SAD
+
+    l_int32    bindingEdge;
+    l_uint32   bindingEdgeDiff;
+    float      bindingDelta;
+    if ((NULL != prior) && prior->valid
+        && (0 == SweepBindingEdgePrior(pixg, rotDir, jTop, jBot, prior, &bindingEdge, &bindingEdgeDiff, &bindingDelta))) {
+        printf("bindingSearch: prior\n");
+        prior->numUsed[kPriorSearchBinding]++;
+    } else {
+        if (NULL != prior) printf("bindingSearch: full\n");
+        if ((NULL != prior) && prior->valid) prior->numFallback[kPriorSearchBinding]++;
+        SweepBindingEdge(pixg, rotDir, jTop, jBot, &bindingEdge, &bindingEdgeDiff, &bindingDelta);
+    }
+    if (NULL != prior) {
+        prior->strongEdge   = bindingEdge;
+        prior->strongDiff   = bindingEdgeDiff;
+        prior->bindingAngle = bindingDelta;
+    }
+
+    if (-1 == bindingEdge) {
+        return -1; //no column of the sweep had an edge
+    }
+    printf("BEST: delta=%f, strongest edge of gutter is at i=%d with diff=%d\n", bindingDelta, bindingEdge, bindingEdgeDiff);
+    *skew = bindingDelta;
+    #if DEBUGMOV
+    debugmov.angle = bindingDelta;
+    #endif //DEBUGMOV
+
+    return BindingFromStrongEdge(pixg, rotDir, jTop, jBot, bindingEdge, bindingDelta, thesh);
+}
+
 /// FindOuterEdge()
 ///____________________________________________________________________________
 l_int32 FindOuterEdge(PIX     *pixg,
@@ -1492,6 +1805,7 @@ l_int32 FindCleanLinesBottom(PIX     *pixg,
 }
 
 /// FindOuterEdgeUsingCleanLines_R()
+/// Returns -1 if the search range runs off the image.
 ///____________________________________________________________________________
 
 l_int32 FindOuterEdgeUsingCleanLines_R(PIX     *pixg,
@@ -1519,8 +1833,10 @@ l_int32 limitL = edgeOuter - box20;
     for (j=edgeTop; j<=edgeBottom; j++) {
         l_int32 numWhitePels = 0;
         for (i=limitL; i<=limitR; i++) {
-            l_int32 retval = pixGetPixel(pixg, i, j, &a);
-            assert(0 == retval);
+            if (pixGetPixel(pixg, i, j, &a)) {
+                free(storage);
+                return -1;
+            }
             //if (i == limitL) debugstr("j=%d, i=%d, a=%d\n", j, i, a);
             if (a>thresh) {
                 numWhitePels++;
@@ -1544,17 +1860,22 @@ l_int32 limitL = edgeOuter - box20;
     //}
 
 
-    l_int32 longestLine = 0;
+    l_int32 longestLine = limitL - 1;
     for (i=limitL; i<=limitR; i++) {
         if (storage[i-limitL]>0) {
             longestLine = i;
         }
     }
+    if (longestLine < limitL) {
+        debugstr("no rows between top and bottom edges. fail!\n");
+        free(storage);
+        return edgeOuter;
+    }
     debugstr("longest clean line is %d with count=%d\n", longestLine, storage[longestLine-limitL]);
 
     l_int32 peak = storage[longestLine-limitL];
     l_int32 peaki = longestLine;
-    for (i=(l_int32)(longestLine*0.95); i<longestLine; i++) {
+    for (i=max(limitL, (l_int32)(longestLine*0.95)); i<longestLine; i++) {
         if (storage[i-limitL]>peak) {
             peaki = i;
             peak = storage[i-limitL];
@@ -1575,6 +1896,7 @@ l_int32 limitL = edgeOuter - box20;
 
 
 /// FindOuterEdgeUsingCleanLines_L()
+/// Returns -1 if the search range runs off the image.
 ///____________________________________________________________________________
 
 l_int32 FindOuterEdgeUsingCleanLines_L(PIX     *pixg,
@@ -1602,8 +1924,10 @@ l_int32 limitR = edgeOuter + box20;
     for (j=edgeTop; j<=edgeBottom; j++) {
         l_int32 numWhitePels = 0;
         for (i=limitR; i>=limitL; i--) {
-            l_int32 retval = pixGetPixel(pixg, i, j, &a);
-            assert(0 == retval);
+            if (pixGetPixel(pixg, i, j, &a)) {
+                free(storage);
+                return -1;
+            }
             //if (i == limitR) debugstr("j=%d, i=%d, a=%d\n", j, i, a);
             if (a>thresh) {
                 numWhitePels++;
@@ -1626,12 +1950,17 @@ l_int32 limitR = edgeOuter + box20;
     //}
 
 
-    l_int32 longestLine = 0;
+    l_int32 longestLine = limitR + 1;
     for (i=limitR; i>=limitL; i--) {
         if (storage[i-limitL]>0) {
             longestLine = i;
         }
     }
+    if (longestLine > limitR) {
+        debugstr("no rows between top and bottom edges. fail!\n");
+        free(storage);
+        return edgeOuter;
+    }
     debugstr("longest clean line is %d with count=%d\n", longestLine, storage[longestLine-limitL]);
 
     l_int32 peak = storage[longestLine-limitL];
@@ -1659,6 +1988,7 @@ l_int32 limitR = edgeOuter + box20;
 }
 
 /// FindOuterEdgeUsingCleanLines()
+/// Returns -1 if the search fails, or rotDir is not 1 or -1.
 ///____________________________________________________________________________
 
 l_int32 FindOuterEdgeUsingCleanLines(PIX     *pixg,
@@ -1675,60 +2005,352 @@ l_int32 FindOuterEdgeUsingCleanLines(PIX     *pixg,
     } else if (-1 == rotDir) {
         newEdgeOuter = FindOuterEdgeUsingCleanLines_L(pixg, edgeBinding, edgeOuter, edgeTop, edgeBottom, thresh);
     } else {
-        assert(0);
+        newEdgeOuter = -1;
     }
 
     return newEdgeOuter;
 }
 
 
-/// main()
+/// BackgroundEdgeFromPrior()
+/// Find the top, bottom or outer edge of the proxy by scanning in from
+/// kPriorEdgeSlack outside the previous leaf's edge, instead of from the edge
+/// of the image. which is 't', 'b' or 'o'. If the scan stops where it
+/// started, the edge may be further out, and the full scan is run.
 ///____________________________________________________________________________
-int main(int argc, char **argv) {
-    PIX         *pixs, *pixd, *pixg;
-    char        *filein;
-    static char  mainName[] = "autoCropScribe";
-    l_int32      rotDir;
-    FILE        *fp;
+static l_int32 BackgroundEdgeFromPrior(PIX         *pixg,
+                                       l_int32     rotDir,
+                                       l_int32     thresh,
+                                       char        which,
+                                       l_int32     topEdge,
+                                       l_int32     bottomEdge,
+                                       SCRIBEPRIOR *prior)
+{
+    l_int32 w = pixGetWidth(pixg);
+    l_int32 h = pixGetHeight(pixg);
+    l_int32 start, edge;
+
+    if ('t' == which) {
+        start = max(prior->topEdge - kPriorEdgeSlack, 0);
+        edge  = RemoveBackgroundTopFrom(pixg, rotDir, thresh, start);
+        if ((0 == start) || (edge > start)) { prior->numUsed[kPriorSearchBackground]++; return edge; }
+        prior->numFallback[kPriorSearchBackground]++;
+        return RemoveBackgroundTop(pixg, rotDir, thresh);
+    } else if ('b' == which) {
+        start = min(prior->bottomEdge + kPriorEdgeSlack, h-1);
+        edge  = RemoveBackgroundBottomFrom(pixg, rotDir, thresh, start);
+        if ((h-1 == start) || (edge < start)) { prior->numUsed[kPriorSearchBackground]++; return edge; }
+        prior->numFallback[kPriorSearchBackground]++;
+        return RemoveBackgroundBottom(pixg, rotDir, thresh);
+    }
+
+    assert('o' == which);
+    if (1 == rotDir) {
+        start = min(prior->outerEdge + kPriorEdgeSlack, w-1);
+        edge  = RemoveBackgroundOuterFrom(pixg, rotDir, topEdge, bottomEdge, thresh, start);
+        if ((w-1 == start) || (edge < start)) { prior->numUsed[kPriorSearchBackground]++; return edge; }
+    } else {
+        start = max(prior->outerEdge - kPriorEdgeSlack, 0);
+        edge  = RemoveBackgroundOuterFrom(pixg, rotDir, topEdge, bottomEdge, thresh, start);
+        if ((0 == start) || (edge > start)) { prior->numUsed[kPriorSearchBackground]++; return edge; }
+    }
+    prior->numFallback[kPriorSearchBackground]++;
+    return RemoveBackgroundOuter(pixg, rotDir, topEdge, bottomEdge, thresh);
+}
 
-    if (argc != 3) {
-        exit(ERROR_INT(" Syntax:  autoCrop filein.jpg rotateDirection",
-                         mainName, 1));
+
+static const char *leafErrorNames[kNumLeafErrors] = {
+    "ok",
+    "unreadable",
+    "rotateDirection",
+    "tooSmall",
+    "noPage",
+    "noBinding",
+};
+
+
+/// LeafErrorName()
+/// A word for a kLeafError*, for "leafError:" lines and the leaf cache.
+///____________________________________________________________________________
+const char *LeafErrorName(l_int32 error) {
+    assert((error >= 0) && (error < kNumLeafErrors));
+    return leafErrorNames[error];
+}
+
+
+/// LeafErrorFromName()
+/// The kLeafError* that LeafErrorName() gives name for, as the leaf cache
+/// keeps it. Other names, such as the cache's "crashed", give
+/// kLeafErrorUnreadable.
+///____________________________________________________________________________
+l_int32 LeafErrorFromName(const char *name) {
+    l_int32 error;
+    for (error=kLeafErrorUnreadable; error<kNumLeafErrors; error++) {
+        if (0 == strcmp(name, leafErrorNames[error])) return error;
+    }
+    return kLeafErrorUnreadable;
+}
+
+
+/// LeafJpegSize()
+/// ReadJpegSize() from jpeg if the leaf has read the file into it, else from
+/// filein. jpeg may be NULL.
+///____________________________________________________________________________
+static l_int32 LeafJpegSize(const char *filein, const JPEGFILE *jpeg, l_int32 rotDir, l_int32 *pw, l_int32 *ph) {
+    if ((NULL != jpeg) && (NULL != jpeg->data)) {
+        return ReadJpegSizeMem(jpeg->data, jpeg->size, rotDir, pw, ph);
     }
+    return ReadJpegSize(filein, rotDir, pw, ph);
+}
+
+
+/// LeafUnreadable()
+/// The exit of a leaf whose jpeg could not be read or decoded in stage: close
+/// the stage and the leaf's stats, and print the "leafError:" line. Returns
+/// kLeafErrorUnreadable.
+///____________________________________________________________________________
+static l_int32 LeafUnreadable(l_int32 stage, const char *msg, const char *procName)
+{
+    StatsEnd(stage, 0);
+    StatsPrintLeaf();
+    printf("leafError: %s\n", LeafErrorName(kLeafErrorUnreadable));
+    return ERROR_INT(msg, procName, kLeafErrorUnreadable);
+}
+
+
+/// LeafFallback()
+/// Fill in and print the fallback crop of a leaf whose searches failed with
+/// error: the proxy edges that were found, -1 for those that were not, and
+/// the border of the image for the rest. Returns error, or
+/// kLeafErrorUnreadable if the size of the jpeg cannot be read.
+///____________________________________________________________________________
+static l_int32 LeafFallback(const char     *filein,
+                            const JPEGFILE *jpeg,
+                            l_int32         rotDir,
+                            l_int32         error,
+                            l_int32         grayChannel,
+                            l_int32         topEdge,
+                            l_int32         bottomEdge,
+                            l_int32         bindingEdge,
+                            l_int32         outerEdge,
+                            LEAFCROPS      *crops)
+{
+    l_int32 w, h;
+    if (LeafJpegSize(filein, jpeg, rotDir, &w, &h)) {
+        printf("leafError: %s\n", LeafErrorName(kLeafErrorUnreadable));
+        return kLeafErrorUnreadable;
+    }
+
+    l_int32 edgeL = (1 == rotDir) ? bindingEdge : outerEdge;
+    l_int32 edgeR = (1 == rotDir) ? outerEdge : bindingEdge;
+
+    LEAFCROPS c;
+    memset(&c, 0, sizeof(c));
+    c.rotDir = rotDir;
+    c.w      = w;
+    c.h      = h;
+    c.outerL = (-1 == edgeL)      ? 0   : min(edgeL*8, w-1);
+    c.outerR = (-1 == edgeR)      ? w-1 : min(edgeR*8, w-1);
+    c.outerT = (-1 == topEdge)    ? 0   : min(topEdge*8, h-1);
+    c.outerB = (-1 == bottomEdge) ? h-1 : min(bottomEdge*8, h-1);
+    if (c.outerR <= c.outerL) {
+        c.outerL = 0;
+        c.outerR = w-1;
+    }
+    if (c.outerB <= c.outerT) {
+        c.outerT = 0;
+        c.outerB = h-1;
+    }
+    c.cleanL = c.outerL;
+    c.cleanR = c.outerR;
+    c.cleanT = c.outerT;
+    c.cleanB = c.outerB;
+    c.innerL = c.innerR = c.innerT = c.innerB = -1;
+    c.skewMode    = kSkewModeEdge;
+    c.grayChannel = grayChannel;
+    c.error       = error;
+
+    LeafCropsPrintCrops(&c);
+    printf("leafError: %s\n", LeafErrorName(error));
+    if (NULL != crops) *crops = c;
+    return error;
+}
+
+
+/// ProxyCrops()
+/// The crop of a leaf from its proxy edges alone, at full size, as the full
+/// crop has it before the outer edge is refined: the clean crop is the outer
+/// crop, the angle is the binding angle, and there is no inner crop. Returns
+/// 1 if the size of the jpeg cannot be read.
+///____________________________________________________________________________
+static l_int32 ProxyCrops(const char     *filein,
+                          const JPEGFILE *jpeg,
+                          l_int32         rotDir,
+                          l_int32         grayChannel,
+                          l_int32         topEdge,
+                          l_int32         bottomEdge,
+                          l_int32         bindingEdge,
+                          l_int32         outerEdge,
+                          float           deltaBinding,
+                          LEAFCROPS      *c)
+{
+    l_int32 w, h;
+    if (LeafJpegSize(filein, jpeg, rotDir, &w, &h)) return 1;
+
+    l_int32 edgeL = (1 == rotDir) ? bindingEdge : outerEdge;
+    l_int32 edgeR = (1 == rotDir) ? outerEdge : bindingEdge;
+
+    memset(c, 0, sizeof(*c));
+    c->rotDir = rotDir;
+    c->w      = w;
+    c->h      = h;
+    c->outerL = min(edgeL*8, w-1);
+    c->outerR = min(edgeR*8, w-1);
+    c->outerT = min(topEdge*8, h-1);
+    c->outerB = min(bottomEdge*8, h-1);
+    c->cleanL = c->outerL;
+    c->cleanR = c->outerR;
+    c->cleanT = c->outerT;
+    c->cleanB = c->outerB;
+    c->innerL = c->innerR = c->innerT = c->innerB = -1;
+    c->angle        = deltaBinding;
+    c->conf         = 0.0;
+    c->bindingAngle = deltaBinding;
+    c->skewMode     = kSkewModeEdge;
+    c->grayChannel  = grayChannel;
+    c->error        = kLeafOK;
+    return 0;
+}
+
+
+/// AutoCropScribeLeaf()
+/// Find the crop boxes and skew of one leaf and print them. This was main()
+/// before batch mode. Returns kLeafOK (0) or a kLeafError*, after printing a
+/// "leafError:" line. A leaf whose edge searches fail does not abort; it
+/// prints a fallback crop (see autoCropScribe.h). Leaves may be run on
+/// several threads at once, as long as --stats is off.
+///____________________________________________________________________________
+l_int32 AutoCropScribeLeaf(const char *filein, l_int32 rotDir) {
+    return AutoCropScribeLeafWithPrior(filein, rotDir, NULL, NULL, NULL);
+}
 
-    filein  = argv[1];
-    rotDir  = atoi(argv[2]);
 
-    if ((fp = fopenReadStream(filein)) == NULL) {
-        exit(ERROR_INT("image file not found", mainName, 1));
+/// LeafFree()
+/// Free what AutoCropScribeLeafProxy() kept in leaf.
+///____________________________________________________________________________
+static void LeafFree(SCRIBELEAF *leaf) {
+    boxDestroy(&leaf->box);
+    pixDestroy(&leaf->pixBig);
+    pixDestroy(&leaf->pixg);
+    pixDestroy(&leaf->pixd);
+    JpegFileFree(&leaf->jpeg);
+    FREE(leaf->filein);
+    leaf->filein = NULL;
+}
+
+
+/// DecodedFree()
+/// Free the images of decoded that a leaf did not take. decoded may be NULL.
+///____________________________________________________________________________
+static void DecodedFree(SCRIBEDECODED *decoded) {
+    if (NULL == decoded) return;
+    pixDestroy(&decoded->pixProxy);
+    pixDestroy(&decoded->pixBig);
+    JpegFileFree(&decoded->jpeg);
+}
+
+
+/// AutoCropScribeDecode()
+/// Decode the images of a leaf ahead of AutoCropScribeLeafWithPrior() or
+/// AutoCropScribeLeafProxy(), which would otherwise decode them itself: the
+/// proxy in color, and the full size image in the gray channel the proxy
+/// will choose. Both come from decoded->jpeg, which is read from filein
+/// first unless the caller has read it already. decoded starts zeroed.
+/// Prints nothing, so it can run on a thread of its own while another leaf
+/// is cropped. Returns 0, or 1 if the proxy could not be decoded. An image
+/// that cannot be decoded is left NULL, for the leaf to report.
+///____________________________________________________________________________
+l_int32 AutoCropScribeDecode(const char *filein, l_int32 rotDir, SCRIBEDECODED *decoded) {
+    if ((1 != rotDir) && (-1 != rotDir)) return 1;
+    if ((NULL == decoded->jpeg.data) && JpegFileRead(&decoded->jpeg, filein)) return 1;
+
+    const JPEGFILE *jpeg = &decoded->jpeg;
+    if ((decoded->pixProxy = ReadJpegRotatedMem(jpeg->data, jpeg->size, 8, rotDir, kJpegKeepColor)) == NULL) return 1;
+    decoded->grayChannel = ChooseGrayChannel(decoded->pixProxy, 0);
+    decoded->pixBig      = ReadJpegRotatedMem(jpeg->data, jpeg->size, 1, rotDir, decoded->grayChannel);
+    return 0;
+}
+
+
+/// LeafProxy()
+/// AutoCropScribeLeafProxy(), with crops for the fallback crop only. Takes the
+/// images of decoded (if not NULL) that it uses; DecodedFree() the rest.
+///____________________________________________________________________________
+static l_int32 LeafProxy(const char *filein, l_int32 rotDir, SCRIBEPRIOR *prior, SCRIBEDECODED *decoded, SCRIBELEAF *leaf, LEAFCROPS *crops) {
+    PIX         *pixd, *pixg;
+    static char  procName[] = "AutoCropScribeLeafProxy";
+
+    memset(leaf, 0, sizeof(*leaf));
+    StatsLeafBegin();
+
+    if ((1 != rotDir) && (-1 != rotDir)) {
+        L_ERROR_INT("rotateDirection %d is not 1 or -1", procName, rotDir);
+        printf("leafError: %s\n", LeafErrorName(kLeafErrorRotDir));
+        return kLeafErrorRotDir;
     }
-    debugstr("Opened file handle\n");
 
-    if ((pixs = pixReadStreamJpeg(fp, 0, 8, NULL, 0)) == NULL) {
-       exit(ERROR_INT("pixs not made", mainName, 1));
+    /// decode the 1/8 size proxy, rotated to portrait during the decode
+    /// read the file once, for the proxy, the size and the full size image
+    StatsBegin(kStageDecode);
+    if ((NULL != decoded) && (NULL != decoded->jpeg.data)) {
+        leaf->jpeg = decoded->jpeg;
+        decoded->jpeg.data = NULL;
+        decoded->jpeg.size = 0;
+    } else if (JpegFileRead(&leaf->jpeg, filein)) {
+        return LeafUnreadable(kStageDecode, "jpeg not read", procName);
     }
-    debugstr("Read jpeg\n");
 
-    if (rotDir) {
-        pixd = pixRotate90(pixs, rotDir);
-        debugstr("Rotated 90 degrees\n");
-    } else {
-        pixd = pixs;
+    if ((NULL != decoded) && (NULL != decoded->pixProxy)) {
+        pixd = decoded->pixProxy;
+        decoded->pixProxy = NULL;
+    } else if ((pixd = ReadJpegRotatedMem(leaf->jpeg.data, leaf->jpeg.size, 8, rotDir, kJpegKeepColor)) == NULL) {
+        return LeafUnreadable(kStageDecode, "pixd not made", procName);
     }
+    size_t pelsSmall = (size_t)pixGetWidth(pixd) * pixGetHeight(pixd);
+    StatsEnd(kStageDecode, pelsSmall);
+    debugstr("Read jpeg, rotated %d\n", rotDir);
 
     #ifdef WRITE_DEBUG_IMAGES
     pixWrite(DEBUG_IMAGE_DIR "out.jpg", pixd, IFF_JFIF_JPEG);
     #endif
 
     l_int32 grayChannel;
+    StatsBegin(kStageGray);
     pixg = ConvertToGray(pixd, &grayChannel);
+    StatsEnd(kStageGray, pelsSmall);
     debugstr("Converted to gray\n");
+
+    if ((NULL != prior) && prior->valid
+        && ((prior->w != pixGetWidth(pixg)) || (prior->h != pixGetHeight(pixg)))) {
+        prior->valid = 0;
+    }
+    l_int32 usePrior = (NULL != prior) && prior->valid;
     #ifdef WRITE_DEBUG_IMAGES
     pixWrite(DEBUG_IMAGE_DIR "outgray.jpg", pixg, IFF_JFIF_JPEG);
     #endif
 
+    /// the edge searches need some columns and rows to work in
+    if ((pixGetWidth(pixg) < kLeafMinProxySize) || (pixGetHeight(pixg) < kLeafMinProxySize)) {
+        pixDestroy(&pixg);
+        pixDestroy(&pixd);
+        StatsPrintLeaf();
+        return LeafFallback(filein, &leaf->jpeg, rotDir, kLeafErrorTooSmall, grayChannel, -1, -1, -1, -1, crops);
+    }
+
     l_int32 histmax;
+    StatsBegin(kStageThreshold);
     l_int32 threshInitial = CalculateTreshInitial(pixg, &histmax);
+    StatsEnd(kStageThreshold, pelsSmall);
     debugstr("threshInitial is %d\n", threshInitial);
 
     #ifdef WRITE_DEBUG_IMAGES
@@ -1746,7 +2368,7 @@ int main(int argc, char **argv) {
         char cmd[512];
         debugmov.outDir = DEBUG_IMAGE_DIR "debugmov";
         debugmov.framenum =-1;
-        debugmov.filename = basename(filein);
+        debugmov.filename = basename((char *)filein);
         pixWrite(DEBUG_IMAGE_DIR "debugmov/smallgray.jpg", pixg, IFF_JFIF_JPEG);
         int ret = snprintf(cmd, 512, "rm -rf %s/frames", debugmov.outDir);
         assert(ret);
@@ -1773,8 +2395,6 @@ int main(int argc, char **argv) {
 
     float delta;
 
-
-    l_int32 cropT=-1, cropB=-1, cropR=-1, cropL=-1;
     float deltaT, deltaB, deltaV1, deltaV2, deltaBinding, deltaOuter;
     l_uint32 threshBinding, threshOuter, threshT, threshB;
 
@@ -1794,26 +2414,57 @@ int main(int argc, char **argv) {
 */
     /// find top edge
     //l_int32 topEdge = FindHorizontalEdge(pixg, rotDir, bindingEdge, 0, &deltaT, &threshT);
-    l_int32 topEdge = RemoveBackgroundTop(pixg, rotDir, threshInitial);
+    StatsBegin(kStageBackground);
+    l_int32 topEdge = usePrior ? BackgroundEdgeFromPrior(pixg, rotDir, threshInitial, 't', 0, 0, prior)
+                               : RemoveBackgroundTop(pixg, rotDir, threshInitial);
 
     /// find bottom edge
     //l_int32 bottomEdge = FindHorizontalEdge(pixg, rotDir, bindingEdge, 1, &deltaB, &threshB);
-    l_int32 bottomEdge = RemoveBackgroundBottom(pixg, rotDir, threshInitial);
+    l_int32 bottomEdge = usePrior ? BackgroundEdgeFromPrior(pixg, rotDir, threshInitial, 'b', 0, 0, prior)
+                                  : RemoveBackgroundBottom(pixg, rotDir, threshInitial);
 
-    assert(bottomEdge>topEdge);
+    StatsEnd(kStageBackground, pelsSmall);
+    if (bottomEdge - topEdge < kLeafMinPageSize) {
+        pixDestroy(&pixg);
+        pixDestroy(&pixd);
+        StatsPrintLeaf();
+        return LeafFallback(filein, &leaf->jpeg, rotDir, kLeafErrorNoPage, grayChannel, -1, -1, -1, -1, crops);
+    }
 
-l_int32 bindingEdge = FindBindingEdge3(pixg, rotDir, topEdge, bottomEdge, &deltaBinding, &threshBinding);
-if (-1 == bindingEdge) {
-    debugstr("COULD NOT FIND BINDING!");
-} else {
-    debugstr("binding edge= %d\n", bindingEdge);
-}
-debugstr("binding edge threshold is %d\n", threshBinding);
+    StatsBegin(kStageBinding);
+    l_int32 bindingEdge = FindBindingEdge3(pixg, rotDir, topEdge, bottomEdge, &deltaBinding, &threshBinding, prior);
+    StatsEnd(kStageBinding, pelsSmall);
+    if (-1 == bindingEdge) {
+        debugstr("COULD NOT FIND BINDING!");
+    } else {
+        debugstr("binding edge= %d\n", bindingEdge);
+    }
+    debugstr("binding edge threshold is %d\n", threshBinding);
 
     /// find the outer vertical edge
 //    l_int32 outerEdge = FindOuterEdge(pixg, rotDir, &deltaV2, &threshOuter);
 //debugstr("outer thresh is %d\n", threshOuter);
-    l_int32 outerEdge = RemoveBackgroundOuter(pixg, rotDir, topEdge, bottomEdge, threshInitial); //TODO: why not use threshBinding here?
+    StatsBegin(kStageBackground);
+    l_int32 outerEdge = usePrior ? BackgroundEdgeFromPrior(pixg, rotDir, threshInitial, 'o', topEdge, bottomEdge, prior)
+                                 : RemoveBackgroundOuter(pixg, rotDir, topEdge, bottomEdge, threshInitial); //TODO: why not use threshBinding here?
+    StatsEnd(kStageBackground, pelsSmall);
+
+    if ((-1 == bindingEdge) || (rotDir * (outerEdge - bindingEdge) < kLeafMinPageSize)) {
+        l_int32 error = (-1 == bindingEdge) ? kLeafErrorNoBinding : kLeafErrorNoPage;
+        pixDestroy(&pixg);
+        pixDestroy(&pixd);
+        StatsPrintLeaf();
+        return LeafFallback(filein, &leaf->jpeg, rotDir, error, grayChannel, topEdge, bottomEdge, -1, outerEdge, crops);
+    }
+
+    if (NULL != prior) {
+        prior->valid      = 1;
+        prior->w          = pixGetWidth(pixg);
+        prior->h          = pixGetHeight(pixg);
+        prior->topEdge    = topEdge;
+        prior->bottomEdge = bottomEdge;
+        prior->outerEdge  = outerEdge;
+    }
 
     //l_int32 outerEdge2 = FindOuterEdgeUsingCleanLines(pixg, rotDir, bindingEdge, outerEdge, topEdge, bottomEdge, threshBinding);
 
@@ -1842,56 +2493,107 @@ debugstr("binding edge threshold is %d\n", threshBinding);
 
     //debugstr("in main: cL=%d, cR=%d, cT=%d, cB=%d\n", cropL, cropR, cropT, cropB);
 
+    leaf->filein        = stringNew(filein);
+    leaf->rotDir        = rotDir;
+    leaf->grayChannel   = grayChannel;
+    leaf->topEdge       = topEdge;
+    leaf->bottomEdge    = bottomEdge;
+    leaf->bindingEdge   = bindingEdge;
+    leaf->outerEdge     = outerEdge;
+    leaf->threshBinding = threshBinding;
+    leaf->deltaBinding  = deltaBinding;
+    leaf->pixd          = pixd;
+    leaf->pixg          = pixg;
+    leaf->box           = box;
+    if ((NULL != decoded) && (grayChannel == decoded->grayChannel)) {
+        leaf->pixBig    = decoded->pixBig;
+        decoded->pixBig = NULL;
+    }
+    return kLeafOK;
+}
+
+
+/// AutoCropScribeLeafRefine()
+/// The second phase of AutoCropScribeLeafWithPrior(): decode the full size
+/// image, find the skew, and refine the crop boxes on it. Prints the crop
+/// lines once they are all found, returns them in crops if it is not NULL,
+/// and frees leaf. If the refined edges leave no page, the crop is the
+/// fallback crop from the proxy edges, and kLeafErrorNoPage is returned.
+///____________________________________________________________________________
+l_int32 AutoCropScribeLeafRefine(SCRIBELEAF *leaf, LEAFCROPS *crops) {
+    static char  procName[] = "AutoCropScribeLeafRefine";
+
+    const char *filein        = leaf->filein;
+    l_int32     rotDir        = leaf->rotDir;
+    l_int32     grayChannel   = leaf->grayChannel;
+    l_int32     topEdge       = leaf->topEdge;
+    l_int32     bottomEdge    = leaf->bottomEdge;
+    l_int32     bindingEdge   = leaf->bindingEdge;
+    l_int32     outerEdge     = leaf->outerEdge;
+    l_uint32    threshBinding = leaf->threshBinding;
+    float       deltaBinding  = leaf->deltaBinding;
+    #ifdef WRITE_DEBUG_IMAGES
+    PIX        *pixd          = leaf->pixd;
+    #endif
+    PIX        *pixg          = leaf->pixg;
+    BOX        *box           = leaf->box;
+    l_int32     cropT, cropB, cropR, cropL;
+    l_int32     error         = kLeafOK;
+
     /// Now that we have the crop box, use Postl's meathod for deskew
     double skewScore, skewConf;
     //Deskew(pixg, cropL, cropR, cropT, cropB, &skewScore, &skewConf);
 
-    PIX *pixBig;
-
-    startTimer();
-    if ((pixBig = pixRead(filein)) == NULL) {
-       exit(ERROR_INT("pixBig not made", mainName, 1));
-    }
-    printf("opened large jpg in %7.3f sec\n", stopTimer());
+    /// decode the full size image straight to rotated gray
+    PIX *pixBigR;
 
-    PIX *pixBigG;
-    if (kGrayModeThreeChannel != grayChannel) {
-        pixBigG = pixConvertRGBToGray (pixBig, (0==grayChannel), (1==grayChannel), (2==grayChannel));
-    } else {
-        pixBigG = pixConvertRGBToGray (pixBig, 0.30, 0.60, 0.10);
+    L_TIMER timer = startTimerNested();
+    StatsBegin(kStageDecodeBig);
+    if (NULL != leaf->pixBig) {
+        pixBigR = leaf->pixBig;
+        leaf->pixBig = NULL;
+    } else if ((pixBigR = ReadJpegRotatedMem(leaf->jpeg.data, leaf->jpeg.size, 1, rotDir, grayChannel)) == NULL) {
+        LeafFree(leaf);
+        return LeafUnreadable(kStageDecodeBig, "pixBigR not made", procName);
     }
+    printf("opened large jpg in %7.3f sec\n", stopTimerNested(timer));
+    size_t pelsBig = (size_t)pixGetWidth(pixBigR) * pixGetHeight(pixBigR);
+    StatsEnd(kStageDecodeBig, pelsBig);
 
-    PIX *pixBigR = pixRotate90(pixBigG, rotDir);
     //BOX *box     = boxCreate(cropL, cropT, cropR-cropL, cropB-cropT);
-    PIX *pixBigC = pixClipRectangle(pixBigR, box, NULL);
-debugstr("croppedWidth = %d, croppedHeight=%d\n", pixGetWidth(pixBigC), pixGetHeight(pixBigC));
-    PIX *pixBigB = pixThresholdToBinary (pixBigC, threshBinding);
+    PIXVIEW viewBigC;
+    ViewInit(&viewBigC, pixBigR, box);
+debugstr("croppedWidth = %d, croppedHeight=%d\n", viewBigC.w, viewBigC.h);
+    /// binarize for skew detection, and take the histogram used for the
+    /// outer edge threshold below, in one pass
+    NUMA *histBigC;
+    StatsBegin(kStageBinarize);
+    PIX *pixBigB = ThresholdViewAndHistogram(&viewBigC, threshBinding, &histBigC);
+    StatsEnd(kStageBinarize, (size_t)viewBigC.w * viewBigC.h);
     #ifdef WRITE_DEBUG_IMAGES
     pixWrite(DEBUG_IMAGE_DIR "outbin.png", pixBigB, IFF_PNG);
     #endif
 
     l_float32    angle, conf, textAngle;
 
-    debugstr("calling pixFindSkew\n");
-    if (pixFindSkew(pixBigB, &textAngle, &conf)) {
+    debugstr("calling FindSkewUsingProjections\n");
+    StatsBegin(kStageSkew);
+    if (FindSkewUsingProjections(pixBigB, &textAngle, &conf)) {
       /* an error occured! */
         debugstr("textAngle=%.2f\ntextConf=%.2f\n", 0.0, -1.0);
      } else {
         debugstr("textAngle=%.2f\ntextConf=%.2f\n", textAngle, conf);
     }
-
-    printf("bindingAngle: %.2f\n", deltaBinding);
+    StatsEnd(kStageSkew, (size_t)viewBigC.w * viewBigC.h);
 
     //Deskew(pixbBig, cropL*8, cropR*8, cropT*8, cropB*8, &skewScore, &skewConf);
 
     l_int32 skewMode;
     if (conf >= 2.0) {
-        printf("skewMode: text\n");
         angle = textAngle;
         skewMode = kSkewModeText;
     } else {
 
-        printf("skewMode: edge\n");
         //angle = (deltaT + deltaB + deltaV1 + deltaV2)/4;
         angle = deltaBinding; //TODO: calculate average of four edge deltas.
         skewMode = kSkewModeEdge;
@@ -1899,13 +2601,12 @@ debugstr("croppedWidth = %d, croppedHeight=%d\n", pixGetWidth(pixBigC), pixGetHe
 
     debugstr("rotating bigR by %f\n", angle);
 
-    PIX *pixBigR2 = pixRotate90(pixBigG, rotDir);
-    //TODO: why does this segfault when passing in pixBigR?
-    PIX *pixBigT = pixRotate(pixBigR2,
+    StatsBegin(kStageRotate);
+    PIX *pixBigT = pixRotate(pixBigR,
                     deg2rad*angle,
                     L_ROTATE_AREA_MAP,
                     L_BRING_IN_BLACK,0,0);
-    //pixWrite(DEBUG_IMAGE_DIR "outBigR2.jpg", pixBigR2, IFF_JFIF_JPEG);
+    StatsEnd(kStageRotate, pelsBig);
     //pixWrite(DEBUG_IMAGE_DIR "outBigT.jpg", pixBigT, IFF_JFIF_JPEG);
     #ifdef WRITE_DEBUG_IMAGES
     {
@@ -1946,6 +2647,7 @@ debugstr("croppedWidth = %d, croppedHeight=%d\n", pixGetWidth(pixBigC), pixGetHe
     }
 #endif
 
+    StatsBegin(kStageOuterEdge);
     {
         PIX *pixt = pixRotate(pixg,
                         deg2rad*angle,
@@ -1954,7 +2656,7 @@ debugstr("croppedWidth = %d, croppedHeight=%d\n", pixGetWidth(pixBigC), pixGetHe
         //pixWrite(DEBUG_IMAGE_DIR "outtmp.jpg", pixt, IFF_JFIF_JPEG);
 
         //NUMA *hist = pixGetGrayHistogram(pixt, 1);
-        NUMA *hist = pixGetGrayHistogram(pixBigC, 1);
+        NUMA *hist = histBigC;
         assert(NULL != hist);
         assert(256 == numaGetCount(hist));
         int numPels = pixGetWidth(pixt)*pixGetHeight(pixt);
@@ -2010,11 +2712,18 @@ debugstr("croppedWidth = %d, croppedHeight=%d\n", pixGetWidth(pixBigC), pixGetHe
             //l_int32 outerEdge2 = FindOuterEdgeUsingCleanLines(pixt, rotDir, bindingEdge, outerEdge, topEdge, bottomEdge, darkThresh);
             //using the large image works better
             l_int32 outerEdge2 = FindOuterEdgeUsingCleanLines(pixBigT, rotDir, bindingEdge*8, outerEdge*8, topEdge*8, bottomEdge*8, darkThresh);
-            outerEdge2/=8;
-            debugstr("outerEdge = %d, outerEdge2 = %d\n", outerEdge, outerEdge2);
-            outerEdge = outerEdge2;
+            if (-1 == outerEdge2) {
+                debugstr("clean lines search failed\n");
+                error = kLeafErrorNoPage;
+            } else {
+                outerEdge2/=8;
+                debugstr("outerEdge = %d, outerEdge2 = %d\n", outerEdge, outerEdge2);
+                outerEdge = outerEdge2;
+            }
         }
+        pixDestroy(&pixt);
     }
+    StatsEnd(kStageOuterEdge, pelsBig);
 
 
     cropT = topEdge*8;
@@ -2034,11 +2743,6 @@ debugstr("croppedWidth = %d, croppedHeight=%d\n", pixGetWidth(pixBigC), pixGetHe
     l_int32 outerCropT = cropT;
     l_int32 outerCropB = cropB;
 
-    PrintKeyValue_int32("OuterCropL", cropL);
-    PrintKeyValue_int32("OuterCropR", cropR);
-    PrintKeyValue_int32("OuterCropT", cropT);
-    PrintKeyValue_int32("OuterCropB", cropB);
-
 
     #ifdef WRITE_DEBUG_IMAGES
     {
@@ -2058,6 +2762,7 @@ debugstr("croppedWidth = %d, croppedHeight=%d\n", pixGetWidth(pixBigC), pixGetHe
     #endif //WRITE_DEBUG_IMAGES
 
     debugstr("finding clean lines...\n");
+    StatsBegin(kStageCleanLines);
     //AdjustCropBox(pixBigT, &cropL, &cropR, &cropT, &cropB, 8*5);
     //AdjustCropBoxByVariance(pixBigT, &cropL, &cropR, &cropT, &cropB, 3, angle);
 
@@ -2108,18 +2813,17 @@ debugstr("croppedWidth = %d, croppedHeight=%d\n", pixGetWidth(pixBigC), pixGetHe
     //PIX *pixTmp = pixThresholdToBinary (pixBigT, threshBinding);
     //pixWrite(DEBUG_IMAGE_DIR "outbin.png", pixTmp, IFF_PNG);
 
+    StatsEnd(kStageCleanLines, pelsBig);
     debugstr("adjusted: cL=%d, cR=%d, cT=%d, cB=%d\n", cropL, cropR, cropT, cropB);
 
-    printf("angle: %.2f\n", angle);
-    printf("conf: %.2f\n", conf); //TODO: this is the text deskew angle, but what if we are deskewing using the binding mode?
-    PrintKeyValue_int32("CleanCropL", cropL);
-    PrintKeyValue_int32("CleanCropR", cropR);
-    PrintKeyValue_int32("CleanCropT", cropT);
-    PrintKeyValue_int32("CleanCropB", cropB);
-
     debugstr("finding inner crop box (text block)...\n");
     l_int32 innerCropT, innerCropB, innerCropL, innerCropR;
-    FindInnerCrop(pixBigT, threshBinding, cropL, cropR, cropT, cropB, &innerCropL, &innerCropR, &innerCropT, &innerCropB);
+    StatsBegin(kStageInnerCrop);
+    if (FindInnerCrop(pixBigT, threshBinding, cropL, cropR, cropT, cropB, &innerCropL, &innerCropR, &innerCropT, &innerCropB)) {
+        debugstr("no page left inside the clean crop\n");
+        error = kLeafErrorNoPage;
+    }
+    StatsEnd(kStageInnerCrop, (size_t)(cropR-cropL) * (cropB-cropT));
 
 
     #ifdef WRITE_DEBUG_IMAGES
@@ -2165,8 +2869,937 @@ debugstr("croppedWidth = %d, croppedHeight=%d\n", pixGetWidth(pixBigC), pixGetHe
     }
     #endif
 
-    /// cleanup
-    pixDestroy(&pixg);
-    pixDestroy(&pixs);
+    /// cleanup; the full-size images go back to the pool in batch mode
+    numaDestroy(&histBigC);
+    pixDestroy(&pixBigT);
+    pixDestroy(&pixBigB);
+    pixDestroy(&pixBigR);
+
+    if (kLeafOK != error) {
+        /// fall back to the proxy edges, as the proxy phase does
+        StatsPrintLeaf();
+        error = LeafFallback(filein, &leaf->jpeg, rotDir, error, grayChannel,
+                             topEdge, bottomEdge, bindingEdge, leaf->outerEdge, crops);
+        LeafFree(leaf);
+        return error;
+    }
+
+    LEAFCROPS c;
+    memset(&c, 0, sizeof(c));
+    c.rotDir = rotDir;
+    c.w      = w;
+    c.h      = h;
+    c.outerL = outerCropL;
+    c.outerR = outerCropR;
+    c.outerT = outerCropT;
+    c.outerB = outerCropB;
+    c.cleanL = cropL;
+    c.cleanR = cropR;
+    c.cleanT = cropT;
+    c.cleanB = cropB;
+    c.innerL = innerCropL;
+    c.innerR = innerCropR;
+    c.innerT = innerCropT;
+    c.innerB = innerCropB;
+    c.angle  = angle;
+    c.conf   = conf; //TODO: this is the text deskew angle, but what if we are deskewing using the binding mode?
+    c.bindingAngle = deltaBinding;
+    c.skewMode     = skewMode;
+    c.grayChannel  = grayChannel;
+    c.error        = kLeafOK;
+
+    LeafCropsPrintCrops(&c);
+    StatsPrintLeaf();
+    if (NULL != crops) *crops = c;
+    LeafFree(leaf);
+    return kLeafOK;
+}
+
+
+/// AutoCropScribeLeafWithPrior()
+/// AutoCropScribeLeaf(), starting the proxy edge searches from where the
+/// previous leaf of the same hand found its edges. prior may be NULL. A prior
+/// from a proxy of another size is not used. After the leaf, prior holds its
+/// edges, for the next leaf. If crops is not NULL, the crop boxes printed are
+/// also returned in it, fallback crops included. decoded, from
+/// AutoCropScribeDecode(), may be NULL; its images are used or freed.
+///____________________________________________________________________________
+l_int32 AutoCropScribeLeafWithPrior(const char *filein, l_int32 rotDir, SCRIBEPRIOR *prior, SCRIBEDECODED *decoded, LEAFCROPS *crops) {
+    SCRIBELEAF leaf;
+    l_int32    ret = LeafProxy(filein, rotDir, prior, decoded, &leaf, crops);
+    DecodedFree(decoded);
+    if (kLeafOK != ret) {
+        LeafFree(&leaf);
+        return ret;
+    }
+    return AutoCropScribeLeafRefine(&leaf, crops);
+}
+
+
+/// AutoCropScribeLeafProxy()
+/// The first phase of AutoCropScribeLeafWithPrior(): decode the proxy and find
+/// the edges of the page on it. If it returns kLeafOK, leaf holds them for
+/// AutoCropScribeLeafRefine() or AutoCropScribeLeafRefineAsync(), one of which
+/// must be called to free it, and preliminary (if not NULL) holds the crop
+/// from the proxy edges alone, as --mode=realtime has it. Otherwise there is
+/// nothing to refine, and preliminary holds the fallback crop from
+/// kLeafErrorFirstFallback on. decoded is as for AutoCropScribeLeafWithPrior().
+///____________________________________________________________________________
+l_int32 AutoCropScribeLeafProxy(const char *filein, l_int32 rotDir, SCRIBEPRIOR *prior, SCRIBEDECODED *decoded, SCRIBELEAF *leaf, LEAFCROPS *preliminary) {
+    l_int32 ret = LeafProxy(filein, rotDir, prior, decoded, leaf, preliminary);
+    DecodedFree(decoded);
+    if (kLeafOK != ret) LeafFree(leaf);
+    if ((kLeafOK == ret) && (NULL != preliminary)
+        && ProxyCrops(filein, &leaf->jpeg, rotDir, leaf->grayChannel, leaf->topEdge, leaf->bottomEdge,
+                      leaf->bindingEdge, leaf->outerEdge, leaf->deltaBinding, preliminary)) {
+        /// the jpeg went away after its proxy was decoded
+        LeafFree(leaf);
+        printf("leafError: %s\n", LeafErrorName(kLeafErrorUnreadable));
+        return kLeafErrorUnreadable;
+    }
+    return ret;
+}
+
+
+/// LeafRefineThread()
+///____________________________________________________________________________
+static void *LeafRefineThread(void *arg) {
+    SCRIBELEAF *leaf = (SCRIBELEAF *)arg;
+    leaf->error = AutoCropScribeLeafRefine(leaf, &leaf->crops);
+    if (NULL != leaf->done) {
+        l_int32 hasCrops = (kLeafOK == leaf->error) || (leaf->error >= kLeafErrorFirstFallback);
+        leaf->done(leaf, leaf->error, hasCrops ? &leaf->crops : NULL, leaf->doneArg);
+    }
+    return NULL;
+}
+
+
+/// AutoCropScribeLeafRefineAsync()
+/// AutoCropScribeLeafRefine() on a thread of its own, which calls done (if not
+/// NULL) with arg as it finishes. leaf must stay put until
+/// AutoCropScribeLeafWait(), which must be called once for each leaf started.
+/// The refinement prints its lines on that thread, so lines printed meanwhile
+/// may come between them. The buffer pool may be on, as it is locked, but as
+/// for any threads --stats must be off: its counters are not. If no thread
+/// can be started, the leaf is refined before this returns, and 1 is
+/// returned.
+///____________________________________________________________________________
+l_int32 AutoCropScribeLeafRefineAsync(SCRIBELEAF *leaf, SCRIBELEAFDONE done, void *arg) {
+    static char  procName[] = "AutoCropScribeLeafRefineAsync";
+
+    leaf->done     = done;
+    leaf->doneArg  = arg;
+    leaf->threaded = (0 == pthread_create(&leaf->thread, NULL, LeafRefineThread, leaf));
+    if (!leaf->threaded) {
+        L_WARNING("no thread; refining now", procName);
+        LeafRefineThread(leaf);
+        return 1;
+    }
+    return 0;
+}
+
+
+/// AutoCropScribeLeafWait()
+/// Wait for AutoCropScribeLeafRefineAsync() to finish. Returns what
+/// AutoCropScribeLeafRefine() did, with its crops in crops if not NULL.
+///____________________________________________________________________________
+l_int32 AutoCropScribeLeafWait(SCRIBELEAF *leaf, LEAFCROPS *crops) {
+    if (leaf->threaded) {
+        pthread_join(leaf->thread, NULL);
+        leaf->threaded = 0;
+    }
+    if (NULL != crops) *crops = leaf->crops;
+    return leaf->error;
+}
+
+
+/// AutoCropScribeLeafRealtime()
+/// A quick crop of one leaf from its proxy alone, for feedback while the
+/// book is being shot: the outer crop box and binding angle, within about
+/// budgetMs milliseconds of the proxy being decoded. The decode is not part
+/// of the budget, since it does not depend on the searches and would
+/// otherwise leave no time for the binding sweep. The binding sweep stops at
+/// the budget with the best angle so far; the other proxy searches always
+/// run. The full size decode and everything after it are skipped, so the
+/// clean crop is the outer crop, the angle is the binding angle, and there is
+/// no inner crop. Prints what was skipped and the time taken. overBudget, if
+/// not NULL, is set to 1 if the sweep left angles untried or the searches
+/// took longer than the budget, and 0 if not; it is also printed. Returns as
+/// AutoCropScribeLeafWithPrior() does.
+///____________________________________________________________________________
+l_int32 AutoCropScribeLeafRealtime(const char *filein, l_int32 rotDir, double budgetMs, LEAFCROPS *crops, l_int32 *overBudget) {
+    PIX         *pixd, *pixg;
+    static char  procName[] = "AutoCropScribeLeafRealtime";
+
+    double start = MonotonicSeconds();
+    if (NULL != overBudget) *overBudget = 0;
+
+    StatsLeafBegin();
+    printf("mode: realtime\n");
+
+    if ((1 != rotDir) && (-1 != rotDir)) {
+        L_ERROR_INT("rotateDirection %d is not 1 or -1", procName, rotDir);
+        printf("leafError: %s\n", LeafErrorName(kLeafErrorRotDir));
+        return kLeafErrorRotDir;
+    }
+
+    StatsBegin(kStageDecode);
+    if ((pixd = ReadJpegRotated(filein, 8, rotDir, kJpegKeepColor)) == NULL) {
+        return LeafUnreadable(kStageDecode, "pixd not made", procName);
+    }
+    size_t pelsSmall = (size_t)pixGetWidth(pixd) * pixGetHeight(pixd);
+    StatsEnd(kStageDecode, pelsSmall);
+
+    double decoded  = MonotonicSeconds();
+    double deadline = decoded + budgetMs / 1000.0;
+
+    l_int32 grayChannel;
+    StatsBegin(kStageGray);
+    pixg = ConvertToGray(pixd, &grayChannel);
+    StatsEnd(kStageGray, pelsSmall);
     pixDestroy(&pixd);
+
+    if ((pixGetWidth(pixg) < kLeafMinProxySize) || (pixGetHeight(pixg) < kLeafMinProxySize)) {
+        pixDestroy(&pixg);
+        StatsPrintLeaf();
+        return LeafFallback(filein, NULL, rotDir, kLeafErrorTooSmall, grayChannel, -1, -1, -1, -1, crops);
+    }
+
+    l_int32 histmax;
+    StatsBegin(kStageThreshold);
+    l_int32 threshInitial = CalculateTreshInitial(pixg, &histmax);
+    StatsEnd(kStageThreshold, pelsSmall);
+
+    StatsBegin(kStageBackground);
+    l_int32 topEdge    = RemoveBackgroundTop(pixg, rotDir, threshInitial);
+    l_int32 bottomEdge = RemoveBackgroundBottom(pixg, rotDir, threshInitial);
+    StatsEnd(kStageBackground, pelsSmall);
+    if (bottomEdge - topEdge < kLeafMinPageSize) {
+        pixDestroy(&pixg);
+        StatsPrintLeaf();
+        return LeafFallback(filein, NULL, rotDir, kLeafErrorNoPage, grayChannel, -1, -1, -1, -1, crops);
+    }
+
+    /// the same kernel rows as FindBindingEdge3()
+    l_uint32 jTop = 0;
+    l_uint32 jBot = pixGetHeight(pixg) - 1;
+
+    StatsBegin(kStageBinding);
+    l_int32    strongEdge;
+    l_uint32   strongEdgeDiff;
+    float      deltaBinding;
+    l_uint32   threshBinding;
+    l_int32    numAnglesSkipped = SweepBindingEdgeBudget(pixg, rotDir, jTop, jBot, deadline,
+                                                         &strongEdge, &strongEdgeDiff, &deltaBinding);
+    l_int32    bindingEdge = -1;
+    if (-1 != strongEdge) {
+        printf("BEST: delta=%f, strongest edge of gutter is at i=%d with diff=%d\n", deltaBinding, strongEdge, strongEdgeDiff);
+        bindingEdge = BindingFromStrongEdge(pixg, rotDir, jTop, jBot, strongEdge, deltaBinding, &threshBinding);
+    }
+    StatsEnd(kStageBinding, pelsSmall);
+
+    StatsBegin(kStageBackground);
+    l_int32 outerEdge = RemoveBackgroundOuter(pixg, rotDir, topEdge, bottomEdge, threshInitial);
+    StatsEnd(kStageBackground, pelsSmall);
+    pixDestroy(&pixg);
+
+    if ((-1 == bindingEdge) || (rotDir * (outerEdge - bindingEdge) < kLeafMinPageSize)) {
+        l_int32 error = (-1 == bindingEdge) ? kLeafErrorNoBinding : kLeafErrorNoPage;
+        StatsPrintLeaf();
+        return LeafFallback(filein, NULL, rotDir, error, grayChannel, topEdge, bottomEdge, -1, outerEdge, crops);
+    }
+
+    LEAFCROPS c;
+    if (ProxyCrops(filein, NULL, rotDir, grayChannel, topEdge, bottomEdge, bindingEdge, outerEdge, deltaBinding, &c)) {
+        StatsPrintLeaf();
+        printf("leafError: %s\n", LeafErrorName(kLeafErrorUnreadable));
+        return kLeafErrorUnreadable;
+    }
+
+    double  end  = MonotonicSeconds();
+    l_int32 over = (numAnglesSkipped > 0) || (end > deadline);
+
+    LeafCropsPrintCrops(&c);
+    printf("skipped: decodeBig binarize skew rotate outerEdge cleanLines innerCrop\n");
+    printf("bindingAnglesSkipped: %d\n", numAnglesSkipped);
+    printf("decodeMs: %.1f\n", (decoded - start) * 1000.0);
+    printf("realtimeMs: %.1f\n", (end - decoded) * 1000.0);
+    printf("budgetMs: %.1f\n", budgetMs);
+    printf("overBudget: %d\n", over);
+    StatsPrintLeaf();
+
+    if (NULL != crops) *crops = c;
+    if (NULL != overBudget) *overBudget = over;
+    return kLeafOK;
+}
+
+
+#ifndef AUTOCROP_SCRIBE_NO_MAIN
+
+/// Written to bookData/autoCropVersion, and the key of every cached result:
+/// bump it with any change to the crops a leaf gets, or its cached results
+/// and errors would be used by the new build.
+#define kAutoCropVersion     "0.1"
+#define kScandataCacheSuffix ".autocrop-cache" //scandata.xml's cache, unless --cache
+#define kRealtimeBudgetMs    50                //--mode=realtime without --budget
+#define kPipelineAhead       2                 //leaves decoded ahead per --pipeline decode thread
+
+/// CacheParams()
+/// What the results of a leaf depend on besides its jpeg: results cached
+/// with other params are not used.
+///____________________________________________________________________________
+static void CacheParams(char *buf, size_t size, l_int32 usePriors) {
+    snprintf(buf, size, "%s/p%d", kAutoCropVersion, usePriors);
+}
+
+
+/// RunLeafProgressive()
+/// AutoCropScribeLeafWithPrior(), printing the crop from the proxy edges as
+/// soon as they are found, after a "phase: proxy" line, and flushing stdout,
+/// so that a reader of a pipe has it before the full size image is decoded.
+/// The refined crop follows a "phase: refine" line.
+///____________________________________________________________________________
+static l_int32 RunLeafProgressive(const char *filein, l_int32 rotDir, SCRIBEPRIOR *prior, SCRIBEDECODED *decoded, LEAFCROPS *crops) {
+    SCRIBELEAF leaf;
+    LEAFCROPS  preliminary;
+    l_int32    ret = AutoCropScribeLeafProxy(filein, rotDir, prior, decoded, &leaf, &preliminary);
+    if (kLeafOK != ret) {
+        if (ret >= kLeafErrorFirstFallback) *crops = preliminary;
+        return ret;
+    }
+    printf("phase: proxy\n");
+    LeafCropsPrintCrops(&preliminary);
+    printf("phase: refine\n");
+    fflush(stdout);
+    return AutoCropScribeLeafRefine(&leaf, crops);
+}
+
+
+/// RunLeaf()
+/// Crop a leaf, or if cache is not NULL and has the leaf unchanged, print
+/// its results again without reading the jpeg. A leaf that fails is recorded
+/// in the cache with its error, except an unreadable jpeg, which is cropped
+/// again by the next run. With useProgressive, the crop from the proxy
+/// is printed first (RunLeafProgressive()). decoded is the leaf's images from
+/// AutoCropScribeDecode(), or NULL; they are used or freed. Returns kLeafOK,
+/// or the leaf's kLeafError*, with a fallback crop in crops from
+/// kLeafErrorFirstFallback on.
+///____________________________________________________________________________
+static l_int32 RunLeaf(const char *filein, l_int32 rotDir, SCRIBEPRIOR *prior, LEAFCACHE *cache, l_int32 useProgressive, SCRIBEDECODED *decoded, LEAFCROPS *crops) {
+    if (NULL != cache) {
+        const char *error;
+        l_int32     found = LeafCacheLookup(cache, filein, rotDir, crops, &error);
+        if (kLeafCacheMiss != found) {
+            printf("cache: %s\n", (kLeafCacheHit == found) ? "hit" : "failed");
+            /// the cache has no proxy edges, so the next search is a full one
+            if (NULL != prior) prior->valid = 0;
+            DecodedFree(decoded);
+        }
+        if (kLeafCacheHit == found) {
+            LeafCropsPrint(crops);
+            if (kLeafOK != crops->error) printf("leafError: %s\n", LeafErrorName(crops->error));
+            return crops->error;
+        }
+        if (kLeafCacheFailed == found) {
+            printf("leafError: %s\n", error);
+            return LeafErrorFromName(error);
+        }
+        LeafCacheBegin(cache, filein, rotDir);
+    }
+
+    l_int32 ret = useProgressive ? RunLeafProgressive(filein, rotDir, prior, decoded, crops)
+                                 : AutoCropScribeLeafWithPrior(filein, rotDir, prior, decoded, crops);
+    if (NULL != cache) {
+        if (kLeafErrorUnreadable == ret) {
+            /// the jpeg may still have been being copied, or the read failed for want of memory
+            LeafCacheRetry(cache, filein, rotDir);
+        } else if ((kLeafOK != ret) && (ret < kLeafErrorFirstFallback)) {
+            LeafCacheStoreFailed(cache, filein, rotDir, LeafErrorName(ret));
+        } else {
+            LeafCacheStore(cache, filein, rotDir, crops);
+        }
+    }
+    return ret;
+}
+
+
+/// PrintCacheSummary()
+///____________________________________________________________________________
+static void PrintCacheSummary(const LEAFCACHE *cache) {
+    if (NULL == cache) return;
+    printf("cache: %d hits, %d misses, %d failed before\n", cache->numHits, cache->numMisses, cache->numFailed);
+}
+
+
+/// A line of a batch list, and what the --pipeline stages did for it ahead
+/// of the leaf being cropped.
+typedef struct BatchLeaf {
+    char          *filein;    //the line, cut before its rotateDirection
+    l_int32        rotDir;
+    l_int32        valid;     //0 if the line had no rotateDirection
+    l_int32        cached;    //the cache has it, so it is not read or decoded
+    SCRIBEDECODED  decoded;
+} BATCHLEAF;
+
+
+/// BatchReadList()
+/// The non-blank lines of listfile, filename then rotateDirection. Returns
+/// the number of lines, or -1 if listfile cannot be read.
+///____________________________________________________________________________
+static l_int32 BatchReadList(const char *listfile, BATCHLEAF **leaves) {
+    FILE *fp = fopen(listfile, "r");
+    if (NULL == fp) return -1;
+
+    char       line[4096];
+    l_int32    n = 0, maxLeaves = 256;
+    BATCHLEAF *b = (BATCHLEAF *)CALLOC(maxLeaves, sizeof(BATCHLEAF));
+    while (NULL != fgets(line, sizeof(line), fp)) {
+        /// the filename may contain spaces, so the direction is the last token
+        char *end = line + strlen(line);
+        while ((end > line) && isspace((unsigned char)end[-1])) *--end = '\0';
+        if (end == line) continue;
+        if (n == maxLeaves) {
+            b = (BATCHLEAF *)realloc(b, 2 * maxLeaves * sizeof(BATCHLEAF));
+            memset(b + maxLeaves, 0, maxLeaves * sizeof(BATCHLEAF));
+            maxLeaves *= 2;
+        }
+        char *sep = strrchr(line, ' ');
+        if (NULL != sep) {
+            *sep = '\0';
+            b[n].rotDir = atoi(sep + 1);
+            b[n].valid  = 1;
+        }
+        b[n].filein = stringNew(line);
+        n++;
+    }
+    fclose(fp);
+    *leaves = b;
+    return n;
+}
+
+
+/// BatchReadStage()
+/// The first --pipeline stage: read the jpeg into memory, so that the decode
+/// stage does not wait on the disk or the network. The leaf decodes from the
+/// same buffer, and does not read the file again.
+///____________________________________________________________________________
+static void BatchReadStage(void *item, void *arg) {
+    BATCHLEAF *b = (BATCHLEAF *)item;
+    if (!b->valid || b->cached) return;
+    JpegFileRead(&b->decoded.jpeg, b->filein);  //if it fails, the leaf reports it
+}
+
+
+/// BatchDecodeStage()
+/// The second --pipeline stage: decode the proxy and the full size image.
+///____________________________________________________________________________
+static void BatchDecodeStage(void *item, void *arg) {
+    BATCHLEAF *b = (BATCHLEAF *)item;
+    if (!b->valid || b->cached) return;
+    AutoCropScribeDecode(b->filein, b->rotDir, &b->decoded);
 }
+
+
+/// AutoCropScribeBatch()
+/// Run AutoCropScribeLeaf() on every line of listfile, each of which is a jpeg
+/// filename followed by its rotateDirection. A "file:" line comes before the
+/// output of each leaf. PIX data goes through the buffer pool, so leaves after
+/// the first reuse the large buffers instead of allocating them again.
+/// With usePriors, each leaf's edge searches start from the edges of the
+/// previous leaf with the same rotateDirection. Leaves should then be listed
+/// in capture order. With useBook, the crop boxes of every leaf are fit to
+/// the book's page size after the last leaf (autoCropBook.c), and printed as
+/// "cropBox n:" lines, n counting the leaves from 0. With cache, leaves whose
+/// jpeg has not changed since they were cached are not cropped again. With
+/// useProgressive, each leaf prints its crop from the proxy first.
+/// With numDecoders > 0, the leaves ahead of the one being cropped are read
+/// on numReaders threads and decoded on numDecoders threads, at most
+/// kPipelineAhead leaves per decode thread ahead (autoCropPipeline.c). The
+/// leaves are still cropped and printed one at a time, in list order, so the
+/// output is the same. Returns the number of leaves that failed.
+///____________________________________________________________________________
+static l_int32 AutoCropScribeBatch(const char *listfile, l_int32 usePriors, l_int32 useBook, l_int32 useProgressive,
+                                   l_int32 numReaders, l_int32 numDecoders, LEAFCACHE *cache) {
+    static char procName[] = "AutoCropScribeBatch";
+
+    PixPoolInstall((size_t)kPixPoolDefaultCacheMB << 20);
+
+    BATCHLEAF *leaves;
+    l_int32    numLines = BatchReadList(listfile, &leaves);
+    if (numLines < 0) {
+        return ERROR_INT("listfile not found", procName, 1);
+    }
+
+    l_int32  i;
+    PIPELINE pipeline;
+    l_int32  usePipeline = (numDecoders > 0) && (numLines > 0);
+    if (usePipeline) {
+        void **items = (void **)CALLOC(numLines, sizeof(void *));
+        for (i=0; i<numLines; i++) {
+            items[i] = &leaves[i];
+            if ((NULL != cache) && leaves[i].valid) {
+                leaves[i].cached = LeafCacheHas(cache, leaves[i].filein, leaves[i].rotDir);
+            }
+        }
+        PipelineInit(&pipeline, items, numLines, kPipelineAhead * numDecoders);
+        if (numReaders > 0) PipelineAddStage(&pipeline, BatchReadStage, NULL, numReaders);
+        PipelineAddStage(&pipeline, BatchDecodeStage, NULL, numDecoders);
+        if (PipelineStart(&pipeline)) {
+            /// crop the leaves here, decoding them as they come
+            PipelineDestroy(&pipeline);
+            FREE(items);
+            usePipeline = 0;
+        }
+    }
+
+    l_int32     numLeaves = 0, numFailed = 0;
+    SCRIBEPRIOR priors[2];  //right-hand leaves, then left-hand
+    memset(priors, 0, sizeof(priors));
+    BOOKSTATS   book;
+    BookInit(&book);
+    for (i=0; i<numLines; i++) {
+        BATCHLEAF *b = usePipeline ? (BATCHLEAF *)PipelineNext(&pipeline) : &leaves[i];
+        if (!b->valid) {
+            L_WARNING_STRING("no rotateDirection on line: %s", procName, b->filein);
+            numFailed++;
+            continue;
+        }
+        l_int32 rotDir = b->rotDir;
+
+        PrintKeyValue_str("file", b->filein);
+        SCRIBEPRIOR *prior = NULL;
+        if (usePriors && ((1 == rotDir) || (-1 == rotDir))) {
+            prior = &priors[(1 == rotDir) ? 0 : 1];
+        }
+        LEAFCROPS crops;
+        l_int32   ret = RunLeaf(b->filein, rotDir, prior, cache, useProgressive, usePipeline ? &b->decoded : NULL, &crops);
+        if (kLeafOK != ret) {
+            numFailed++;
+            if (NULL != prior) prior->valid = 0;
+        }
+        if (useBook && ((kLeafOK == ret) || (ret >= kLeafErrorFirstFallback))) {
+            BookAddLeaf(&book, numLeaves, &crops);
+        }
+        numLeaves++;
+    }
+
+    if (usePipeline) {
+        void **items = pipeline.items;
+        PipelineDestroy(&pipeline);
+        FREE(items);
+    }
+    for (i=0; i<numLines; i++) {
+        DecodedFree(&leaves[i].decoded);
+        FREE(leaves[i].filein);
+    }
+    FREE(leaves);
+
+    if (usePriors) {
+        printf("priors background: %d used, %d fell back\n",
+               priors[0].numUsed[kPriorSearchBackground] + priors[1].numUsed[kPriorSearchBackground],
+               priors[0].numFallback[kPriorSearchBackground] + priors[1].numFallback[kPriorSearchBackground]);
+        printf("priors binding: %d used, %d fell back\n",
+               priors[0].numUsed[kPriorSearchBinding] + priors[1].numUsed[kPriorSearchBinding],
+               priors[0].numFallback[kPriorSearchBinding] + priors[1].numFallback[kPriorSearchBinding]);
+    }
+
+    PIXPOOLSTATS stats;
+    PixPoolGetStats(&stats);
+    printf("batch: %d leaves, %d failed, %d large allocations, %d reused\n",
+           numLeaves, numFailed, stats.largeAllocs, stats.reused);
+    PrintCacheSummary(cache);
+    StatsPrintBatch();
+    BookFit(&book);
+    BookPrintCrops(&book);
+    BookDestroy(&book);
+    PixPoolRelease();
+
+    return numFailed;
+}
+
+
+/// A run of autoCropScribe over a scandata.xml.
+typedef struct ScandataRun {
+    const char   *jpgDir;
+    l_int32       usePriors;
+    LEAFCACHE    *cache;      //or NULL
+    SCRIBEPRIOR   priors[2];  //right-hand leaves, then left-hand
+    BOOKSTATS     book;
+    l_int32       numLeaves, numFailed;
+    NUMA         *failed;     //leafNums of the leaves with no crops in the book
+    l_int32       next;       //the leaf of the book the writer expects next
+} SCANDATARUN;
+
+
+/// ScandataLeaf()
+/// Crop the leaf of one page of scandata.xml as soon as the page is read.
+/// Pages that are not Scribe leaves are skipped, as processScribe.py did.
+///____________________________________________________________________________
+static l_int32 ScandataLeaf(const char *bookId, const SCANPAGE *page, void *arg) {
+    static char  procName[] = "ScandataLeaf";
+    SCANDATARUN *run = (SCANDATARUN *)arg;
+
+    if ((0 == strcmp(page->pageType, "Delete")) || (0 == strcmp(page->pageType, "Color Card"))
+        || (0 == strcmp(page->pageType, "White Card")) || (0 == strcmp(page->pageType, "Foldout"))) {
+        return 0;
+    }
+
+    l_int32 rotDir;
+    if (90 == page->rotateDegree) {
+        rotDir = 1;
+    } else if (-90 == page->rotateDegree) {
+        rotDir = -1;
+    } else {
+        L_WARNING_INT("leaf %d has no rotateDegree of 90 or -90", procName, page->leafNum);
+        run->numFailed++;
+        numaAddNumber(run->failed, page->leafNum);
+        return 0;
+    }
+
+    char filein[4096];
+    snprintf(filein, sizeof(filein), "%s/%s_orig_%04d.JPG", run->jpgDir, bookId, page->leafNum);
+    if (0 != access(filein, R_OK)) {
+        snprintf(filein, sizeof(filein), "%s/%s_orig_%04d.jpg", run->jpgDir, bookId, page->leafNum);
+    }
+
+    PrintKeyValue_str("file", filein);
+    SCRIBEPRIOR *prior = run->usePriors ? &run->priors[(1 == rotDir) ? 0 : 1] : NULL;
+    LEAFCROPS    crops;
+    l_int32      ret = RunLeaf(filein, rotDir, prior, run->cache, 0, NULL, &crops);
+    if (kLeafOK != ret) {
+        run->numFailed++;
+        if (NULL != prior) prior->valid = 0;
+    }
+    if ((kLeafOK == ret) || (ret >= kLeafErrorFirstFallback)) {
+        BookAddLeaf(&run->book, page->leafNum, &crops);
+    } else {
+        numaAddNumber(run->failed, page->leafNum);
+    }
+    run->numLeaves++;
+    return 0;
+}
+
+
+/// FormatPyFloat()
+/// Format v to two places as processScribe.py wrote it back, with str() of
+/// the float it parsed: without trailing zeros, but with one decimal place.
+///____________________________________________________________________________
+static void FormatPyFloat(char *buf, size_t size, double v) {
+    snprintf(buf, size, "%.2f", v);
+    size_t n = strlen(buf);
+    while ((n > 2) && ('0' == buf[n-1]) && ('.' != buf[n-2])) buf[--n] = '\0';
+}
+
+
+/// ScandataLeafFailed()
+/// Whether the leaf of page was cropped but failed with no crops at all.
+///____________________________________________________________________________
+static l_int32 ScandataLeafFailed(SCANDATARUN *run, const SCANPAGE *page) {
+    l_int32 i, leafNum;
+    for (i=0; i<numaGetCount(run->failed); i++) {
+        numaGetIValue(run->failed, i, &leafNum);
+        if (leafNum == page->leafNum) return 1;
+    }
+    return 0;
+}
+
+
+/// ScandataLeafCrops()
+/// Write the crop boxes and skew of a leaf into its page, in the elements
+/// processScribe.py used. A leaf that failed with no crops at all, such as
+/// one whose jpeg could not be read, has the elements of any earlier run
+/// dropped and only <skewActive>false</skewActive> written, so that stale
+/// crops are not taken for this run's. Pages that were skipped, such as
+/// Color Cards, are left as they were.
+///____________________________________________________________________________
+static l_int32 ScandataLeafCrops(FILE *fp, const SCANPAGE *page, const char *indent, void *arg) {
+    SCANDATARUN *run  = (SCANDATARUN *)arg;
+    BOOKSTATS   *book = &run->book;
+
+    /// pages are written in the order they were read
+    l_int32 i = 0, k;
+    for (k=0; k<book->numLeaves; k++) {
+        i = (run->next + k) % book->numLeaves;
+        if (book->index[i] == page->leafNum) break;
+    }
+    if (k == book->numLeaves) {
+        if (!ScandataLeafFailed(run, page)) return 0;
+        if (NULL != fp) ScandataWriteText(fp, indent, "skewActive", "false");
+        return 1;
+    }
+    if (NULL == fp) return 1;
+    run->next = i + 1;
+
+    const LEAFCROPS *c = &book->leaves[i];
+    const BOOKFIT   *f = &book->fits[i];
+
+    /// children are indented two more spaces than their parent
+    char ind1[kScandataMaxText], ind2[kScandataMaxText], text[32];
+    snprintf(ind1, sizeof(ind1), "%s%s", indent, indent[0] ? "  " : "");
+    snprintf(ind2, sizeof(ind2), "%s%s", ind1, indent[0] ? "  " : "");
+
+    ScandataWriteStart(fp, indent, "cropBox");
+    ScandataWriteInt(fp, ind1, "x", f->x);
+    ScandataWriteInt(fp, ind1, "y", f->y);
+    ScandataWriteInt(fp, ind1, "w", f->w);
+    ScandataWriteInt(fp, ind1, "h", f->h);
+    ScandataWriteEnd(fp, indent, "cropBox");
+
+    ScandataWriteStart(fp, indent, "cropBoxAutoDetect");
+    snprintf(text, sizeof(text), "%0.2f", f->score);
+    ScandataWriteText(fp, ind1, "cropScore", text);
+
+    ScandataWriteStart(fp, ind1, "pass2Crop");
+    ScandataWriteInt(fp, ind2, "x", f->x);
+    ScandataWriteInt(fp, ind2, "y", f->y);
+    ScandataWriteInt(fp, ind2, "w", f->w);
+    ScandataWriteInt(fp, ind2, "h", f->h);
+    ScandataWriteEnd(fp, ind1, "pass2Crop");
+
+    ScandataWriteStart(fp, ind1, "cleanCrop");
+    ScandataWriteInt(fp, ind2, "l", c->cleanL);
+    ScandataWriteInt(fp, ind2, "r", c->cleanR);
+    ScandataWriteInt(fp, ind2, "t", c->cleanT);
+    ScandataWriteInt(fp, ind2, "b", c->cleanB);
+    ScandataWriteEnd(fp, ind1, "cleanCrop");
+
+    ScandataWriteStart(fp, ind1, "outerCrop");
+    ScandataWriteInt(fp, ind2, "l", c->outerL);
+    ScandataWriteInt(fp, ind2, "r", c->outerR);
+    ScandataWriteInt(fp, ind2, "t", c->outerT);
+    ScandataWriteInt(fp, ind2, "b", c->outerB);
+    ScandataWriteEnd(fp, ind1, "outerCrop");
+
+    ScandataWriteStart(fp, ind1, "innerCrop");
+    ScandataWriteInt(fp, ind2, "l", c->innerL);
+    ScandataWriteInt(fp, ind2, "r", c->innerR);
+    ScandataWriteInt(fp, ind2, "t", c->innerT);
+    ScandataWriteInt(fp, ind2, "b", c->innerB);
+    ScandataWriteEnd(fp, ind1, "innerCrop");
+    ScandataWriteEnd(fp, indent, "cropBoxAutoDetect");
+
+    /// the skew is set to the detected angle, whatever its score
+    FormatPyFloat(text, sizeof(text), c->angle);
+    ScandataWriteText(fp, indent, "skewAngle", text);
+    ScandataWriteText(fp, indent, "skewAngleDetect", text);
+    FormatPyFloat(text, sizeof(text), c->conf);
+    ScandataWriteText(fp, indent, "skewScore", text);
+    ScandataWriteText(fp, indent, "skewActive", "true");
+    return 1;
+}
+
+
+/// AutoCropScribeScandata()
+/// Crop every Scribe leaf of scandata.xml, whose jpegs are in jpgDir, and
+/// write the crop boxes and skew back into it, as processScribe.py did. The
+/// file is read and written a page at a time, and each leaf is cropped as
+/// soon as its page has been read. Leaves whose jpeg has not changed since
+/// they were cached are not cropped again, so a run that stopped part way is
+/// resumed by running it again. A leaf that fails is marked with skewActive
+/// false and its old crops dropped, and the rest of the book is still written. Returns the number of leaves that failed,
+/// or -1 if scandata.xml could not be read or written.
+///____________________________________________________________________________
+static l_int32 AutoCropScribeScandata(const char *scandata, const char *jpgDir, l_int32 usePriors, LEAFCACHE *cache) {
+    static char procName[] = "AutoCropScribeScandata";
+
+    PixPoolInstall((size_t)kPixPoolDefaultCacheMB << 20);
+
+    SCANDATARUN run;
+    memset(&run, 0, sizeof(run));
+    run.jpgDir    = jpgDir;
+    run.usePriors = usePriors;
+    run.cache     = cache;
+    run.failed    = numaCreate(0);
+    BookInit(&run.book);
+
+    l_int32 ret = ScandataReadPages(scandata, ScandataLeaf, &run);
+    BookFit(&run.book);
+    BookPrintCrops(&run.book);
+    printf("scandata: %d leaves, %d failed\n", run.numLeaves, run.numFailed);
+    PrintCacheSummary(cache);
+    StatsPrintBatch();
+
+    if (0 == ret) {
+        /// write beside the original, and replace it only once complete
+        char fileout[4096];
+        snprintf(fileout, sizeof(fileout), "%s.tmp", scandata);
+        ret = ScandataWrite(scandata, fileout, kAutoCropVersion, ScandataLeafCrops, &run);
+        if ((0 == ret) && (0 != rename(fileout, scandata))) {
+            ret = ERROR_INT("could not replace scandata", procName, 1);
+        }
+    }
+
+    BookDestroy(&run.book);
+    numaDestroy(&run.failed);
+    PixPoolRelease();
+    return ret ? -1 : run.numFailed;
+}
+
+
+#define kLeakCheckWarmupLeaves 2
+#define kLeakCheckSlackKB      1024 //RSS growth allowed after the warmup leaves
+
+/// ResidentKB()
+/// Resident set size of this process, or -1 if /proc is not available.
+///____________________________________________________________________________
+static long ResidentKB() {
+    long size, resident;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (NULL == fp) return -1;
+    l_int32 n = fscanf(fp, "%ld %ld", &size, &resident);
+    fclose(fp);
+    if (2 != n) return -1;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+
+/// AutoCropScribeLeakCheck()
+/// Run AutoCropScribeLeaf() numLeaves times on the same image, as a batch or
+/// server process would, and check after each leaf that every PIX buffer has
+/// been freed and, after the warmup leaves have filled the pool, that the RSS
+/// stays flat. Returns 0 if no leak was found, 1 otherwise.
+///____________________________________________________________________________
+static l_int32 AutoCropScribeLeakCheck(char *filein, l_int32 rotDir, l_int32 numLeaves) {
+    static char procName[] = "AutoCropScribeLeakCheck";
+
+    PixPoolInstall((size_t)kPixPoolDefaultCacheMB << 20);
+
+    PIXPOOLSTATS stats;
+    PixPoolGetStats(&stats);
+    l_int32 liveBefore = stats.liveBuffers;
+    long    rssWarm    = -1;
+    l_int32 leaked     = 0;
+    l_int32 failed     = 0;
+
+    l_int32 i;
+    for (i=0; i<numLeaves; i++) {
+        if (AutoCropScribeLeaf(filein, rotDir)) {
+            L_ERROR("leaf failed", procName);
+            failed = 1;
+            break;
+        }
+
+        PixPoolGetStats(&stats);
+        long rss = ResidentKB();
+        printf("leak-check: leaf %d, %d live PIX buffers, rss %ld kB\n",
+               i, stats.liveBuffers - liveBefore, rss);
+
+        if (stats.liveBuffers != liveBefore) {
+            leaked = 1;
+        }
+        if (kLeakCheckWarmupLeaves - 1 == i) {
+            rssWarm = rss;
+        } else if ((i >= kLeakCheckWarmupLeaves) && (-1 != rss) && (rss > rssWarm + kLeakCheckSlackKB)) {
+            leaked = 1;
+        }
+    }
+
+    if (!failed) printf("leak-check: %s\n", leaked ? "LEAK" : "ok");
+    PixPoolRelease();
+    return failed || leaked;
+}
+
+
+/// main()
+///____________________________________________________________________________
+int main(int argc, char **argv) {
+    static char  mainName[] = "autoCropScribe";
+
+    l_int32     useStats = 0, usePriors = 0, useBook = 0, useRealtime = 0, useProgressive = 0;
+    l_int32     numReaders = 0, numDecoders = 0;
+    double      budgetMs = kRealtimeBudgetMs;
+    const char *cacheFile = NULL;
+    for (; argc > 1; argv++, argc--) {
+        if      (0 == strcmp(argv[1], "--stats"))         useStats    = 1;
+        else if (0 == strcmp(argv[1], "--priors"))        usePriors   = 1;
+        else if (0 == strcmp(argv[1], "--book"))          useBook     = 1;
+        else if (0 == strcmp(argv[1], "--mode=realtime")) useRealtime = 1;
+        else if (0 == strcmp(argv[1], "--mode=full"))     useRealtime = 0;
+        else if (0 == strcmp(argv[1], "--progressive"))   useProgressive = 1;
+        else if ((0 == strcmp(argv[1], "--cache")) && (argc > 2)) {
+            cacheFile = argv[2];
+            argv++, argc--;
+        }
+        else if ((0 == strcmp(argv[1], "--budget")) && (argc > 2)) {
+            budgetMs = atof(argv[2]);
+            argv++, argc--;
+        }
+        else if ((0 == strcmp(argv[1], "--pipeline")) && (argc > 2)) {
+            if ((2 != sscanf(argv[2], "%d,%d", &numReaders, &numDecoders)) || (numReaders < 0) || (numDecoders < 1)) {
+                numDecoders = -1;  //a syntax error below
+            }
+            argv++, argc--;
+        }
+        else break;
+    }
+    l_int32 isBatch = (3 == argc) && (0 == strcmp(argv[1], "--batch"));
+    l_int32 usePipeline = (0 != numDecoders);
+
+    if (useStats) {
+        StatsEnable();
+        if ((3 == argc) && !isBatch) {
+            /// count allocations; nothing is cached for a single leaf
+            PixPoolInstall(0);
+        }
+    }
+
+    if (!useStats && !usePriors && !useBook && !useRealtime && !useProgressive && !usePipeline && !cacheFile && (5 == argc) && (0 == strcmp(argv[1], "--leak-check"))) {
+        return AutoCropScribeLeakCheck(argv[3], atoi(argv[4]), atoi(argv[2]));
+    }
+
+    l_int32 isScandata = !useBook && !useRealtime && !useProgressive && !usePipeline && (4 == argc) && (0 == strcmp(argv[1], "--scandata"));
+
+    /// the stats of a leaf are kept in globals, so no other leaf may decode meanwhile
+    l_int32 badPipeline = usePipeline && (!isBatch || useStats || (numDecoders < 1));
+
+    if (!useRealtime && !badPipeline && (isScandata || (isBatch && (NULL != cacheFile)))) {
+        /// scandata.xml's cache is the checkpoint of the book, so it is always kept
+        char defaultCacheFile[4096];
+        if (NULL == cacheFile) {
+            snprintf(defaultCacheFile, sizeof(defaultCacheFile), "%s%s", argv[2], kScandataCacheSuffix);
+            cacheFile = defaultCacheFile;
+        }
+        LEAFCACHE cache;
+        char      params[kLeafCacheMaxParams];
+        CacheParams(params, sizeof(params), usePriors);
+        if (LeafCacheOpen(&cache, cacheFile, params)) {
+            exit(ERROR_INT("could not open cache", mainName, 1));
+        }
+        l_int32 numFailed = isScandata ? AutoCropScribeScandata(argv[2], argv[3], usePriors, &cache)
+                                       : AutoCropScribeBatch(argv[2], usePriors, useBook, useProgressive,
+                                                             numReaders, numDecoders, &cache);
+        LeafCacheClose(&cache);
+        if (isScandata) {
+            return (numFailed < 0) ? 1 : ((numFailed > 0) ? 2 : 0);
+        }
+        return (0 != numFailed);
+    }
+
+    if ((argc != 3) || ((usePriors || useBook || cacheFile) && !isBatch) || badPipeline
+        || (useRealtime && (isBatch || useProgressive || (budgetMs <= 0)))) {
+        exit(ERROR_INT(" Syntax:  autoCrop [--stats] [--progressive] filein.jpg rotateDirection\n"
+                       "          autoCrop [--stats] --mode=realtime [--budget ms] filein.jpg rotateDirection\n"
+                       "          autoCrop [--stats] [--priors] [--book] [--progressive] [--cache cachefile]\n"
+                       "                   [--pipeline readers,decoders] --batch listfile\n"
+                       "          autoCrop [--stats] [--priors] [--cache cachefile] --scandata scandata.xml jpgDir\n"
+                       "          autoCrop --leak-check numLeaves filein.jpg rotateDirection",
+                         mainName, 1));
+    }
+
+    if (isBatch) {
+        return (0 != AutoCropScribeBatch(argv[2], usePriors, useBook, useProgressive, numReaders, numDecoders, NULL));
+    }
+
+    if (useRealtime) {
+        return AutoCropScribeLeafRealtime(argv[1], atoi(argv[2]), budgetMs, NULL, NULL);
+    }
+
+    if (useProgressive) {
+        LEAFCROPS crops;
+        return RunLeaf(argv[1], atoi(argv[2]), NULL, NULL, 1, NULL, &crops);
+    }
+
+    return AutoCropScribeLeaf(argv[1], atoi(argv[2]));
+}
+
+#endif //AUTOCROP_SCRIBE_NO_MAIN
@@ -0,0 +1,97 @@
+#ifndef AUTOCROP_AUTOCROPSCRIBE_H
+#define AUTOCROP_AUTOCROPSCRIBE_H
+
+/// The searches a SCRIBEPRIOR narrows, which it counts separately.
+enum {
+    kPriorSearchBackground = 0,  //the top, bottom and outer edge scans
+    kPriorSearchBinding,         //the binding sweep
+    kNumPriorSearches
+};
+
+/// What a leaf found on its proxy, kept to narrow the searches on the next
+/// leaf of the same hand: the camera, platen and book barely move between
+/// them. valid is 0 until a leaf has filled it in.
+typedef struct ScribePrior {
+    l_int32    valid;
+    l_int32    w, h;                   //proxy size
+    l_int32    topEdge, bottomEdge;    //proxy rows
+    l_int32    outerEdge;              //proxy column
+    l_int32    strongEdge;             //proxy column of the strongest binding edge
+    l_uint32   strongDiff;             //its SAD
+    l_float32  bindingAngle;
+    l_int32    numUsed[kNumPriorSearches];     //searches that used the prior
+    l_int32    numFallback[kNumPriorSearches]; //and that fell back to the full search
+} SCRIBEPRIOR;
+
+/// What AutoCropScribeLeafWithPrior() returns. From kLeafErrorTooSmall on, the
+/// leaf still has a fallback crop: the edges that were found, and the border
+/// of the image for the rest, with no skew.
+enum {
+    kLeafOK = 0,
+    kLeafErrorUnreadable,      //the jpeg could not be decoded
+    kLeafErrorRotDir,          //rotateDirection is not 1 or -1
+    kLeafErrorTooSmall,        //too small to search for edges
+    kLeafErrorNoPage,          //no page between the edges found
+    kLeafErrorNoBinding,       //no binding edge
+    kNumLeafErrors
+};
+#define kLeafErrorFirstFallback kLeafErrorTooSmall
+
+const char *LeafErrorName(l_int32 error);
+l_int32     LeafErrorFromName(const char *name);
+
+/// A leaf's images, decoded ahead by AutoCropScribeDecode(): the proxy in
+/// color, and the full size image in grayChannel, rotated to portrait, and
+/// the jpeg file they came from. Needs autoCropJpeg.h.
+typedef struct ScribeDecoded {
+    JPEGFILE   jpeg;
+    PIX       *pixProxy;
+    PIX       *pixBig;
+    l_int32    grayChannel;
+} SCRIBEDECODED;
+
+struct ScribeLeaf;
+/// Called on the refining thread when AutoCropScribeLeafRefineAsync() is done.
+/// crops is the leaf's result, or NULL if error has no crop.
+typedef void (*SCRIBELEAFDONE)(struct ScribeLeaf *leaf, l_int32 error, const LEAFCROPS *crops, void *arg);
+
+/// A leaf between the two phases of AutoCropScribeLeafWithPrior(): what
+/// AutoCropScribeLeafProxy() found on the proxy, for AutoCropScribeLeafRefine()
+/// to refine on the full size image. Needs pthread.h.
+typedef struct ScribeLeaf {
+    char       *filein;
+    JPEGFILE    jpeg;                   //the file, read once for both decodes
+    l_int32     rotDir;
+    l_int32     grayChannel;
+    l_int32     topEdge, bottomEdge;    //proxy rows
+    l_int32     bindingEdge, outerEdge; //proxy columns
+    l_uint32    threshBinding;
+    float       deltaBinding;
+    PIX        *pixd, *pixg;            //proxy, color and gray
+    PIX        *pixBig;                 //full size gray decoded ahead, or NULL
+    BOX        *box;                    //full size box for the skew search
+    /// AutoCropScribeLeafRefineAsync() only
+    pthread_t       thread;
+    l_int32         threaded;
+    SCRIBELEAFDONE  done;
+    void           *doneArg;
+    l_int32         error;
+    LEAFCROPS       crops;
+} SCRIBELEAF;
+
+//autoCropScribeLeaf.o is autoCropScribe.c built with AUTOCROP_SCRIBE_NO_MAIN,
+//for programs that run the Scribe pipeline themselves
+l_int32 AutoCropScribeLeaf(const char *filein, l_int32 rotDir);
+//LEAFCROPS is in autoCropBook.h
+l_int32 AutoCropScribeLeafWithPrior(const char *filein, l_int32 rotDir, SCRIBEPRIOR *prior, SCRIBEDECODED *decoded, LEAFCROPS *crops);
+l_int32 AutoCropScribeDecode(const char *filein, l_int32 rotDir, SCRIBEDECODED *decoded);
+//the two phases of AutoCropScribeLeafWithPrior(), so a caller can use the
+//proxy crop while the full size image is still being refined
+l_int32 AutoCropScribeLeafProxy(const char *filein, l_int32 rotDir, SCRIBEPRIOR *prior, SCRIBEDECODED *decoded, SCRIBELEAF *leaf, LEAFCROPS *preliminary);
+l_int32 AutoCropScribeLeafRefine(SCRIBELEAF *leaf, LEAFCROPS *crops);
+l_int32 AutoCropScribeLeafRefineAsync(SCRIBELEAF *leaf, SCRIBELEAFDONE done, void *arg);
+l_int32 AutoCropScribeLeafWait(SCRIBELEAF *leaf, LEAFCROPS *crops);
+//proxy only, within about budgetMs after its decode, for feedback at capture time
+l_int32 AutoCropScribeLeafRealtime(const char *filein, l_int32 rotDir, double budgetMs, LEAFCROPS *crops, l_int32 *overBudget);
+
+#endif
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "allheaders.h"
+#include <assert.h>
+#include "autoCropCommon.h"
+#include "autoCropPool.h"
+#include "autoCropStats.h"
+
+/*  Per-stage timing and counters. Off unless StatsEnable() is called, so a
+    StatsBegin()/StatsEnd() pair costs one branch in a normal run.
+
+    Each leaf starts with StatsLeafBegin(). StatsPrintLeaf() prints one line
+    per stage that ran, and adds the leaf into the batch totals and a
+    histogram of per-leaf times, which StatsPrintBatch() prints.
+
+    Times come from the monotonic clock. Allocation bytes are read from the
+    pool, so they are only counted when PixPoolInstall() has been called.
+*/
+
+#define kStatsHistBuckets 16  //bucket k holds leaves that took < 2^k ms
+
+static const char *stageNames[kNumStages] = {
+    "decode",
+    "gray",
+    "threshold",
+    "background",
+    "binding",
+    "bindingSweep",
+    "decodeBig",
+    "binarize",
+    "skew",
+    "rotate",
+    "outerEdge",
+    "cleanLines",
+    "innerCrop",
+};
+
+static l_int32     statsEnabled = 0;
+static STAGESTATS  leafStats[kNumStages];
+static double      startSeconds[kNumStages];
+static size_t      startBytes[kNumStages];
+
+static l_int32     batchLeaves = 0;
+static STAGESTATS  batchStats[kNumStages];
+static l_int32     batchStageLeaves[kNumStages];  //leaves that ran the stage
+static double      batchMin[kNumStages];
+static double      batchMax[kNumStages];
+static l_int32     batchHist[kNumStages][kStatsHistBuckets];
+
+
+/// MonotonicSeconds()
+/// Seconds from an arbitrary start, for timing and deadlines. Works whether or
+/// not stats are enabled.
+///____________________________________________________________________________
+double MonotonicSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/// PoolAllocBytes()
+///____________________________________________________________________________
+static size_t PoolAllocBytes()
+{
+    PIXPOOLSTATS stats;
+    PixPoolGetStats(&stats);
+    return stats.allocBytes;
+}
+
+
+/// StatsEnable()
+///____________________________________________________________________________
+void StatsEnable()
+{
+    statsEnabled = 1;
+}
+
+
+/// StatsLeafBegin()
+/// Clear the counts of the previous leaf.
+///____________________________________________________________________________
+void StatsLeafBegin()
+{
+    if (!statsEnabled) return;
+    memset(leafStats, 0, sizeof(leafStats));
+}
+
+
+/// StatsBegin()
+///____________________________________________________________________________
+void StatsBegin(l_int32 stage)
+{
+    if (!statsEnabled) return;
+    assert((stage >= 0) && (stage < kNumStages));
+    startBytes[stage]   = PoolAllocBytes();
+    startSeconds[stage] = MonotonicSeconds();
+}
+
+
+/// StatsEnd()
+/// Charge the time and allocations since StatsBegin(stage) to the stage, with
+/// the number of pels it worked on.
+///____________________________________________________________________________
+void StatsEnd(l_int32 stage, size_t pels)
+{
+    if (!statsEnabled) return;
+    double now = MonotonicSeconds();
+    assert((stage >= 0) && (stage < kNumStages));
+    leafStats[stage].calls++;
+    leafStats[stage].seconds    += now - startSeconds[stage];
+    leafStats[stage].pels       += pels;
+    leafStats[stage].allocBytes += PoolAllocBytes() - startBytes[stage];
+}
+
+
+/// StatsPrintLeaf()
+/// Print the stages of this leaf and add them to the batch totals.
+///____________________________________________________________________________
+void StatsPrintLeaf()
+{
+    if (!statsEnabled) return;
+
+    l_int32 i;
+    for (i=0; i<kNumStages; i++) {
+        const STAGESTATS *s = &leafStats[i];
+        if (0 == s->calls) continue;
+        printf("stage %s: %d calls, %.4f sec, %lu pels, %lu bytes\n",
+               stageNames[i], s->calls, s->seconds,
+               (unsigned long)s->pels, (unsigned long)s->allocBytes);
+
+        if ((0 == batchStats[i].calls) || (s->seconds < batchMin[i])) batchMin[i] = s->seconds;
+        if ((0 == batchStats[i].calls) || (s->seconds > batchMax[i])) batchMax[i] = s->seconds;
+        batchStats[i].calls      += s->calls;
+        batchStats[i].seconds    += s->seconds;
+        batchStats[i].pels       += s->pels;
+        batchStats[i].allocBytes += s->allocBytes;
+        batchStageLeaves[i]++;
+
+        l_int32 bucket = 0;
+        double  ms     = s->seconds * 1000.0;
+        while ((bucket < kStatsHistBuckets-1) && (ms >= (double)(1 << bucket))) bucket++;
+        batchHist[i][bucket]++;
+    }
+    batchLeaves++;
+}
+
+
+/// StatsPrintBatch()
+/// Print the totals of every leaf so far, and for each stage a histogram of
+/// its time per leaf in power of two milliseconds. The min, mean and max of a
+/// stage are over the leaves that ran it, so the stages after the decode are
+/// not diluted by leaves that could not be read or were cached.
+///____________________________________________________________________________
+void StatsPrintBatch()
+{
+    if (!statsEnabled || (0 == batchLeaves)) return;
+
+    printf("stages over %d leaves:\n", batchLeaves);
+    l_int32 i, k;
+    for (i=0; i<kNumStages; i++) {
+        const STAGESTATS *s = &batchStats[i];
+        if (0 == s->calls) continue;
+        printf("stage %s: %d leaves, %d calls, %.4f sec, min %.4f, mean %.4f, max %.4f per leaf, %lu pels, %lu bytes\n",
+               stageNames[i], batchStageLeaves[i], s->calls, s->seconds,
+               batchMin[i], s->seconds / batchStageLeaves[i], batchMax[i],
+               (unsigned long)s->pels, (unsigned long)s->allocBytes);
+
+        printf("hist %s:", stageNames[i]);
+        for (k=0; k<kStatsHistBuckets; k++) {
+            if (0 == batchHist[i][k]) continue;
+            if (kStatsHistBuckets-1 == k) {
+                printf(" >=%dms %d", 1 << (k-1), batchHist[i][k]);
+            } else {
+                printf(" <%dms %d", 1 << k, batchHist[i][k]);
+            }
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef AUTOCROP_AUTOCROPSTATS_H
+#define AUTOCROP_AUTOCROPSTATS_H
+
+/// Stages of a leaf timed by --stats. Stages may nest: kStageBindingSweep is
+/// one angle of the sweep inside kStageBinding.
+enum {
+    kStageDecode,        //1/8 size proxy jpeg decode
+    kStageGray,          //color proxy to gray
+    kStageThreshold,     //initial threshold from the proxy histogram
+    kStageBackground,    //top, bottom and outer edges on the proxy
+    kStageBinding,       //binding edge and threshold
+    kStageBindingSweep,  //one angle of the binding edge search
+    kStageDecodeBig,     //full size jpeg decode
+    kStageBinarize,      //full size threshold and histogram
+    kStageSkew,          //text skew by projections
+    kStageRotate,        //full size rotate
+    kStageOuterEdge,     //outer edge by clean lines
+    kStageCleanLines,    //remove black pels at the crop edges
+    kStageInnerCrop,     //text block
+    kNumStages
+};
+
+typedef struct StageStats {
+    l_int32  calls;
+    double   seconds;
+    size_t   pels;        //pels of the images the stage worked on
+    size_t   allocBytes;  //PIX data allocated, if the pool is installed
+} STAGESTATS;
+
+double MonotonicSeconds();
+
+void StatsEnable();
+void StatsLeafBegin();
+void StatsBegin(l_int32 stage);
+void StatsEnd(l_int32 stage, size_t pels);
+void StatsPrintLeaf();
+void StatsPrintBatch();
+
+#endif
@@ -27,6 +27,77 @@
 */
 
 
+/// remove_bg_scan_rows()
+/// Scan rows jStart, jStart+step, ... through jEnd, counting black pels in
+/// columns [limitL, limitR]. pixb may be a band of the image whose upper left
+/// corner is at (xOff, yOff); all other arguments are in image coordinates.
+/// Returns the first row with fewer than numBlackRequired black pels, or -1 if
+/// every row scanned is background.
+///____________________________________________________________________________
+static l_int32 remove_bg_scan_rows(PIX *pixb, l_int32 xOff, l_int32 yOff,
+                                   l_int32 limitL, l_int32 limitR,
+                                   l_int32 jStart, l_int32 jEnd, l_int32 step,
+                                   l_uint32 numBlackRequired) {
+
+    assert(pixGetDepth(pixb) == 1);
+    assert((limitL >= xOff) && (limitR < xOff + pixGetWidth(pixb)));
+    assert((min_int32(jStart, jEnd) >= yOff) && (max_int32(jStart, jEnd) < yOff + pixGetHeight(pixb)));
+
+    l_uint32 *data = pixGetData(pixb);
+    l_int32   wpl  = pixGetWpl(pixb);
+    l_int32 i, j;
+
+    for (j=jStart; (step > 0) ? (j <= jEnd) : (j >= jEnd); j+=step) {
+        const l_uint32 *line = data + (j - yOff) * wpl;
+        l_uint32 numBlackPels = 0;
+        for (i=limitL; i<=limitR; i++) {
+            if (PEL_IS_BLACK == GET_DATA_BIT(line, i - xOff)) {
+                numBlackPels++;
+            }
+        }
+        if (numBlackPels<numBlackRequired) {
+            return j;
+        }
+    }
+
+    return -1;
+}
+
+
+/// remove_bg_scan_cols()
+/// Same as remove_bg_scan_rows(), for columns iStart..iEnd counting black pels
+/// in rows [limitT, limitB].
+///____________________________________________________________________________
+static l_int32 remove_bg_scan_cols(PIX *pixb, l_int32 xOff, l_int32 yOff,
+                                   l_int32 limitT, l_int32 limitB,
+                                   l_int32 iStart, l_int32 iEnd, l_int32 step,
+                                   l_uint32 numBlackRequired) {
+
+    assert(pixGetDepth(pixb) == 1);
+    assert((limitT >= yOff) && (limitB < yOff + pixGetHeight(pixb)));
+    assert((min_int32(iStart, iEnd) >= xOff) && (max_int32(iStart, iEnd) < xOff + pixGetWidth(pixb)));
+
+    l_uint32 *data = pixGetData(pixb);
+    l_int32   wpl  = pixGetWpl(pixb);
+    l_int32 i, j;
+
+    for (i=iStart; (step > 0) ? (i <= iEnd) : (i >= iEnd); i+=step) {
+        l_uint32 numBlackPels = 0;
+        const l_uint32 *line = data + (limitT - yOff) * wpl;
+        for (j=limitT; j<=limitB; j++, line+=wpl) {
+            if (PEL_IS_BLACK == GET_DATA_BIT(line, i - xOff)) {
+                numBlackPels++;
+            }
+        }
+        if (numBlackPels<numBlackRequired) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
 /// remove_bg_top()
 ///____________________________________________________________________________
 l_int32 remove_bg_top(PIX *pixb, l_int32 rotDir, float black_pixel_percentage) {
@@ -35,7 +106,6 @@ l_int32 remove_bg_top(PIX *pixb, l_int32 rotDir, float black_pixel_percentage) {
     pixGetDimensions(pixb, &w, &h, &d);
     assert(pixGetDepth(pixb) == 1);
 
-    l_uint32 a;
     l_uint32 limitL, limitR, limitB;
 
     if (1 == rotDir) {
@@ -57,26 +127,9 @@ l_int32 remove_bg_top(PIX *pixb, l_int32 rotDir, float black_pixel_percentage) {
     //number of black pels required for this line to be considered part of the background
     l_uint32 numBlackRequired   = (l_uint32)(black_pixel_percentage*(limitR-limitL));
 
-    l_uint32 i, j;
+    l_int32 j = remove_bg_scan_rows(pixb, 0, 0, limitL, limitR, 0, limitB, 1, numBlackRequired);
 
-    for(j=0; j<=limitB; j++) {
-
-        l_uint32 numBlackPels = 0;
-        for (i=limitL; i<=limitR; i++) {
-            l_int32 retval = pixGetPixel(pixb, i, j, &a);
-            assert(0 == retval);
-            if (PEL_IS_BLACK == a) {
-                numBlackPels++;
-            }
-        }
-        //printf("T %d: numBlack=%d\n", j, numBlackPels);
-        if (numBlackPels<numBlackRequired) {
-            //printf("break at %d!\n", j);
-            return j;
-        }
-    }
-
-    return 0;
+    return (-1 == j) ? 0 : j;
 
 }
 
@@ -89,7 +142,6 @@ l_int32 remove_bg_bottom(PIX *pixb, l_int32 rotDir, float black_pixel_percentage
     pixGetDimensions(pixb, &w, &h, &d);
     assert(pixGetDepth(pixb) == 1);
 
-    l_uint32 a;
     l_int32 limitL, limitR, limitT;
 
     if (1 == rotDir) {
@@ -111,26 +163,9 @@ l_int32 remove_bg_bottom(PIX *pixb, l_int32 rotDir, float black_pixel_percentage
     //number of black pels required for this line to be considered part of the background
     l_uint32 numBlackRequired   = (l_uint32)(black_pixel_percentage*(limitR-limitL));
 
-    l_int32 i, j;
-
-    for(j=h-1; j>=limitT; j--) {
-
-        l_uint32 numBlackPels = 0;
-        for (i=limitL; i<=limitR; i++) {
-            l_int32 retval = pixGetPixel(pixb, i, j, &a);
-            assert(0 == retval);
-            if (PEL_IS_BLACK == a) {
-                numBlackPels++;
-            }
-        }
-        //printf("B %d: numBlack=%d\n", j, numBlackPels);
-        if (numBlackPels<numBlackRequired) {
-            //printf("break!\n");
-            return j;
-        }
-    }
+    l_int32 j = remove_bg_scan_rows(pixb, 0, 0, limitL, limitR, h-1, limitT, -1, numBlackRequired);
 
-    return h-1;
+    return (-1 == j) ? h-1 : j;
 
 }
 
@@ -139,27 +174,9 @@ l_int32 remove_bg_bottom(PIX *pixb, l_int32 rotDir, float black_pixel_percentage
 ///____________________________________________________________________________
 l_int32 remove_bg_outer_L(PIX *pixb, l_int32 iStart, l_int32 iEnd, l_int32 limitT, l_int32 limitB, l_uint32 numBlackRequired) {
 
-    l_uint32 a;
-    l_int32 i, j;
+    l_int32 i = remove_bg_scan_cols(pixb, 0, 0, limitT, limitB, iStart, iEnd, 1, numBlackRequired);
 
-    for(i=iStart; i<=iEnd; i++) {
-
-        l_uint32 numBlackPels = 0;
-        for (j=limitT; j<=limitB; j++) {
-            l_int32 retval = pixGetPixel(pixb, i, j, &a);
-            assert(0 == retval);
-            if (PEL_IS_BLACK == a) {
-                numBlackPels++;
-            }
-        }
-        //debugstr("O %d: numBlack=%d\n", i, numBlackPels);
-        if (numBlackPels<numBlackRequired) {
-            //debugstr("remove_bg_outer_L break! (thresh=%d)\n", numBlackRequired);
-            return i;
-        }
-    }
-
-    return iStart;
+    return (-1 == i) ? iStart : i;
 
 }
 
@@ -168,27 +185,9 @@ l_int32 remove_bg_outer_L(PIX *pixb, l_int32 iStart, l_int32 iEnd, l_int32 limit
 ///____________________________________________________________________________
 l_int32 remove_bg_outer_R(PIX *pixb, l_int32 iStart, l_int32 iEnd, l_int32 limitT, l_int32 limitB, l_uint32 numBlackRequired) {
 
-    l_uint32 a;
-    l_int32 i, j;
-
-    for(i=iStart; i>=iEnd; i--) {
-
-        l_uint32 numBlackPels = 0;
-        for (j=limitT; j<=limitB; j++) {
-            l_int32 retval = pixGetPixel(pixb, i, j, &a);
-            assert(0 == retval);
-            if (PEL_IS_BLACK == a) {
-                numBlackPels++;
-            }
-        }
-        //debugstr("R %d: numBlack=%d\n", i, numBlackPels);
-        if (numBlackPels<numBlackRequired) {
-            //debugstr("remove_bg_outer_R break! (thresh=%d)\n", numBlackRequired);
-            return i;
-        }
-    }
+    l_int32 i = remove_bg_scan_cols(pixb, 0, 0, limitT, limitB, iStart, iEnd, -1, numBlackRequired);
 
-    return iStart;
+    return (-1 == i) ? iStart : i;
 
 }
 
@@ -236,4 +235,159 @@ l_int32 remove_bg_outer(PIX *pixb, l_int32 rotDir, l_uint32 topEdge, l_uint32 bo
         assert(0);
     }
 
-}
\ No newline at end of file
+}
+
+#define kBorderBandMargin 64 //pels on each side of the proxy edge, before rotation slack
+
+/// remove_bg_border_band_margin()
+/// Half the initial height (or width) of each band in remove_bg_border_bands():
+/// the proxy's resolution plus the furthest the rotation moves an edge.
+///____________________________________________________________________________
+l_int32 remove_bg_border_band_margin(l_int32 w, l_int32 h, l_float32 angle) {
+    return kBorderBandMargin + (l_int32)(fabs(sin(angle)) * max_int32(w, h) / 2);
+}
+
+
+/// make_border_band()
+/// Rotate the part of the image inside the given rectangle by angle (radians,
+/// area mapped, black brought in) and bitonalize it with thresh. Returns NULL
+/// if the source pels are not all in one of the parts.
+///____________________________________________________________________________
+static PIX *make_border_band(const GRAYPARTS *src, l_float32 angle, l_int32 thresh,
+                             l_int32 x, l_int32 y, l_int32 w, l_int32 h) {
+
+    BOX *box  = boxCreate(x, y, w, h);
+    PIX *pixt = RotatePartsRegionAMGray(src, angle, 0, box);
+    boxDestroy(&box);
+    if (NULL == pixt) {
+        debugstr("border bands: no part holds the band at (%d, %d, %d, %d)\n", x, y, w, h);
+        return NULL;
+    }
+
+    PIXVIEW view;
+    ViewInit(&view, pixt, NULL);
+    PIX *pixb = ThresholdViewToBinary(&view, thresh);
+    assert(NULL != pixb);
+    pixDestroy(&pixt);
+
+    return pixb;
+}
+
+
+/// remove_bg_border_bands()
+/// Full-resolution rough crop for foldouts (rotDir 0) that only rotates and
+/// bitonalizes bands around the edges found on the 8x reduced image, instead
+/// of the whole frame. Each band starts out as the proxy edge +/- a margin
+/// that covers the proxy's resolution and how far the rotation can move an
+/// edge. A band grows towards the border if the edge is at its outer end, and
+/// towards the center if the edge is not in it at all.
+///
+/// The edges are the ones remove_bg_top(), remove_bg_bottom() and
+/// remove_bg_outer() find on the whole rotated, bitonalized image, as long as
+/// every line between the image border and the outer end of its band is
+/// background. Time and memory scale with the perimeter, not the area.
+///
+/// src may hold the whole image or only the parts around its edges. Returns 0
+/// if OK, 1 if a band needs pels that are not in src.
+///____________________________________________________________________________
+l_int32 remove_bg_border_bands(const GRAYPARTS *src, l_float32 angle, l_int32 thresh,
+                               l_int32 proxyT, l_int32 proxyB, l_int32 proxyL, l_int32 proxyR,
+                               float black_pixel_percentage,
+                               l_int32 *cropT, l_int32 *cropB, l_int32 *cropL, l_int32 *cropR) {
+
+    l_int32 w = src->w;
+    l_int32 h = src->h;
+    l_int32 margin = remove_bg_border_band_margin(w, h, angle);
+    l_int32 a, b, j, i;
+    PIX *pixb;
+
+    /// top and bottom bands span the full width; same limits as rotDir 0 in
+    /// remove_bg_top() and remove_bg_bottom()
+    l_uint32 limitL = 1;
+    l_uint32 limitR = w-1;
+    l_uint32 numBlackRequired = (l_uint32)(black_pixel_percentage*(limitR-limitL));
+
+    l_int32 limitB = l_uint32(0.80*h);
+    a = max_int32(0, min_int32(proxyT - margin, limitB));
+    b = max_int32(a, min_int32(proxyT + margin, limitB));
+    while (1) {
+        pixb = make_border_band(src, angle, thresh, 0, a, w, b-a+1);
+        if (NULL == pixb) return 1;
+        j = remove_bg_scan_rows(pixb, 0, a, limitL, limitR, a, b, 1, numBlackRequired);
+        pixDestroy(&pixb);
+        if ((j == a) && (a > 0)) {
+            a = max_int32(0, a - 2*margin);
+        } else if ((-1 == j) && (b < limitB)) {
+            b = min_int32(limitB, b + 2*margin);
+        } else {
+            break;
+        }
+    }
+    *cropT = (-1 == j) ? 0 : j;
+    debugstr("border bands: cropT=%d from band %d-%d\n", *cropT, a, b);
+
+    l_int32 limitT = l_uint32(0.20*h);
+    b = min_int32(h-1, max_int32(proxyB + margin, limitT));
+    a = min_int32(b, max_int32(proxyB - margin, limitT));
+    while (1) {
+        pixb = make_border_band(src, angle, thresh, 0, a, w, b-a+1);
+        if (NULL == pixb) return 1;
+        j = remove_bg_scan_rows(pixb, 0, a, limitL, limitR, b, a, -1, numBlackRequired);
+        pixDestroy(&pixb);
+        if ((j == b) && (b < h-1)) {
+            b = min_int32(h-1, b + 2*margin);
+        } else if ((-1 == j) && (a > limitT)) {
+            a = max_int32(limitT, a - 2*margin);
+        } else {
+            break;
+        }
+    }
+    *cropB = (-1 == j) ? h-1 : j;
+    debugstr("border bands: cropB=%d from band %d-%d\n", *cropB, a, b);
+
+    /// left and right bands span the middle 80% of the new top and bottom;
+    /// same limits as remove_bg_outer()
+    l_uint32 kernelHeight10 = (l_uint32)(0.10*((l_uint32)*cropB-(l_uint32)*cropT));
+    limitT = *cropT+kernelHeight10;
+    limitB = *cropB-kernelHeight10;
+    numBlackRequired = (l_uint32)(black_pixel_percentage*(limitB-limitT));
+
+    l_int32 iEnd = (l_int32)(w*0.20);
+    b = min_int32(w-1, max_int32(proxyR + margin, iEnd));
+    a = min_int32(b, max_int32(proxyR - margin, iEnd));
+    while (1) {
+        pixb = make_border_band(src, angle, thresh, a, limitT, b-a+1, limitB-limitT+1);
+        if (NULL == pixb) return 1;
+        i = remove_bg_scan_cols(pixb, a, limitT, limitT, limitB, b, a, -1, numBlackRequired);
+        pixDestroy(&pixb);
+        if ((i == b) && (b < w-1)) {
+            b = min_int32(w-1, b + 2*margin);
+        } else if ((-1 == i) && (a > iEnd)) {
+            a = max_int32(iEnd, a - 2*margin);
+        } else {
+            break;
+        }
+    }
+    *cropR = (-1 == i) ? w-1 : i;
+    debugstr("border bands: cropR=%d from band %d-%d\n", *cropR, a, b);
+
+    iEnd = (l_uint32)(w*0.80);
+    a = max_int32(0, min_int32(proxyL - margin, iEnd));
+    b = max_int32(a, min_int32(proxyL + margin, iEnd));
+    while (1) {
+        pixb = make_border_band(src, angle, thresh, a, limitT, b-a+1, limitB-limitT+1);
+        if (NULL == pixb) return 1;
+        i = remove_bg_scan_cols(pixb, a, limitT, limitT, limitB, a, b, 1, numBlackRequired);
+        pixDestroy(&pixb);
+        if ((i == a) && (a > 0)) {
+            a = max_int32(0, a - 2*margin);
+        } else if ((-1 == i) && (b < iEnd)) {
+            b = min_int32(iEnd, b + 2*margin);
+        } else {
+            break;
+        }
+    }
+    *cropL = (-1 == i) ? 0 : i;
+    debugstr("border bands: cropL=%d from band %d-%d\n", *cropL, a, b);
+    return 0;
+}
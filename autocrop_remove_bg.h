@@ -1,3 +1,8 @@
 l_int32 remove_bg_top(PIX *pixb, l_int32 rotDir, float black_pixel_percentage);
 l_int32 remove_bg_bottom(PIX *pixb, l_int32 rotDir, float black_pixel_percentage);
 l_int32 remove_bg_outer(PIX *pixb, l_int32 rotDir, l_uint32 topEdge, l_uint32 bottomEdge, float black_pixel_percentage);
+l_int32 remove_bg_border_band_margin(l_int32 w, l_int32 h, l_float32 angle);
+l_int32 remove_bg_border_bands(const GRAYPARTS *src, l_float32 angle, l_int32 thresh,
+                               l_int32 proxyT, l_int32 proxyB, l_int32 proxyL, l_int32 proxyR,
+                               float black_pixel_percentage,
+                               l_int32 *cropT, l_int32 *cropB, l_int32 *cropL, l_int32 *cropR);
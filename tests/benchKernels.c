@@ -0,0 +1,367 @@
+/*
+Copyright(c)2008 Internet Archive. Software license GPL version 2.
+
+Microbenchmarks for the pixel kernels of autoCropCommon and
+autocrop_remove_bg, on synthetic images of proxy and full size.
+
+run with:
+benchKernels [name]
+
+Only kernels whose name contains name are run. For each kernel and size, one
+warmup call is followed by at least kBenchMinReps timed calls and at least
+kBenchMinSeconds of them. The kernels print as they go, so their stdout goes
+to /dev/null; results are printed to the original stdout, one line each:
+
+kernel size: ns/pel best, ns/pel mean, GB/s best, reps
+
+pels are the pels the kernel reads. GB/s counts the bytes it reads and
+writes, so a kernel rewrite can be compared against memory bandwidth.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "allheaders.h"
+#include <assert.h>
+#include "../autoCropCommon.h"
+#include "../autocrop_remove_bg.h"
+
+#define kBenchMinReps    5
+#define kBenchMinSeconds 0.25
+
+#define kProxyW  468    //1/8 of a 3744 x 5616 Scribe leaf
+#define kProxyH  702
+#define kFullW   3744
+#define kFullH   5616
+
+/// The images of one size. Each kernel gets the input that makes it scan its
+/// whole range instead of stopping at the first edge.
+typedef struct BenchImages {
+    const char *size;
+    PIX        *pixColor;  //32bpp page on a dark background
+    PIX        *pixPage;   //8bpp page, light with dark text lines
+    PIX        *pixFlat;   //8bpp uniform gray: no text block is ever found
+    PIX        *pixBlack;  //8bpp all black: every block has black pels
+    PIX        *pixBin;    //1bpp all black: every line is background
+} BENCHIMAGES;
+
+typedef struct BenchCase {
+    const char *name;
+    /// run the kernel once; returns the pels read and sets the bytes moved
+    double (*run)(BENCHIMAGES *im, double *bytes);
+} BENCHCASE;
+
+static FILE *out;  //the original stdout
+
+
+/// MonotonicSeconds()
+///____________________________________________________________________________
+static double MonotonicSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/// CreatePage()
+/// A light page inset in a dark background, with a dark text line every 24
+/// rows and a little noise, so the gray kernels see realistic data.
+///____________________________________________________________________________
+static PIX *CreatePage(l_int32 w, l_int32 h, l_int32 scale)
+{
+    PIX *pixg = pixCreate(w, h, 8);
+    l_int32 x0 = w/10, x1 = w - w/10, y0 = h/20, y1 = h - h/20;
+    l_int32 lineH = max_int32(24/scale, 2);
+    l_uint32 seed = 1;
+    l_int32 i, j;
+    for (j=0; j<h; j++) {
+        l_uint32 *line = pixGetData(pixg) + j*pixGetWpl(pixg);
+        for (i=0; i<w; i++) {
+            seed = seed * 1103515245 + 12345;
+            l_int32 noise = (seed >> 16) & 7;
+            l_int32 val;
+            if ((i < x0) || (i >= x1) || (j < y0) || (j >= y1)) {
+                val = 20 + noise;
+            } else if ((i > x0 + w/20) && (i < x1 - w/20) && (0 == (j/lineH) % 2)
+                       && ((i/(lineH*3)) % 4 != 3)) {
+                val = 60 + noise;
+            } else {
+                val = 220 + noise;
+            }
+            SET_DATA_BYTE(line, i, val);
+        }
+    }
+    return pixg;
+}
+
+
+/// CreateImages()
+///____________________________________________________________________________
+static void CreateImages(BENCHIMAGES *im, const char *size, l_int32 w, l_int32 h, l_int32 scale)
+{
+    im->size     = size;
+    im->pixPage  = CreatePage(w, h, scale);
+    im->pixColor = pixConvertTo32(im->pixPage);
+    im->pixFlat  = pixCreate(w, h, 8);
+    pixSetAllArbitrary(im->pixFlat, 200);
+    im->pixBlack = pixCreate(w, h, 8);
+    im->pixBin   = pixCreate(w, h, 1);
+    pixSetAll(im->pixBin);
+}
+
+
+/// DestroyImages()
+///____________________________________________________________________________
+static void DestroyImages(BENCHIMAGES *im)
+{
+    pixDestroy(&im->pixColor);
+    pixDestroy(&im->pixPage);
+    pixDestroy(&im->pixFlat);
+    pixDestroy(&im->pixBlack);
+    pixDestroy(&im->pixBin);
+}
+
+
+/// The kernels. Each is called as the pipeline calls it.
+///____________________________________________________________________________
+static double BenchSADcol(BENCHIMAGES *im, double *bytes)
+{
+    l_int32  w = pixGetWidth(im->pixPage), h = pixGetHeight(im->pixPage);
+    l_int32  edge;
+    l_uint32 diff;
+    CalculateSADcol(im->pixPage, 1, w/10, 0, h-1, &edge, &diff);
+    *bytes = 2.0 * (w/10) * h;
+    return (double)(w/10) * h;
+}
+
+static double BenchSADrow(BENCHIMAGES *im, double *bytes)
+{
+    l_int32  w = pixGetWidth(im->pixPage), h = pixGetHeight(im->pixPage);
+    l_int32  edge;
+    l_uint32 diff;
+    CalculateSADrow(im->pixPage, 0, w-1, 1, h/10, &edge, &diff);
+    *bytes = 2.0 * w * (h/10);
+    return (double)w * (h/10);
+}
+
+static double BenchAvgCol(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixPage), h = pixGetHeight(im->pixPage);
+    l_int32 i;
+    for (i=0; i<w; i+=4) CalculateAvgCol(im->pixPage, i, 0, h-1);
+    *bytes = (double)((w+3)/4) * h;
+    return *bytes;
+}
+
+static double BenchVarCol(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixPage), h = pixGetHeight(im->pixPage);
+    l_int32 i;
+    for (i=0; i<w; i+=4) CalculateVarCol(im->pixPage, i, 0, h-1);
+    *bytes = (double)((w+3)/4) * h;
+    return *bytes;
+}
+
+/// RemoveBlackPelsBlockCol* read kernelWidth columns for every step over the
+/// middle 90% of the rows; the Row* versions read kernelWidth+1 rows over the
+/// middle 80% of the columns.
+#define kBenchKernelWidth 3
+
+static double BenchBlackColLeft(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixBlack), h = pixGetHeight(im->pixBlack);
+    l_int32 n = w/10;
+    RemoveBlackPelsBlockColLeft(im->pixBlack, 0, n, 0, h-1, kBenchKernelWidth, 128);
+    *bytes = (double)n * kBenchKernelWidth * h * 0.9;
+    return *bytes;
+}
+
+static double BenchBlackColRight(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixBlack), h = pixGetHeight(im->pixBlack);
+    l_int32 n = w/10;
+    RemoveBlackPelsBlockColRight(im->pixBlack, w-1, w-1-n, 0, h-1, kBenchKernelWidth, 128);
+    *bytes = (double)n * kBenchKernelWidth * h * 0.9;
+    return *bytes;
+}
+
+static double BenchBlackRowTop(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixBlack), h = pixGetHeight(im->pixBlack);
+    l_int32 n = h/20;
+    RemoveBlackPelsBlockRowTop(im->pixBlack, 0, n, 0, w-1, kBenchKernelWidth, 128);
+    *bytes = (double)n * (kBenchKernelWidth+1) * w * 0.8;
+    return *bytes;
+}
+
+static double BenchBlackRowBot(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixBlack), h = pixGetHeight(im->pixBlack);
+    l_int32 n = h/20;
+    RemoveBlackPelsBlockRowBot(im->pixBlack, h-2-kBenchKernelWidth, h-2-kBenchKernelWidth-n, 0, w-1, kBenchKernelWidth, 128);
+    *bytes = (double)n * (kBenchKernelWidth+1) * w * 0.8;
+    return *bytes;
+}
+
+/// FindTextBlock* read each line three times (mean, variance, black count for
+/// columns; mean and variance for rows) over the middle 80% of the other axis.
+static double BenchTextCol(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixFlat), h = pixGetHeight(im->pixFlat);
+    l_int32 j;
+    double  var;
+    FindTextBlockCol_L(im->pixFlat, 0, w/2, 0, h-1, 50000, 128, &j, &var);
+    *bytes = 3.0 * (w/2) * h * 0.8;
+    return *bytes;
+}
+
+static double BenchTextRow(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixFlat), h = pixGetHeight(im->pixFlat);
+    l_int32 j;
+    double  var;
+    FindTextBlockRow_T(im->pixFlat, 0, w-1, 0, h/2, 50000, &j, &var);
+    *bytes = 2.0 * w * (h/2) * 0.8;
+    return *bytes;
+}
+
+/// remove_bg_* read 1bpp pels, so a pel is an eighth of a byte.
+static double BenchBgTop(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixBin), h = pixGetHeight(im->pixBin);
+    remove_bg_top(im->pixBin, 1, 0.5);
+    double pels = 0.8 * w * 0.8 * h;
+    *bytes = pels / 8;
+    return pels;
+}
+
+static double BenchBgOuter(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixBin), h = pixGetHeight(im->pixBin);
+    remove_bg_outer(im->pixBin, 1, 0, h-1, 0.5);
+    double pels = 0.8 * w * 0.8 * h;
+    *bytes = pels / 8;
+    return pels;
+}
+
+static double BenchConvertToGray(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixColor), h = pixGetHeight(im->pixColor);
+    l_int32 grayChannel;
+    PIX *pixg = ConvertToGray(im->pixColor, &grayChannel);
+    pixDestroy(&pixg);
+    /// the histogram pass and the conversion each read the color image
+    *bytes = (double)w * h * (4 + 4 + 1);
+    return (double)w * h;
+}
+
+static double BenchRotateAM(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixPage), h = pixGetHeight(im->pixPage);
+    PIX *pixt = pixRotate(im->pixPage, 0.5 * 3.1415926535 / 180., L_ROTATE_AREA_MAP,
+                          L_BRING_IN_BLACK, 0, 0);
+    pixDestroy(&pixt);
+    *bytes = 2.0 * w * h;
+    return (double)w * h;
+}
+
+static double BenchRotate90(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixPage), h = pixGetHeight(im->pixPage);
+    PIX *pixt = pixRotate90(im->pixPage, 1);
+    pixDestroy(&pixt);
+    *bytes = 2.0 * w * h;
+    return (double)w * h;
+}
+
+static double BenchRotate90Tiled(BENCHIMAGES *im, double *bytes)
+{
+    l_int32 w = pixGetWidth(im->pixPage), h = pixGetHeight(im->pixPage);
+    PIX *pixt = Rotate90Tiled(im->pixPage, 1);
+    pixDestroy(&pixt);
+    *bytes = 2.0 * w * h;
+    return (double)w * h;
+}
+
+static BENCHCASE benchCases[] = {
+    {"CalculateSADcol",              BenchSADcol},
+    {"CalculateSADrow",              BenchSADrow},
+    {"CalculateAvgCol",              BenchAvgCol},
+    {"CalculateVarCol",              BenchVarCol},
+    {"RemoveBlackPelsBlockColLeft",  BenchBlackColLeft},
+    {"RemoveBlackPelsBlockColRight", BenchBlackColRight},
+    {"RemoveBlackPelsBlockRowTop",   BenchBlackRowTop},
+    {"RemoveBlackPelsBlockRowBot",   BenchBlackRowBot},
+    {"FindTextBlockCol_L",           BenchTextCol},
+    {"FindTextBlockRow_T",           BenchTextRow},
+    {"remove_bg_top",                BenchBgTop},
+    {"remove_bg_outer",              BenchBgOuter},
+    {"ConvertToGray",                BenchConvertToGray},
+    {"pixRotateAMGray",              BenchRotateAM},
+    {"pixRotate90",                  BenchRotate90},
+    {"Rotate90Tiled",                BenchRotate90Tiled},
+};
+
+
+/// RunCase()
+///____________________________________________________________________________
+static void RunCase(const BENCHCASE *bc, BENCHIMAGES *im)
+{
+    double bytes;
+    bc->run(im, &bytes);  //warmup
+
+    l_int32 reps  = 0;
+    double  pels  = 0;
+    double  best  = 0;
+    double  total = 0;
+    while ((reps < kBenchMinReps) || (total < kBenchMinSeconds)) {
+        double start = MonotonicSeconds();
+        pels = bc->run(im, &bytes);
+        double t = MonotonicSeconds() - start;
+        if ((0 == reps) || (t < best)) best = t;
+        total += t;
+        reps++;
+    }
+
+    fprintf(out, "%-28s %-5s: %8.3f ns/pel best, %8.3f ns/pel mean, %7.3f GB/s best, %d reps\n",
+            bc->name, im->size, best * 1e9 / pels, total / reps * 1e9 / pels,
+            bytes / best * 1e-9, reps);
+    fflush(out);
+}
+
+
+/// main()
+///____________________________________________________________________________
+int main(int argc, char **argv)
+{
+    const char *filter = (argc > 1) ? argv[1] : "";
+
+    /// keep the results; send what the kernels print to /dev/null
+    fflush(stdout);
+    out = fdopen(dup(fileno(stdout)), "w");
+    if ((NULL == out) || (NULL == freopen("/dev/null", "w", stdout))) {
+        fprintf(stderr, "benchKernels: cannot redirect stdout\n");
+        return 1;
+    }
+
+    BENCHIMAGES sizes[2];
+    CreateImages(&sizes[0], "proxy", kProxyW, kProxyH, 8);
+    CreateImages(&sizes[1], "full",  kFullW,  kFullH,  1);
+
+    l_int32 n = sizeof(benchCases) / sizeof(benchCases[0]);
+    l_int32 i, k;
+    for (i=0; i<n; i++) {
+        if (NULL == strstr(benchCases[i].name, filter)) continue;
+        for (k=0; k<2; k++) {
+            RunCase(&benchCases[i], &sizes[k]);
+        }
+    }
+
+    DestroyImages(&sizes[0]);
+    DestroyImages(&sizes[1]);
+    fclose(out);
+    return 0;
+}
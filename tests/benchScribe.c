@@ -0,0 +1,506 @@
+/*
+Copyright(c)2008 Internet Archive. Software license GPL version 2.
+
+End to end throughput of the Scribe pipeline at 1..maxThreads threads.
+
+run with:
+benchScribe [-n numLeaves] [-t maxThreads] [-p] [-o summary] [-b baseline] [listfile]
+
+listfile has one "filename rotateDirection" per line, as for autoCropScribe
+--batch. Without it, kBenchSynthLeaves leaves are rendered with genScribeLeaf
+(next to benchScribe) into a temporary directory. numLeaves leaves (default
+32) are run for each thread count, cycling through the list; thread counts
+are the powers of two below maxThreads (default: the number of cpus) and
+maxThreads itself.
+
+Each thread count runs in its own process, so its peak RSS is its own. For
+each one, benchScribe prints pages/s, pages/s per thread, p50 and p99 leaf
+latency, peak RSS, and the parallel efficiency: pages/s per thread over
+pages/s at one thread.
+
+-p runs each leaf in two phases (AutoCropScribeLeafProxy(), then
+AutoCropScribeLeafRefineAsync()): each thread starts the proxy of its next
+leaf while the last one is refined, and the p50 time to the proxy crop is
+printed as well.
+
+-o writes the results as key: value lines; -b reads such a file and compares
+pages/s at each thread count in both, exiting with 1 if any fell by more
+than kBenchRegressionPct percent.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <libgen.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "allheaders.h"
+#include <assert.h>
+#include "../autoCropBook.h"
+#include "../autoCropJpeg.h"
+#include "../autoCropScribe.h"
+#include "../autoCropStats.h"
+
+#define kBenchSynthLeaves    8
+#define kBenchMaxLeafFiles   4096
+#define kBenchMaxRuns        32
+#define kBenchRegressionPct  10
+
+typedef struct BenchLeaf {
+    char    *filename;
+    l_int32  rotDir;
+} BENCHLEAF;
+
+/// One thread count, as measured by its child process.
+typedef struct BenchRun {
+    l_int32  threads;
+    l_int32  failed;
+    double   seconds;
+    double   p50, p99;
+    double   p50Proxy;     //-p only
+    long     peakRssKB;
+} BENCHRUN;
+
+/// Shared by the worker threads of one run.
+typedef struct BenchWork {
+    BENCHLEAF       *leaves;
+    l_int32          numFiles;
+    l_int32          numLeaves;
+    l_int32          next;
+    l_int32          failed;
+    l_int32          progressive;
+    double          *latency;
+    double          *latencyProxy;  //-p only
+    pthread_mutex_t  lock;
+} BENCHWORK;
+
+/// A leaf of a -p run, refining on its own thread.
+typedef struct BenchPending {
+    BENCHWORK   *work;
+    l_int32      index;
+    double       start;
+    SCRIBELEAF   leaf;
+} BENCHPENDING;
+
+
+/// CompareDouble()
+///____________________________________________________________________________
+static int CompareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+/// BenchFailed()
+///____________________________________________________________________________
+static void BenchFailed(BENCHWORK *work)
+{
+    pthread_mutex_lock(&work->lock);
+    work->failed++;
+    pthread_mutex_unlock(&work->lock);
+}
+
+
+/// BenchLeafDone()
+/// Called on a refining thread of a -p run as its leaf finishes.
+///____________________________________________________________________________
+static void BenchLeafDone(SCRIBELEAF *leaf, l_int32 error, const LEAFCROPS *crops, void *arg)
+{
+    BENCHPENDING *p = (BENCHPENDING *)arg;
+    p->work->latency[p->index] = MonotonicSeconds() - p->start;
+    if (error) BenchFailed(p->work);
+}
+
+
+/// BenchWorkerProgressive()
+/// BenchWorker() for -p: the proxy phase of each leaf runs here, while the
+/// previous leaf is refined on a thread of its own.
+///____________________________________________________________________________
+static void *BenchWorkerProgressive(void *arg)
+{
+    BENCHWORK    *work = (BENCHWORK *)arg;
+    BENCHPENDING  pending[2];
+    l_int32       cur = 0, busy = 0;
+    for (;;) {
+        pthread_mutex_lock(&work->lock);
+        l_int32 i = work->next++;
+        pthread_mutex_unlock(&work->lock);
+        if (i >= work->numLeaves) break;
+
+        const BENCHLEAF *leaf = &work->leaves[i % work->numFiles];
+        BENCHPENDING    *p    = &pending[cur];
+        p->work  = work;
+        p->index = i;
+        p->start = MonotonicSeconds();
+        LEAFCROPS preliminary;
+        l_int32 ret = AutoCropScribeLeafProxy(leaf->filename, leaf->rotDir, NULL, NULL, &p->leaf, &preliminary);
+        work->latencyProxy[i] = MonotonicSeconds() - p->start;
+
+        if (busy) {
+            AutoCropScribeLeafWait(&pending[1-cur].leaf, NULL);
+            busy = 0;
+        }
+        if (ret) {
+            work->latency[i] = work->latencyProxy[i];
+            BenchFailed(work);
+            continue;
+        }
+        AutoCropScribeLeafRefineAsync(&p->leaf, BenchLeafDone, p);
+        busy = 1;
+        cur  = 1 - cur;
+    }
+    if (busy) {
+        AutoCropScribeLeafWait(&pending[1-cur].leaf, NULL);
+    }
+    return NULL;
+}
+
+
+/// BenchWorker()
+/// Take the next leaf until there are none left.
+///____________________________________________________________________________
+static void *BenchWorker(void *arg)
+{
+    BENCHWORK *work = (BENCHWORK *)arg;
+    for (;;) {
+        pthread_mutex_lock(&work->lock);
+        l_int32 i = work->next++;
+        pthread_mutex_unlock(&work->lock);
+        if (i >= work->numLeaves) break;
+
+        const BENCHLEAF *leaf = &work->leaves[i % work->numFiles];
+        double start = MonotonicSeconds();
+        l_int32 ret = AutoCropScribeLeaf(leaf->filename, leaf->rotDir);
+        work->latency[i] = MonotonicSeconds() - start;
+
+        if (ret) BenchFailed(work);
+    }
+    return NULL;
+}
+
+
+/// RunChild()
+/// Run numLeaves leaves on numThreads threads and write the wall time, the
+/// number that failed and the sorted latencies to fd, then with progressive
+/// the sorted latencies to the proxy crop. Runs in the child.
+///____________________________________________________________________________
+static void RunChild(BENCHLEAF *leaves, l_int32 numFiles, l_int32 numLeaves,
+                     l_int32 numThreads, l_int32 progressive, int fd)
+{
+    /// the pipeline prints as it goes
+    if (NULL == freopen("/dev/null", "w", stdout)) _exit(1);
+
+    /// warm the page cache and the allocator
+    AutoCropScribeLeaf(leaves[0].filename, leaves[0].rotDir);
+
+    BENCHWORK work;
+    work.leaves    = leaves;
+    work.numFiles  = numFiles;
+    work.numLeaves = numLeaves;
+    work.next      = 0;
+    work.failed    = 0;
+    work.progressive  = progressive;
+    work.latency      = (double *)calloc(numLeaves, sizeof(double));
+    work.latencyProxy = (double *)calloc(numLeaves, sizeof(double));
+    pthread_mutex_init(&work.lock, NULL);
+
+    pthread_t *threads = (pthread_t *)malloc(numThreads * sizeof(pthread_t));
+    double start = MonotonicSeconds();
+    l_int32 k;
+    for (k=0; k<numThreads; k++) {
+        pthread_create(&threads[k], NULL, progressive ? BenchWorkerProgressive : BenchWorker, &work);
+    }
+    for (k=0; k<numThreads; k++) {
+        pthread_join(threads[k], NULL);
+    }
+    double seconds = MonotonicSeconds() - start;
+
+    qsort(work.latency, numLeaves, sizeof(double), CompareDouble);
+    qsort(work.latencyProxy, numLeaves, sizeof(double), CompareDouble);
+    if ((sizeof(seconds) != write(fd, &seconds, sizeof(seconds)))
+        || (sizeof(work.failed) != write(fd, &work.failed, sizeof(work.failed)))
+        || ((ssize_t)(numLeaves * sizeof(double)) != write(fd, work.latency, numLeaves * sizeof(double)))
+        || (progressive
+            && ((ssize_t)(numLeaves * sizeof(double)) != write(fd, work.latencyProxy, numLeaves * sizeof(double))))) {
+        _exit(1);
+    }
+    _exit(0);
+}
+
+
+/// ReadAll()
+///____________________________________________________________________________
+static l_int32 ReadAll(int fd, void *buf, size_t n)
+{
+    char *p = (char *)buf;
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r <= 0) return 1;
+        p += r;
+        n -= r;
+    }
+    return 0;
+}
+
+
+/// RunThreads()
+/// Fork a child to run the leaves on numThreads threads, and collect its
+/// results and peak RSS. Returns 0 if OK.
+///____________________________________________________________________________
+static l_int32 RunThreads(BENCHLEAF *leaves, l_int32 numFiles, l_int32 numLeaves,
+                          l_int32 numThreads, l_int32 progressive, BENCHRUN *run)
+{
+    static char procName[] = "RunThreads";
+
+    int fds[2];
+    if (pipe(fds)) {
+        return ERROR_INT("pipe failed", procName, 1);
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (-1 == pid) {
+        return ERROR_INT("fork failed", procName, 1);
+    }
+    if (0 == pid) {
+        close(fds[0]);
+        RunChild(leaves, numFiles, numLeaves, numThreads, progressive, fds[1]);
+    }
+    close(fds[1]);
+
+    double  *latency = (double *)malloc(numLeaves * sizeof(double));
+    l_int32  err = ReadAll(fds[0], &run->seconds, sizeof(run->seconds))
+                || ReadAll(fds[0], &run->failed, sizeof(run->failed))
+                || ReadAll(fds[0], latency, numLeaves * sizeof(double));
+    run->p50Proxy = 0.0;
+    if (!err) {
+        run->p50 = latency[(numLeaves - 1) * 50 / 100];
+        run->p99 = latency[(numLeaves - 1) * 99 / 100];
+    }
+    if (!err && progressive) {
+        err = ReadAll(fds[0], latency, numLeaves * sizeof(double));
+        if (!err) run->p50Proxy = latency[(numLeaves - 1) * 50 / 100];
+    }
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    if (err || !WIFEXITED(status) || (0 != WEXITSTATUS(status))) {
+        free(latency);
+        return ERROR_INT("benchmark child failed", procName, 1);
+    }
+
+    run->threads   = numThreads;
+    run->peakRssKB = usage.ru_maxrss;
+    free(latency);
+    return 0;
+}
+
+
+/// ReadLeafList()
+/// Same format as autoCropScribe --batch. Returns the number of leaves.
+///____________________________________________________________________________
+static l_int32 ReadLeafList(const char *listfile, BENCHLEAF *leaves)
+{
+    FILE *fp = fopen(listfile, "r");
+    if (NULL == fp) return 0;
+
+    char    line[4096];
+    l_int32 n = 0;
+    while ((n < kBenchMaxLeafFiles) && (NULL != fgets(line, sizeof(line), fp))) {
+        char *end = line + strlen(line);
+        while ((end > line) && isspace((unsigned char)end[-1])) *--end = '\0';
+        char *sep = strrchr(line, ' ');
+        if (NULL == sep) continue;
+        *sep = '\0';
+        leaves[n].filename = stringNew(line);
+        leaves[n].rotDir   = atoi(sep + 1);
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+
+/// GenerateLeaves()
+/// Render kBenchSynthLeaves leaves of both hands, at several angles, some with
+/// bookmarks and covers, into dir. Returns the number of leaves.
+///____________________________________________________________________________
+static l_int32 GenerateLeaves(const char *genPath, const char *dir, BENCHLEAF *leaves)
+{
+    static const char *extras[] = {"", "-b", "-c r", "", "-e 0", "-c b -b", "", "-e 12"};
+    char cmd[1024], filename[512];
+    l_int32 i;
+    for (i=0; i<kBenchSynthLeaves; i++) {
+        l_int32   rotDir = (i & 1) ? -1 : 1;
+        l_float32 angle  = -1.0 + 2.0 * i / (kBenchSynthLeaves - 1);
+        snprintf(filename, sizeof(filename), "%s/leaf%04d.jpg", dir, i);
+        snprintf(cmd, sizeof(cmd), "%s -s %d -r %d -a %.2f %s %s > /dev/null",
+                 genPath, i + 1, rotDir, angle, extras[i % 8], filename);
+        if (0 != system(cmd)) return 0;
+        leaves[i].filename = stringNew(filename);
+        leaves[i].rotDir   = rotDir;
+    }
+    return kBenchSynthLeaves;
+}
+
+
+/// CompareBaseline()
+/// Returns 1 if pages/s fell by more than kBenchRegressionPct at any thread
+/// count found in both.
+///____________________________________________________________________________
+static l_int32 CompareBaseline(const char *baseline, const BENCHRUN *runs, l_int32 numRuns,
+                               l_int32 numLeaves)
+{
+    static char procName[] = "CompareBaseline";
+
+    FILE *fp = fopen(baseline, "r");
+    if (NULL == fp) {
+        return ERROR_INT("baseline not found", procName, 1);
+    }
+
+    l_int32 regressed = 0;
+    char    line[256];
+    while (NULL != fgets(line, sizeof(line), fp)) {
+        l_int32 threads;
+        double  ppsBase;
+        if (2 != sscanf(line, "pagesPerSec.%d: %lf", &threads, &ppsBase)) continue;
+        l_int32 i;
+        for (i=0; i<numRuns; i++) {
+            if (runs[i].threads != threads) continue;
+            double pps    = numLeaves / runs[i].seconds;
+            double change = 100.0 * (pps - ppsBase) / ppsBase;
+            l_int32 worse = (change < -kBenchRegressionPct);
+            printf("baseline threads %2d: %7.2f -> %7.2f pages/s, %+.1f%%%s\n",
+                   threads, ppsBase, pps, change, worse ? ", REGRESSION" : "");
+            regressed |= worse;
+        }
+    }
+    fclose(fp);
+    return regressed;
+}
+
+
+/// main()
+///____________________________________________________________________________
+int main(int argc, char **argv)
+{
+    static char mainName[] = "benchScribe";
+
+    l_int32     numLeaves  = 32;
+    l_int32     maxThreads = (l_int32)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *summary    = NULL;
+    const char *baseline   = NULL;
+    const char *listfile   = NULL;
+    l_int32     progressive = 0;
+
+    l_int32 k;
+    for (k=1; k<argc; k++) {
+        if      ((0 == strcmp(argv[k], "-n")) && (k+1 < argc)) numLeaves  = atoi(argv[++k]);
+        else if ((0 == strcmp(argv[k], "-t")) && (k+1 < argc)) maxThreads = atoi(argv[++k]);
+        else if ((0 == strcmp(argv[k], "-o")) && (k+1 < argc)) summary    = argv[++k];
+        else if ((0 == strcmp(argv[k], "-b")) && (k+1 < argc)) baseline   = argv[++k];
+        else if (0 == strcmp(argv[k], "-p"))                    progressive = 1;
+        else if ((k == argc-1) && ('-' != argv[k][0]))         listfile   = argv[k];
+        else {
+            exit(ERROR_INT(" Syntax:  benchScribe [-n numLeaves] [-t maxThreads] [-p] [-o summary]\n"
+                           "          [-b baseline] [listfile]", mainName, 1));
+        }
+    }
+    if ((numLeaves < 1) || (maxThreads < 1)) {
+        exit(ERROR_INT("numLeaves and maxThreads must be positive", mainName, 1));
+    }
+
+    BENCHLEAF *leaves = (BENCHLEAF *)calloc(kBenchMaxLeafFiles, sizeof(BENCHLEAF));
+    l_int32    numFiles;
+    char       tmpdir[] = "/tmp/benchScribe.XXXXXX";
+    l_int32    generated = 0;
+    if (NULL != listfile) {
+        numFiles = ReadLeafList(listfile, leaves);
+    } else {
+        char *self = stringNew(argv[0]);
+        char  genPath[512];
+        snprintf(genPath, sizeof(genPath), "%s/genScribeLeaf", dirname(self));
+        FREE(self);
+        if (NULL == mkdtemp(tmpdir)) {
+            exit(ERROR_INT("could not make temp dir", mainName, 1));
+        }
+        printf("rendering %d leaves with %s\n", kBenchSynthLeaves, genPath);
+        numFiles  = GenerateLeaves(genPath, tmpdir, leaves);
+        generated = 1;
+    }
+    if (0 == numFiles) {
+        exit(ERROR_INT("no leaves", mainName, 1));
+    }
+
+    /// 1, 2, 4, ... below maxThreads, then maxThreads
+    BENCHRUN runs[kBenchMaxRuns];
+    l_int32  numRuns = 0;
+    l_int32  threads;
+    for (threads=1; (numRuns < kBenchMaxRuns); threads*=2) {
+        if (threads > maxThreads) threads = maxThreads;
+        if (RunThreads(leaves, numFiles, numLeaves, threads, progressive, &runs[numRuns])) {
+            exit(ERROR_INT("run failed", mainName, 1));
+        }
+
+        const BENCHRUN *r  = &runs[numRuns];
+        double pps         = numLeaves / r->seconds;
+        double ppsOne      = numLeaves / runs[0].seconds;
+        printf("threads %2d: %7.2f pages/s, %6.2f pages/s/thread, p50 %.3f s, p99 %.3f s, "
+               "peak rss %ld kB, efficiency %.2f, %d failed",
+               threads, pps, pps / threads, r->p50, r->p99, r->peakRssKB,
+               pps / threads / ppsOne, r->failed);
+        if (progressive) printf(", p50 proxy %.3f s", r->p50Proxy);
+        printf("\n");
+        numRuns++;
+        if (threads == maxThreads) break;
+    }
+
+    if (NULL != summary) {
+        FILE *fp = fopen(summary, "w");
+        if (NULL == fp) {
+            exit(ERROR_INT("could not write summary", mainName, 1));
+        }
+        fprintf(fp, "leaves: %d\n", numLeaves);
+        fprintf(fp, "leafFiles: %d\n", numFiles);
+        for (k=0; k<numRuns; k++) {
+            const BENCHRUN *r = &runs[k];
+            double pps = numLeaves / r->seconds;
+            l_int32 t  = r->threads;
+            fprintf(fp, "pagesPerSec.%d: %.3f\n", t, pps);
+            fprintf(fp, "pagesPerSecPerThread.%d: %.3f\n", t, pps / t);
+            fprintf(fp, "p50.%d: %.4f\n", t, r->p50);
+            fprintf(fp, "p99.%d: %.4f\n", t, r->p99);
+            if (progressive) fprintf(fp, "p50Proxy.%d: %.4f\n", t, r->p50Proxy);
+            fprintf(fp, "peakRssKB.%d: %ld\n", t, r->peakRssKB);
+            fprintf(fp, "efficiency.%d: %.3f\n", t, pps / t / (numLeaves / runs[0].seconds));
+            fprintf(fp, "failed.%d: %d\n", t, r->failed);
+        }
+        fclose(fp);
+    }
+
+    l_int32 regressed = 0;
+    if (NULL != baseline) {
+        regressed = CompareBaseline(baseline, runs, numRuns, numLeaves);
+    }
+
+    if (generated) {
+        for (k=0; k<numFiles; k++) {
+            unlink(leaves[k].filename);
+        }
+        rmdir(tmpdir);
+    }
+    for (k=0; k<numFiles; k++) {
+        FREE(leaves[k].filename);
+    }
+    free(leaves);
+
+    return regressed;
+}
@@ -0,0 +1,256 @@
+/*
+Copyright(c)2008 Internet Archive. Software license GPL version 2.
+
+Render a synthetic Scribe leaf with a known crop box and skew, so benchmarks
+and accuracy checks can run without the archive.org test images.
+
+run with:
+genScribeLeaf [options] out.jpg > out.truth
+
+options:
+-w width -h height  size of the leaf in portrait orientation (3744 x 5616)
+-r rotateDirection  1 for a right-hand leaf (binding on the left), -1 for a
+                    left-hand leaf. The jpeg is stored turned by -90 * r
+                    degrees, as the Scribe cameras store it (1)
+-a angle            skew of the page in degrees, clockwise (0.5)
+-s seed             seed for the text and noise (1)
+-e numEdges         leaf edges stacked beyond the outer edge of the page (6)
+-b                  hang a bookmark ribbon off the bottom of the page
+-c r|g|b            show a library binding cover around the page, with that
+                    channel dominant
+
+The output is the same for the same options. The ground truth is printed in
+autoCropScribe's key: value format, in the coordinates autoCropScribe reports:
+after turning the leaf to portrait and deskewing it. angle is the deskew
+angle autoCropScribe should find. PageCrop* is the page, not counting the
+leaf edges, seam or cover; TextCrop* is the bounding box of the text.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "allheaders.h"
+#include <assert.h>
+
+static const l_float32  deg2rad            = 3.1415926535 / 180.;
+
+#define kPlatenGray    16   //black platen around the leaf
+#define kSeamGray      35   //bottom of the V of the binding seam
+#define kInkGray       40
+
+/// Deterministic, so a leaf is the same on every machine.
+static l_uint32 seed;
+
+static inline l_int32 Rand(l_int32 n) {
+    seed = seed * 1103515245 + 12345;
+    return (l_int32)((seed >> 16) % (l_uint32)n);
+}
+
+static inline l_int32 clip255(l_int32 v) {
+    return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+}
+
+/// SetRGB()
+/// Store (r, g, b) scaled by shade/256, with a little sensor noise.
+///____________________________________________________________________________
+static inline void SetRGB(l_uint32 *line, l_int32 x, l_int32 r, l_int32 g, l_int32 b, l_int32 shade) {
+    l_int32 noise = Rand(9) - 4;
+    line[x] = (clip255(r * shade / 256 + noise) << L_RED_SHIFT)
+            | (clip255(g * shade / 256 + noise) << L_GREEN_SHIFT)
+            | (clip255(b * shade / 256 + noise) << L_BLUE_SHIFT);
+}
+
+
+/// FillRect()
+///____________________________________________________________________________
+static void FillRect(PIX *pix, l_int32 x0, l_int32 y0, l_int32 x1, l_int32 y1,
+                     l_int32 r, l_int32 g, l_int32 b) {
+    l_int32 w = pixGetWidth(pix), h = pixGetHeight(pix);
+    l_int32 x, y;
+    for (y=L_MAX(y0, 0); y<L_MIN(y1, h); y++) {
+        l_uint32 *line = pixGetData(pix) + y * pixGetWpl(pix);
+        for (x=L_MAX(x0, 0); x<L_MIN(x1, w); x++) {
+            SetRGB(line, x, r, g, b, 256);
+        }
+    }
+}
+
+
+/// DrawText()
+/// Lines of words between (x0, y0) and (x1, y1): each word is vertical
+/// strokes on an x-height band, with a few ascenders. Paragraphs end with a
+/// short line. Returns the bounding box of the ink.
+///____________________________________________________________________________
+static void DrawText(PIX *pix, l_int32 x0, l_int32 y0, l_int32 x1, l_int32 y1,
+                     l_int32 *inkL, l_int32 *inkT, l_int32 *inkR, l_int32 *inkB) {
+    l_int32 wpl     = pixGetWpl(pix);
+    l_int32 xHeight = L_MAX((y1 - y0) / 150, 3);
+    l_int32 pitch   = xHeight * 4;
+    l_int32 stroke  = L_MAX(xHeight / 4, 1);
+    l_int32 period  = stroke * 3;
+    l_int32 x, y, lineNum;
+
+    *inkL = x1; *inkT = y1; *inkR = x0; *inkB = y0;
+
+    for (lineNum=0, y=y0+xHeight; y+2*xHeight<=y1; y+=pitch, lineNum++) {
+        l_int32 lineEnd = x1;
+        if (7 == lineNum % 9) lineEnd = x0 + (x1 - x0) * (2 + Rand(5)) / 8;
+        if (8 == lineNum % 9) continue;  //paragraph break
+
+        x = x0;
+        if (0 == lineNum % 9) x += xHeight * 3;  //indent
+        while (x < lineEnd) {
+            l_int32 wordW = L_MIN(xHeight * (2 + Rand(7)), lineEnd - x);
+            l_int32 phase = Rand(period);
+            l_int32 i, j;
+            for (i=x; i<x+wordW; i++) {
+                if ((i + phase) % period >= stroke) continue;
+                l_int32 top = (0 == Rand(5)) ? y - xHeight : y;  //ascender
+                for (j=top; j<y+xHeight; j++) {
+                    SetRGB(pixGetData(pix) + j * wpl, i, kInkGray, kInkGray, kInkGray, 256);
+                }
+                if (top < *inkT) *inkT = top;
+            }
+            /// serifs along the baseline join the strokes of a word
+            for (j=y+xHeight-stroke; j<y+xHeight; j++) {
+                for (i=x; i<x+wordW; i++) {
+                    SetRGB(pixGetData(pix) + j * wpl, i, kInkGray, kInkGray, kInkGray, 256);
+                }
+            }
+            if (x < *inkL) *inkL = x;
+            if (x + wordW - 1 > *inkR) *inkR = x + wordW - 1;
+            if (y + xHeight - 1 > *inkB) *inkB = y + xHeight - 1;
+            x += wordW + xHeight + Rand(xHeight);
+        }
+    }
+}
+
+
+/// main()
+///____________________________________________________________________________
+int main(int argc, char **argv) {
+    static char  mainName[] = "genScribeLeaf";
+
+    l_int32    w = 3744, h = 5616, rotDir = 1, numEdges = 6, bookmark = 0;
+    l_float32  skew = 0.5;
+    char       cover = 0;
+    seed = 1;
+
+    l_int32 k;
+    for (k=1; k<argc-1; k++) {
+        if      (0 == strcmp(argv[k], "-w")) w        = atoi(argv[++k]);
+        else if (0 == strcmp(argv[k], "-h")) h        = atoi(argv[++k]);
+        else if (0 == strcmp(argv[k], "-r")) rotDir   = atoi(argv[++k]);
+        else if (0 == strcmp(argv[k], "-a")) skew     = atof(argv[++k]);
+        else if (0 == strcmp(argv[k], "-s")) seed     = atoi(argv[++k]);
+        else if (0 == strcmp(argv[k], "-e")) numEdges = atoi(argv[++k]);
+        else if (0 == strcmp(argv[k], "-b")) bookmark = 1;
+        else if (0 == strcmp(argv[k], "-c")) cover    = argv[++k][0];
+        else break;
+    }
+    if ((k != argc-1) || ((1 != rotDir) && (-1 != rotDir))
+        || (0 != cover && NULL == strchr("rgb", cover)) || (w < 200) || (h < 200)) {
+        exit(ERROR_INT(" Syntax:  genScribeLeaf [-w width] [-h height] [-r rotateDirection]\n"
+                       "          [-a angle] [-s seed] [-e numEdges] [-b] [-c r|g|b] out.jpg",
+                       mainName, 1));
+    }
+    const char *fileout = argv[argc-1];
+
+    /// Lay the leaf out with the binding on the left, and mirror it at the
+    /// end for a left-hand leaf.
+    l_int32 pageL = w * 6 / 100;
+    l_int32 pageR = w * 94 / 100 - numEdges * 3;
+    l_int32 pageT = h * 4 / 100;
+    l_int32 pageB = h * 96 / 100;
+    l_int32 seamW = w * 3 / 100;
+    l_int32 seamC = pageL - seamW / 2;
+    l_int32 gutterW = w * 4 / 100;
+
+    PIX *pix = pixCreate(w, h, 32);
+    FillRect(pix, 0, 0, w, h, kPlatenGray, kPlatenGray, kPlatenGray);
+
+    /// library binding: the cover shows beyond the top, bottom and outer edge
+    if (cover) {
+        l_int32 m = h * 15 / 1000;
+        l_int32 hi = 150, lo = 35;
+        FillRect(pix, pageL, pageT - m, pageR + numEdges * 3 + m, pageB + m,
+                 ('r' == cover) ? hi : lo, ('g' == cover) ? hi : lo, ('b' == cover) ? hi : lo);
+    }
+
+    /// leaf edges of the stack under this leaf, each a little shorter
+    for (k=0; k<numEdges; k++) {
+        l_int32 inset = (k + 1) * h / 400;
+        FillRect(pix, pageR + 3*k, pageT + inset, pageR + 3*k + 2, pageB - inset, 205, 198, 180);
+        FillRect(pix, pageR + 3*k + 2, pageT + inset, pageR + 3*k + 3, pageB - inset, 120, 115, 105);
+    }
+
+    /// the V of the seam: up to this page's edge on one side, and on the other
+    /// the opposing page curving away into the dark
+    l_int32 x, y;
+    for (y=pageT - h/100; y<pageB + h/100; y++) {
+        l_uint32 *line = pixGetData(pix) + y * pixGetWpl(pix);
+        for (x=L_MAX(seamC - 2*seamW, 0); x<pageL; x++) {
+            l_int32 d = L_ABS(x - seamC);
+            l_int32 v;
+            if (x >= seamC) {
+                v = kSeamGray + d * 30 / seamW;
+            } else if (d < seamW) {
+                v = kSeamGray + d * 45 / seamW;
+            } else {
+                v = kSeamGray + 45 - (d - seamW) * (kSeamGray + 45 - kPlatenGray) / seamW;
+            }
+            SetRGB(line, x, v, v, v, 256);
+        }
+    }
+
+    /// the page, darkening into the gutter
+    for (y=pageT; y<pageB; y++) {
+        l_uint32 *line = pixGetData(pix) + y * pixGetWpl(pix);
+        for (x=pageL; x<pageR; x++) {
+            l_int32 d = x - pageL;
+            l_int32 shade = (d < gutterW) ? 150 + 106 * d / gutterW : 256;
+            SetRGB(line, x, 232, 224, 204, shade);
+        }
+    }
+
+    l_int32 textL, textT, textR, textB;
+    DrawText(pix, pageL + (pageR - pageL) * 12 / 100, pageT + (pageB - pageT) * 7 / 100,
+             pageR - (pageR - pageL) * 10 / 100, pageB - (pageB - pageT) * 9 / 100,
+             &textL, &textT, &textR, &textB);
+
+    /// a ribbon from inside the page to the bottom of the image
+    if (bookmark) {
+        l_int32 ribbonL = pageL + (pageR - pageL) * 70 / 100;
+        FillRect(pix, ribbonL, pageB - h / 10, ribbonL + w / 50, h, 170, 25, 35);
+    }
+
+    if (-1 == rotDir) {
+        pixFlipLR(pix, pix);
+        l_int32 t;
+        t = pageL; pageL = w - pageR; pageR = w - t;
+        t = textL; textL = w - 1 - textR; textR = w - 1 - t;
+    }
+
+    /// skew about the center, then store the leaf as the camera does
+    PIX *pixSkew = pixRotate(pix, deg2rad * skew, L_ROTATE_AREA_MAP, L_BRING_IN_BLACK, 0, 0);
+    PIX *pixOut  = pixRotate90(pixSkew, -rotDir);
+    if (pixWriteJpeg(fileout, pixOut, 90, 0)) {
+        exit(ERROR_INT("could not write jpeg", mainName, 1));
+    }
+
+    printf("rotateDirection: %d\n", rotDir);
+    printf("angle: %.2f\n", -skew);
+    printf("PageCropL: %d\n", pageL);
+    printf("PageCropR: %d\n", pageR - 1);
+    printf("PageCropT: %d\n", pageT);
+    printf("PageCropB: %d\n", pageB - 1);
+    printf("TextCropL: %d\n", textL);
+    printf("TextCropR: %d\n", textR);
+    printf("TextCropT: %d\n", textT);
+    printf("TextCropB: %d\n", textB);
+
+    pixDestroy(&pixOut);
+    pixDestroy(&pixSkew);
+    pixDestroy(&pix);
+    return 0;
+}